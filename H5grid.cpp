@@ -0,0 +1,412 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#include "H5grid.h"
+#include <math.h>
+#include <algorithm>
+
+// cubic spline (M4) kernel shape, q= r/H with H the support radius
+//
+static inline float cubicSpline(const float q)
+{
+  if (q < 0.5f) return 1.0f - 6.0f*q*q*(1.0f-q);
+  if (q < 1.0f) { const float u= 1.0f-q; return 2.0f*u*u*u; }
+  return 0.0f;
+}
+
+
+H5grid::H5grid(void)
+{
+  nCells[0]= nCells[1]= nCells[2]= 0;
+  spacing[0]= spacing[1]= spacing[2]= 0.0f;
+  is2D= false;
+  maxSlabs= 0;
+  nBlocks= 0;
+}
+
+
+void H5grid::setGrid(const XcFloat3 &lowerCorner, const XcFloat3 &upperCorner, const int nx, const int ny, const int nz)
+{
+  XcHandleError(nx<1||ny<1||nz<1,XCUDA_ERROR,"H5grid::setGrid","Grid dimensions must be positive");
+
+  lower= lowerCorner;
+  upper= upperCorner;
+  nCells[0]= nx;
+  nCells[1]= ny;
+  nCells[2]= nz;
+  is2D= (nz == 1);
+
+  spacing[0]= (upper.x - lower.x)/nx;
+  spacing[1]= (upper.y - lower.y)/ny;
+  spacing[2]= (upper.z - lower.z)/nz;
+  if (is2D && spacing[2] <= 0.0f) spacing[2]= spacing[0]; // for the XDMF mesh only
+
+  XcHandleError(spacing[0]<=0.0f||spacing[1]<=0.0f||spacing[2]<=0.0f,XCUDA_ERROR,"H5grid::setGrid",
+    "Upper corner must be above the lower corner");
+
+  vector<string>().swap(gridName);
+  vector< vector<float> >().swap(gridData);
+}
+
+
+float *H5grid::getField(XcCString name)
+{
+  for (int g=0; g<gridName.size(); g++) {
+    if (gridName[g] == name) return gridData[g].data();
+  } // endfor(g)
+  return nullptr;
+}
+
+
+vector<float> &H5grid::addField(const string &name)
+{
+  const size_t nTotal= size_t(nCells[0])*nCells[1]*nCells[2];
+
+  for (int g=0; g<gridName.size(); g++) {
+    if (gridName[g] == name) {
+      gridData[g].assign(nTotal,0.0f);
+      return gridData[g];
+    }
+  } // endfor(g)
+
+  gridName.push_back(name);
+  gridData.push_back(vector<float>(nTotal,0.0f));
+  return gridData.back();
+}
+
+
+void H5grid::deposit(H5pio &frame, const int type, const vector<string> &names)
+{
+  XcHandleError(nCells[0]==0,XCUDA_ERROR,"H5grid::deposit","Call setGrid() first");
+
+  const int gx= frame.findField(type,"Coordinates");
+  const int gm= frame.findField(type,"Masses");
+  const int gh= frame.findField(type,"SmoothingLength");
+  XcHandleError(gx<0||gm<0||gh<0,XCUDA_ERROR,"H5grid::deposit",
+    "Coordinates, Masses and SmoothingLength must be registered");
+
+  const int n= frame.nParticles[type];
+  const XcFloat3 *x= (const XcFloat3*)frame.dataPointer[gx];
+  const float *m= (const float*)frame.dataPointer[gm];
+  const float *h= (const float*)frame.dataPointer[gh];
+
+  prepare(x,h,n);
+
+  const size_t nTotal= size_t(nCells[0])*nCells[1]*nCells[2];
+  vector<float> mass(nTotal,0.0f);
+  depositSlabs(x,h,m,nullptr,n,mass.data(),nullptr);
+
+  const float cellVolume= is2D ? spacing[0]*spacing[1] : spacing[0]*spacing[1]*spacing[2];
+
+  for (int k=0; k<names.size(); k++) {
+    if (names[k] == "Density") {
+      float *grid= addField(names[k]).data();
+      #pragma omp parallel for
+      for (size_t c=0; c<nTotal; c++) grid[c]= mass[c]/cellVolume;
+      continue;
+    } // endif
+
+    const int ga= frame.findField(type,names[k].c_str());
+    XcHandleError(ga<0 || !frame.dataIsFloat1D[ga],XCUDA_ERROR,"H5grid::deposit",
+      "Deposited fields must be registered Float1D fields");
+
+    float *grid= addField(names[k]).data();
+    depositSlabs(x,h,m,(const float*)frame.dataPointer[ga],n,nullptr,grid);
+
+    #pragma omp parallel for
+    for (size_t c=0; c<nTotal; c++) grid[c]= (mass[c] > 0.0f) ? grid[c]/mass[c] : 0.0f;
+  } // endfor(k)
+}
+
+
+// Cell ranges and kernel normalization per particle, then the
+// particles in order of the first slab they touch.
+//
+void H5grid::prepare(const XcFloat3 *x, const float *h, const int n)
+{
+  const int slabAxis= is2D ? 1 : 2;
+  const int nSlabs= nCells[slabAxis];
+  const int nAxes= is2D ? 2 : 3;
+  const float lo[3]= {lower.x,lower.y,lower.z};
+
+  cellRange.resize(size_t(6)*n);
+  kernelNorm.resize(n);
+  firstSlab.resize(n);
+
+  #pragma omp parallel for schedule(dynamic,1024)
+  for (int i=0; i<n; i++) {
+    const float p[3]= {x[i].x,x[i].y,x[i].z};
+    const float H= h[i];
+    int *r= &cellRange[size_t(6)*i];
+
+    bool isInside= true;
+    for (int d=0; d<3; d++) {
+      if (d >= nAxes) {
+        r[2*d]= r[2*d+1]= 0;
+        continue;
+      }
+      const float u= (p[d]-lo[d])/spacing[d] - 0.5f; // in units of cells, from the first center
+      const float s= H/spacing[d];
+      r[2*d]= int(ceilf(u-s));
+      r[2*d+1]= int(floorf(u+s));
+      isInside= isInside && (r[2*d+1] >= 0) && (r[2*d] < nCells[d]);
+    } // endfor(d)
+
+    double sum= 0.0;
+    if (isInside && H > 0.0f) {
+      const float invH= 1.0f/H;
+      for (int k=r[4]; k<=r[5]; k++) {
+        const float dz= is2D ? 0.0f : lo[2] + (k+0.5f)*spacing[2] - p[2];
+        for (int j=r[2]; j<=r[3]; j++) {
+          const float dy= lo[1] + (j+0.5f)*spacing[1] - p[1];
+          for (int ii=r[0]; ii<=r[1]; ii++) {
+            const float dx= lo[0] + (ii+0.5f)*spacing[0] - p[0];
+            sum += cubicSpline(sqrtf(dx*dx + dy*dy + dz*dz)*invH);
+          } // endfor(ii)
+        } // endfor(j)
+      } // endfor(k)
+    } // endif
+
+    if (sum > 0.0) {
+      kernelNorm[i]= float(1.0/sum);
+    } else {
+      // smaller than a cell: the nearest cell takes all of it (norm < 0)
+      //
+      isInside= true;
+      for (int d=0; d<nAxes; d++) {
+        r[2*d]= r[2*d+1]= int(floorf((p[d]-lo[d])/spacing[d]));
+        isInside= isInside && (r[2*d] >= 0) && (r[2*d] < nCells[d]);
+      } // endfor(d)
+      kernelNorm[i]= -1.0f;
+    } // endif
+
+    firstSlab[i]= isInside ? unsigned(std::max(r[2*slabAxis],0)) : unsigned(nSlabs); // nSlabs= outside
+  } // endfor(i)
+
+  // particles spanning more slabs than a block go to oversized[], and
+  // out of the sorted keys, so maxSlabs is bounded by the block size
+  //
+  nBlocks= std::min(nSlabs,4*H5pio::getNumberOfThreads());
+  const int blockSlabs= std::max(1,nSlabs/nBlocks);
+
+  vector<unsigned char> isOversized(n,0);
+  int span= 1;
+  #pragma omp parallel for reduction(max:span)
+  for (int i=0; i<n; i++) {
+    if (firstSlab[i] < nSlabs) {
+      const int *r= &cellRange[size_t(6)*i];
+      const int s= std::min(r[2*slabAxis+1],nSlabs-1) - int(firstSlab[i]) + 1;
+      if (s > blockSlabs) {
+        isOversized[i]= 1;
+      } else {
+        span= (s > span) ? s : span;
+      }
+    }
+  } // endfor(i)
+  maxSlabs= span;
+
+  oversized.clear();
+  for (int i=0; i<n; i++) {
+    if (isOversized[i]) {
+      oversized.push_back(i);
+      firstSlab[i]= unsigned(nSlabs);
+    }
+  } // endfor(i)
+
+  order.resize(n);
+  H5pio::sortPermutation(firstSlab.data(),n,order.data());
+
+  // sorted keys, for the range of particles that can reach a block
+  //
+  vector<unsigned> keys(n);
+  #pragma omp parallel for
+  for (int i=0; i<n; i++) keys[i]= firstSlab[order[i]];
+  firstSlab.swap(keys);
+}
+
+
+// Adds m*W to massGrid and/or m*a*W to fieldGrid. Each block of
+// slabs belongs to one thread, which visits the particles whose
+// first slab lies within maxSlabs of the block, then the oversized
+// particles.
+//
+void H5grid::depositSlabs(const XcFloat3 *x, const float *h, const float *m, const float *a,
+                          const int n, float *massGrid, float *fieldGrid)
+{
+  const int slabAxis= is2D ? 1 : 2;
+  const int nSlabs= nCells[slabAxis];
+  const unsigned *keys= firstSlab.data();
+  const int nOversized= oversized.size();
+
+  #pragma omp parallel for schedule(dynamic,1)
+  for (int b=0; b<nBlocks; b++) {
+    const int b0= int(long(nSlabs)*b/nBlocks);
+    const int b1= int(long(nSlabs)*(b+1)/nBlocks);
+
+    const unsigned s0= unsigned(std::max(0,b0-maxSlabs+1));
+    const int first= int(std::lower_bound(keys,keys+n,s0) - keys);
+    const int last= int(std::lower_bound(keys,keys+n,unsigned(b1)) - keys);
+
+    for (int o=first; o<last; o++) {
+      depositParticle(order[o],b0,b1,x,h,m,a,massGrid,fieldGrid);
+    } // endfor(o)
+
+    for (int o=0; o<nOversized; o++) {
+      depositParticle(oversized[o],b0,b1,x,h,m,a,massGrid,fieldGrid);
+    } // endfor(o)
+  } // endfor(b)
+}
+
+
+// Deposits the part of particle i that lies in slabs [b0,b1)
+//
+void H5grid::depositParticle(const int i, const int b0, const int b1, const XcFloat3 *x, const float *h,
+                             const float *m, const float *a, float *massGrid, float *fieldGrid)
+{
+  const int slabAxis= is2D ? 1 : 2;
+  const int nx= nCells[0];
+  const int ny= nCells[1];
+  const float lo[3]= {lower.x,lower.y,lower.z};
+  const int *r= &cellRange[size_t(6)*i];
+
+  int c0[3], c1[3];
+  for (int d=0; d<3; d++) {
+    c0[d]= std::max(r[2*d],0);
+    c1[d]= std::min(r[2*d+1],nCells[d]-1);
+  } // endfor(d)
+  c0[slabAxis]= std::max(c0[slabAxis],b0);
+  c1[slabAxis]= std::min(c1[slabAxis],b1-1);
+  if (c0[0] > c1[0] || c0[1] > c1[1] || c0[2] > c1[2]) return;
+
+  const float wm= m[i];
+  const float wa= (a != nullptr) ? m[i]*a[i] : 0.0f;
+
+  if (kernelNorm[i] < 0.0f) {
+    const size_t c= (size_t(c0[2])*ny + c0[1])*nx + c0[0];
+    if (massGrid != nullptr) massGrid[c] += wm;
+    if (fieldGrid != nullptr) fieldGrid[c] += wa;
+    return;
+  } // endif
+
+  const float invH= 1.0f/h[i];
+  const float norm= kernelNorm[i];
+
+  for (int k=c0[2]; k<=c1[2]; k++) {
+    const float dz= is2D ? 0.0f : lo[2] + (k+0.5f)*spacing[2] - x[i].z;
+    for (int j=c0[1]; j<=c1[1]; j++) {
+      const float dy= lo[1] + (j+0.5f)*spacing[1] - x[i].y;
+      const size_t row= (size_t(k)*ny + j)*nx;
+      for (int ii=c0[0]; ii<=c1[0]; ii++) {
+        const float dx= lo[0] + (ii+0.5f)*spacing[0] - x[i].x;
+        const float w= norm*cubicSpline(sqrtf(dx*dx + dy*dy + dz*dz)*invH);
+        if (massGrid != nullptr) massGrid[row+ii] += wm*w;
+        if (fieldGrid != nullptr) fieldGrid[row+ii] += wa*w;
+      } // endfor(ii)
+    } // endfor(j)
+  } // endfor(k)
+}
+
+
+// ***** output *****
+//
+static void writeGridAttribute(hid_t loc_id, hid_t type_id, XcCString name, const void *data, const int n)
+{
+  hsize_t dims= n;
+  hid_t dataspace_id= H5Screate_simple(1,&dims,nullptr);
+  hid_t attribute_id= H5Acreate(loc_id,name,type_id,dataspace_id,H5P_DEFAULT,H5P_DEFAULT);
+  H5Awrite(attribute_id,type_id,data);
+  H5Aclose(attribute_id);
+  H5Sclose(dataspace_id);
+}
+
+
+void H5grid::saveGrid(XcCString fileName, const float time)
+{
+  string base(fileName);
+  const size_t dot= base.rfind(".hdf5");
+  if (dot != string::npos && dot+5 == base.size()) base.resize(dot);
+
+  const string hdf5Name= base + ".hdf5";
+  const string xdmfName= base + ".xdmf";
+  const size_t slash= hdf5Name.find_last_of('/');
+  const string hdf5Base= (slash == string::npos) ? hdf5Name : hdf5Name.substr(slash+1);
+
+  const int nx= nCells[0];
+  const int ny= nCells[1];
+  const int nz= nCells[2];
+
+  {
+    std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+    hid_t file_id= H5Fcreate(hdf5Name.c_str(),H5F_ACC_TRUNC,H5P_DEFAULT,H5P_DEFAULT);
+    XcHandleError(bool(file_id<0),XCUDA_ERROR,"H5grid::saveGrid",
+      "Unable to create an HDF5 file (check name and/or path)");
+
+    hid_t group_id= H5Gcreate(file_id,"Grid",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    {
+      const float origin[3]= {lower.x,lower.y,lower.z};
+      writeGridAttribute(group_id,H5T_NATIVE_FLOAT,"Time",&time,1);
+      writeGridAttribute(group_id,H5T_NATIVE_FLOAT,"Origin",origin,3);
+      writeGridAttribute(group_id,H5T_NATIVE_FLOAT,"Spacing",spacing,3);
+      writeGridAttribute(group_id,H5T_NATIVE_INT,"Dimensions",nCells,3);
+
+      hsize_t dims[3]= {hsize_t(nz),hsize_t(ny),hsize_t(nx)};
+      hid_t dataspace_id= H5Screate_simple(3,dims,nullptr);
+      for (int g=0; g<gridName.size(); g++) {
+        hid_t dataset_id= H5Dcreate(group_id,gridName[g].c_str(),H5T_NATIVE_FLOAT,dataspace_id,
+                                    H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+        H5Dwrite(dataset_id,H5T_NATIVE_FLOAT,H5S_ALL,H5S_ALL,H5P_DEFAULT,gridData[g].data());
+        H5Dclose(dataset_id);
+      } // endfor(g)
+      H5Sclose(dataspace_id);
+    }
+    H5Gclose(group_id);
+    H5Fclose(file_id);
+  }
+
+  FILE *xdmfFile= fopen(xdmfName.c_str(),"w");
+  XcHandleError(xdmfFile==nullptr,XCUDA_ERROR,"H5grid::saveGrid",
+    "Unable to create an XDMF file (check name and/or path)");
+
+  fprintf(xdmfFile,"<?xml version=\"1.0\" ?>\n");
+  fprintf(xdmfFile,"<!DOCTYPE Xdmf SYSTEM \"Xdmf.dtd\" []>\n");
+  fprintf(xdmfFile,"\n");
+  fprintf(xdmfFile,"<Xdmf Version=\"2.0\" >\n");
+  fprintf(xdmfFile,"  <Domain>\n");
+  fprintf(xdmfFile,"    <Grid Name=\"Temporal Collection\" GridType=\"Collection\" CollectionType=\"Temporal\" >\n");
+  fprintf(xdmfFile,"\n");
+  fprintf(xdmfFile,"      <Grid Name=\"GIZMO Grid\" GridType=\"Uniform\">\n");
+  fprintf(xdmfFile,"        <Time Value=\"%.4e\"/>\n",time);
+  fprintf(xdmfFile,"\n");
+  fprintf(xdmfFile,"        <Topology TopologyType=\"3DCoRectMesh\" Dimensions=\"%d %d %d\" />\n",nz+1,ny+1,nx+1);
+  fprintf(xdmfFile,"        <Geometry GeometryType=\"ORIGIN_DXDYDZ\">\n");
+  fprintf(xdmfFile,"          <DataItem Dimensions=\"3\" NumberType=\"Float\" Precision=\"4\" Format=\"XML\" >\n");
+  fprintf(xdmfFile,"            %e %e %e\n",lower.z,lower.y,lower.x);
+  fprintf(xdmfFile,"          </DataItem>\n");
+  fprintf(xdmfFile,"          <DataItem Dimensions=\"3\" NumberType=\"Float\" Precision=\"4\" Format=\"XML\" >\n");
+  fprintf(xdmfFile,"            %e %e %e\n",spacing[2],spacing[1],spacing[0]);
+  fprintf(xdmfFile,"          </DataItem>\n");
+  fprintf(xdmfFile,"        </Geometry>\n");
+
+  for (int g=0; g<gridName.size(); g++) {
+    fprintf(xdmfFile,"\n");
+    fprintf(xdmfFile,"        <Attribute Name=\"%s\" AttributeType=\"Scalar\" Center=\"Cell\">\n",gridName[g].c_str());
+    fprintf(xdmfFile,"          <DataItem Dimensions=\"%d %d %d\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\" >\n",nz,ny,nx);
+    fprintf(xdmfFile,"            %s:/Grid/%s\n",hdf5Base.c_str(),gridName[g].c_str());
+    fprintf(xdmfFile,"          </DataItem>\n");
+    fprintf(xdmfFile,"        </Attribute>\n");
+  } // endfor(g)
+
+  fprintf(xdmfFile,"\n");
+  fprintf(xdmfFile,"      </Grid>\n");
+  fprintf(xdmfFile,"\n");
+  fprintf(xdmfFile,"    </Grid>\n");
+  fprintf(xdmfFile,"  </Domain>\n");
+  fprintf(xdmfFile,"</Xdmf>\n");
+
+  fclose(xdmfFile);
+}
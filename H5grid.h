@@ -0,0 +1,93 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#ifndef GIZMO_HEADER_H5grid
+#define GIZMO_HEADER_H5grid
+
+#include "H5pio.h"
+
+/*!
+\verbatim
+ *********************************************************************
+ *
+ * SPH deposition of particle fields onto a uniform grid
+ *
+ * setGrid()
+ *   Box [lower,upper] divided into nx*ny*nz cells; nz=1 is a 2D
+ *   grid in (x,y). Values are stored per cell, x fastest.
+ *
+ * deposit()
+ *   Deposits fields of one particle type of a loaded frame with
+ *   the cubic-spline kernel, using "Coordinates", "Masses" and
+ *   "SmoothingLength" (the kernel support radius, as in GIZMO).
+ *   "Density" is the deposited mass per cell volume (per cell
+ *   area in 2D); any other Float1D field is mass weighted.
+ *
+ *   Each particle's kernel weights are normalized over the cells
+ *   it covers, so the mass on the grid is exact for particles
+ *   inside it, and particles smaller than a cell fall into the
+ *   nearest cell.
+ *
+ *   Threads own disjoint slabs of the grid (z in 3D, y in 2D) and
+ *   walk the particles that overlap their slabs, so no atomics
+ *   or per-thread copies of the grid are needed. Particles wider
+ *   than a block of slabs are kept apart and offered to every
+ *   block, so a few large ones do not widen every block's scan.
+ *
+ * saveGrid()
+ *   Writes /Grid/{name} [nz][ny][nx] to {fileName}.hdf5 and a
+ *   matching XDMF 3DCoRectMesh with cell-centered attributes to
+ *   {fileName}.xdmf.
+ *
+ *********************************************************************
+\endverbatim
+ */
+class H5grid {
+public:
+  H5grid(void);
+
+  void setGrid(const XcFloat3 &lower, const XcFloat3 &upper, const int nx, const int ny, const int nz=1);
+
+  void deposit(H5pio &frame, const int type, const vector<string> &names);
+  void saveGrid(XcCString fileName, const float time);
+
+  float *getField(XcCString name);
+
+  int getNumberOfCells(void) { return nCells[0]*nCells[1]*nCells[2]; }
+
+private:
+  XcFloat3 lower;
+  XcFloat3 upper;
+     float spacing[3];
+       int nCells[3];
+      bool is2D;
+
+  vector<string> gridName;
+  vector< vector<float> > gridData;
+
+  // per particle: first/last cell along each axis (unclamped), and
+  // the reciprocal of its kernel sum over those cells (-1 = nearest)
+  //
+  vector<int> cellRange;  // [n][6]
+  vector<float> kernelNorm;
+  vector<int> order;      // particles by first slab
+  vector<unsigned> firstSlab;
+  vector<int> oversized;  // particles spanning more slabs than a block
+  int maxSlabs;
+  int nBlocks;
+
+  void prepare(const XcFloat3 *x, const float *h, const int n);
+  void depositSlabs(const XcFloat3 *x, const float *h, const float *m, const float *a,
+                    const int n, float *massGrid, float *fieldGrid);
+  void depositParticle(const int i, const int b0, const int b1, const XcFloat3 *x, const float *h,
+                       const float *m, const float *a, float *massGrid, float *fieldGrid);
+
+  vector<float> &addField(const string &name);
+};
+
+// GIZMO_HEADER_H5grid
+#endif
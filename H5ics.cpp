@@ -0,0 +1,191 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#include "H5ics.h"
+#include <math.h>
+#include <algorithm>
+
+// uniform in [0,1) from (seed, cell, axis)
+//
+static inline float hashUniform(const unsigned seed, const long cell, const int axis)
+{
+  unsigned long long z= (unsigned long long)(seed)*0x9e3779b97f4a7c15ULL
+                      + (unsigned long long)(cell)*3 + axis;
+  z= (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+  z= (z ^ (z >> 27))*0x94d049bb133111ebULL;
+  z= z ^ (z >> 31);
+  return float(z >> 40)*(1.0f/16777216.0f);
+}
+
+
+H5ics::H5ics(void)
+{
+  geometry= Disk2D;
+  placement= Lattice;
+  size= 1.0f;
+  n1d= 128;
+  seed= 1;
+  jitter= 0.5f;
+
+  density= 1.0f;
+  inflowSpeed= 1.0f;
+  internalEnergy= 0.0f;
+  nNeighbors= 32;
+  blockSize= 1 << 20;
+}
+
+
+void H5ics::setGeometry(const GEOMETRY theGeometry, const float theSize)
+{
+  XcHandleError(theSize<=0.0f,XCUDA_ERROR,"H5ics::setGeometry","size <= 0");
+
+  geometry= theGeometry;
+  size= theSize;
+}
+
+
+void H5ics::setPlacement(const PLACEMENT thePlacement, const int theN1d, const unsigned theSeed, const float theJitter)
+{
+  XcHandleError(theN1d<2,XCUDA_ERROR,"H5ics::setPlacement","n1d < 2");
+
+  placement= thePlacement;
+  n1d= theN1d;
+  seed= theSeed;
+  jitter= theJitter;
+}
+
+
+long H5ics::generate(XcCString fileName, const float time)
+{
+  const int dim= getDimensions();
+  const long nCells= (dim == 2) ? long(n1d)*n1d : long(n1d)*n1d*n1d;
+
+  // lattice: cell centers for the box, points spanning [-R,R] otherwise
+  //
+  const float R= 0.5f*size;
+  const float dx= (geometry == Box) ? size/n1d : size/float(n1d-1);
+  const float x0= (geometry == Box) ? 0.5f*dx : -R;
+  const float amplitude= (placement == Glass) ? jitter*dx : 0.0f;
+
+  const float mass= (dim == 2) ? density*dx*dx : density*dx*dx*dx;
+  const float h= (dim == 2) ? dx*sqrtf(nNeighbors/float(M_PI))
+                            : dx*cbrtf(3.0f*nNeighbors/(4.0f*float(M_PI)));
+
+  const int rows= int(std::min(long(blockSize),nCells));
+
+  // two sets of block buffers: one is written while the other is filled
+  //
+  vector<XcFloat3> loc[2], vel[2];
+  vector<float> mas[2], rho[2], ene[2], sph[2];
+  vector<int> pid[2];
+  for (int s=0; s<2; s++) {
+    loc[s].resize(rows); vel[s].resize(rows);
+    mas[s].resize(rows); rho[s].resize(rows); ene[s].resize(rows); sph[s].resize(rows);
+    pid[s].resize(rows);
+  } // endfor(s)
+
+  H5pio out;
+  out.registerParticles(rows,H5pio::Gas);
+  out.registerGeometry3DField(H5pio::CENTER_BY_NODE,"Coordinates",loc[0].data());
+  out.registerFloat1DField(H5pio::CENTER_BY_NODE,"Density",rho[0].data());
+  out.registerFloat1DField(H5pio::CENTER_BY_NODE,"InternalEnergy",ene[0].data());
+  out.registerFloat1DField(H5pio::CENTER_BY_NODE,"Masses",mas[0].data());
+  out.registerInteger1DField(H5pio::CENTER_BY_NODE,"ParticleIDs",pid[0].data());
+  out.registerFloat1DField(H5pio::CENTER_BY_NODE,"SmoothingLength",sph[0].data());
+  out.registerFloat3DField(H5pio::CENTER_BY_NODE,"Velocities",vel[0].data());
+
+  // the fields of ptrs[] below, by name
+  //
+  const char *names[7]= {"Coordinates","Density","InternalEnergy","Masses",
+                         "ParticleIDs","SmoothingLength","Velocities"};
+  int gids[7];
+  for (int k=0; k<7; k++) gids[k]= out.findField(H5pio::Gas,names[k]);
+
+  {
+    std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+    out.openH5File(fileName,true);
+  }
+
+  vector<XcFloat3> point(rows);
+  vector<unsigned char> inside(rows);
+  vector<int> index(rows);
+
+  std::future<void> pending;
+  long nTotal= 0;
+  int s= 0;
+
+  for (long c0=0; c0<nCells; c0+=rows) {
+    const int nc= int(std::min(long(rows),nCells-c0));
+
+    #pragma omp parallel for
+    for (int k=0; k<nc; k++) {
+      const long c= c0+k;
+      const long i= c % n1d;
+      const long j= (c/n1d) % n1d;
+      const long l= (dim == 2) ? 0 : c/(long(n1d)*n1d);
+
+      XcFloat3 p(x0+i*dx,x0+j*dx,(dim == 2) ? 0.0f : x0+l*dx);
+      if (amplitude > 0.0f) {
+        p.x += amplitude*(hashUniform(seed,c,0)-0.5f);
+        p.y += amplitude*(hashUniform(seed,c,1)-0.5f);
+        if (dim == 3) p.z += amplitude*(hashUniform(seed,c,2)-0.5f);
+      } // endif
+      point[k]= p;
+
+      if (geometry == Box) {
+        inside[k]= 1;
+      } else {
+        inside[k]= (p.x*p.x + p.y*p.y + p.z*p.z <= R*R);
+      } // endif
+    } // endfor(k)
+
+    const int nSel= H5pio::selectIndices(inside.data(),nc,index.data());
+    if (nSel == 0) continue;
+
+    #pragma omp parallel for
+    for (int k=0; k<nSel; k++) {
+      const XcFloat3 p= point[index[k]];
+      const float r= sqrtf(p.x*p.x + p.y*p.y + p.z*p.z);
+      const float vr= (geometry != Box && r > 0.0f) ? -inflowSpeed/r : 0.0f;
+
+      loc[s][k]= p;
+      vel[s][k]= p*vr;
+      mas[s][k]= mass;
+      rho[s][k]= density;
+      ene[s][k]= internalEnergy;
+      sph[s][k]= h;
+      pid[s][k]= int(nTotal + k);
+    } // endfor(k)
+
+    if (pending.valid()) pending.get();
+
+    void *ptrs[7]= {loc[s].data(),rho[s].data(),ene[s].data(),mas[s].data(),
+                    pid[s].data(),sph[s].data(),vel[s].data()};
+    for (int k=0; k<7; k++) out.dataPointer[gids[k]]= ptrs[k];
+
+    pending= std::async(std::launch::async,[&out,nSel]() {
+      std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+      out.appendH5Block(H5pio::Gas,nSel);
+    });
+
+    nTotal += nSel;
+    s= 1-s;
+  } // endfor(c0)
+
+  if (pending.valid()) pending.get();
+
+  {
+    std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+    out.endH5Stream(time);
+    out.openXdmfFile();
+    out.saveXdmfFrame(time);
+    out.closeXdmfFile();
+    out.closeH5File();
+  }
+
+  return nTotal;
+}
@@ -0,0 +1,86 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#ifndef GIZMO_HEADER_H5ics
+#define GIZMO_HEADER_H5ics
+
+#include "H5pio.h"
+#include <future>
+
+/*!
+\verbatim
+ *********************************************************************
+ *
+ * Streaming generator of gas initial conditions
+ *
+ * setGeometry()
+ *   Disk2D: disk of the given diameter in the z=0 plane, as in
+ *           disk_2d, with a radial inflow.
+ *   Sphere: ball of the given diameter with a radial inflow (the
+ *           Noh problem when the energy is zero).
+ *   Box:    cube [0,size]^3 at rest.
+ *
+ * setPlacement()
+ *   Lattice: n1d points per axis across the geometry's bounding box.
+ *   Glass:   the lattice with each point displaced by up to
+ *            jitter*dx/2 per axis, a relaxation-free stand-in for
+ *            a glass that avoids lattice artifacts.
+ *
+ * generate()
+ *   Walks the lattice in blocks of blockSize cells. Each block is
+ *   generated in parallel; random numbers come from a hash of
+ *   (seed, cell), so the output does not depend on the number of
+ *   threads. The particles inside the geometry are compacted and
+ *   appended to chunked datasets with H5pio::appendH5Block(), while
+ *   the next block is generated (double buffering). Memory is
+ *   bounded by the block size, not the number of particles.
+ *
+ *   Fields: Coordinates, Velocities, Masses, Density,
+ *   InternalEnergy, SmoothingLength and ParticleIDs. The mass is
+ *   density*dx^dim, and the smoothing length holds nNeighbors
+ *   particles of the unperturbed lattice.
+ *
+ *********************************************************************
+\endverbatim
+ */
+class H5ics {
+public:
+  H5ics(void);
+
+  enum GEOMETRY {Disk2D, Sphere, Box};
+  enum PLACEMENT {Lattice, Glass};
+
+  void setGeometry(const GEOMETRY geometry, const float size);
+  void setPlacement(const PLACEMENT placement, const int n1d, const unsigned seed=1, const float jitter=0.5f);
+
+  void setDensity(const float rho) { density= rho; }
+  void setInflowSpeed(const float v) { inflowSpeed= v; }
+  void setInternalEnergy(const float u) { internalEnergy= u; }
+  void setNeighbors(const int n) { nNeighbors= n; }
+  void setBlockSize(const int rows) { blockSize= rows; }
+
+  long generate(XcCString fileName, const float time=0.0f);
+
+private:
+  GEOMETRY geometry;
+  PLACEMENT placement;
+     float size;
+       int n1d;
+  unsigned seed;
+     float jitter;
+
+  float density;
+  float inflowSpeed;
+  float internalEnergy;
+    int nNeighbors;
+    int blockSize;
+
+  int getDimensions(void) { return (geometry == Disk2D) ? 2 : 3; }
+};
+
+// GIZMO_HEADER_H5ics
+#endif
@@ -0,0 +1,269 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#include "H5interp.h"
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+
+H5interp::H5interp(void)
+{
+  missingPolicy= Drop;
+  useHermite= false;
+}
+
+
+void H5interp::interpolate(H5pio &f0, H5pio &f1, const float time, H5pio &out)
+{
+  const float dt= f1.frameTime - f0.frameTime;
+  const float w= (dt != 0.0f) ? (time - f0.frameTime)/dt : 0.0f;
+
+  for (int type=0; type<H5pio::N_TYPES; type++) {
+    const int capacity= out.nParticles[type];
+    if (capacity == 0) continue;
+
+    const int gidOut= out.findField(type,"ParticleIDs");
+    const int gid0= f0.findField(type,"ParticleIDs");
+    const int gid1= f1.findField(type,"ParticleIDs");
+    XcHandleError(gidOut<0||gid0<0||gid1<0,XCUDA_ERROR,"H5interp::interpolate",
+      "ParticleIDs must be registered for every interpolated type");
+
+    const int nOut= matchParticles((int*)f0.dataPointer[gid0],f0.nParticles[type],
+                                   (int*)f1.dataPointer[gid1],f1.nParticles[type],w);
+    XcHandleError(nOut>capacity,XCUDA_ERROR,"H5interp::interpolate",
+      "Arrays registered for output are too small");
+
+    const int v0= f0.findField(type,"Velocities");
+    const int v1= f1.findField(type,"Velocities");
+
+    for (int gid=0; gid<out.dataName.size(); gid++) {
+      if (out.dataParticleType[gid] != type) continue;
+      if (out.dataDerived[gid] >= 0) continue; // follows from the interpolated inputs
+
+      const char *name= out.dataName[gid].c_str();
+      const int g0= f0.findField(type,name);
+      const int g1= f1.findField(type,name);
+      XcHandleError(g0<0||g1<0,XCUDA_ERROR,"H5interp::interpolate",
+        "Output field is not registered in both frames");
+
+      void *a= f0.dataPointer[g0];
+      void *b= f1.dataPointer[g1];
+      void *c= out.dataPointer[gid];
+      XcHandleError(a==nullptr||b==nullptr||c==nullptr,XCUDA_ERROR,"H5interp::interpolate",
+        "Interpolated fields must have buffers in all three objects");
+
+      if (out.dataIsFloat1D[gid]) {
+        interpolateFloat((float*)a,(float*)b,(float*)c,1,w);
+      } else if (out.dataIsGeometry3D[gid] && useHermite && v0>=0 && v1>=0) {
+        interpolateHermite((XcFloat3*)a,(XcFloat3*)f0.dataPointer[v0],(XcFloat3*)b,
+                           (XcFloat3*)f1.dataPointer[v1],(XcFloat3*)c,w,dt);
+      } else if (out.dataIsFloat3D[gid] || out.dataIsGeometry3D[gid]) {
+        interpolateFloat((float*)a,(float*)b,(float*)c,3,w);
+      } else {
+        selectNearest((char*)a,(char*)b,(char*)c,out.getItemSize(gid),w);
+      } // endif
+
+    } // endfor(gid)
+
+    out.nParticles[type]= nOut;
+    out.evaluateDerivedFields(type);
+  } // endfor(type)
+
+  out.frameTime= time;
+}
+
+
+// Builds src0[]/src1[] and returns the number of output particles.
+// The lookup of f0's IDs in f1 is a binary search when f1's IDs are
+// sorted, a direct table when they are dense, and a hash otherwise.
+// An ID found twice in either frame is an error, so the match never
+// depends on which duplicate was seen first.
+//
+int H5interp::matchParticles(const int *pid0, const int n0, const int *pid1, const int n1, const float w)
+{
+  vector<int> match0(n0,-1);
+  vector<int> hit1(n1,0);
+  int nDuplicates= 0;
+
+  if (n0 > 0 && n1 > 0) {
+
+    int minID= pid1[0];
+    int maxID= pid1[0];
+    #pragma omp parallel for reduction(min:minID) reduction(max:maxID)
+    for (int j=0; j<n1; j++) {
+      minID= (pid1[j] < minID) ? pid1[j] : minID;
+      maxID= (pid1[j] > maxID) ? pid1[j] : maxID;
+    } // endfor(j)
+
+    const long range= long(maxID) - long(minID) + 1;
+
+    if (isSorted(pid1,n1)) {
+
+      #pragma omp parallel for
+      for (int i=0; i<n0; i++) {
+        const int *p= std::lower_bound(pid1,pid1+n1,pid0[i]);
+        if (p != pid1+n1 && *p == pid0[i]) match0[i]= int(p-pid1);
+      } // endfor(i)
+
+    } else if (range <= 2*long(n1) + 1024) {
+
+      vector<int> table(range,-1);
+      for (int j=0; j<n1; j++) {
+        int &t= table[pid1[j]-minID];
+        nDuplicates += (t >= 0);
+        t= j;
+      } // endfor(j)
+
+      #pragma omp parallel for
+      for (int i=0; i<n0; i++) {
+        const long id= long(pid0[i]) - minID;
+        if (id >= 0 && id < range) match0[i]= table[id];
+      } // endfor(i)
+
+    } else {
+
+      std::unordered_map<int,int> table;
+      table.reserve(n1);
+      for (int j=0; j<n1; j++) nDuplicates += !table.emplace(pid1[j],j).second;
+
+      #pragma omp parallel for
+      for (int i=0; i<n0; i++) {
+        auto it= table.find(pid0[i]);
+        if (it != table.end()) match0[i]= it->second;
+      } // endfor(i)
+
+    } // endif
+
+    #pragma omp parallel for
+    for (int i=0; i<n0; i++) {
+      if (match0[i] >= 0) {
+        #pragma omp atomic
+        hit1[match0[i]]++;
+      }
+    } // endfor(i)
+
+    #pragma omp parallel for reduction(+:nDuplicates)
+    for (int j=0; j<n1; j++) nDuplicates += (hit1[j] > 1);
+
+  } // endif
+
+  XcHandleError(nDuplicates>0,XCUDA_ERROR,"H5interp::matchParticles","Duplicate ParticleIDs in a frame");
+
+  // particles present in only one frame
+  //
+  const bool keep0= (missingPolicy == Hold) || (missingPolicy == Nearest && w <  0.5f);
+  const bool keep1= (missingPolicy == Hold) || (missingPolicy == Nearest && w >= 0.5f);
+
+  vector<unsigned char> mask0(n0);
+  vector<unsigned char> mask1(n1);
+
+  #pragma omp parallel for
+  for (int i=0; i<n0; i++) mask0[i]= (match0[i] >= 0) || keep0;
+
+  #pragma omp parallel for
+  for (int j=0; j<n1; j++) mask1[j]= !hit1[j] && keep1;
+
+  vector<int> sel0(n0);
+  vector<int> sel1(n1);
+  const int c0= H5pio::selectIndices(mask0.data(),n0,sel0.data());
+  const int c1= H5pio::selectIndices(mask1.data(),n1,sel1.data());
+
+  src0.resize(c0+c1);
+  src1.resize(c0+c1);
+
+  #pragma omp parallel for
+  for (int k=0; k<c0; k++) {
+    src0[k]= sel0[k];
+    src1[k]= match0[sel0[k]];
+  } // endfor(k)
+
+  #pragma omp parallel for
+  for (int k=0; k<c1; k++) {
+    src0[c0+k]= -1;
+    src1[c0+k]= sel1[k];
+  } // endfor(k)
+
+  return c0+c1;
+}
+
+
+bool H5interp::isSorted(const int *pid, const int n)
+{
+  int nUnsorted= 0;
+  #pragma omp parallel for reduction(+:nUnsorted)
+  for (int i=1; i<n; i++) nUnsorted += (pid[i-1] >= pid[i]);
+
+  return bool(nUnsorted == 0);
+}
+
+
+// c= a + w*(b-a) for matched particles, else the side that exists
+//
+void H5interp::interpolateFloat(const float *a, const float *b, float *c, const int dof, const float w)
+{
+  const int n= src0.size();
+  const int *s0= src0.data();
+  const int *s1= src1.data();
+
+  #pragma omp parallel for
+  for (int k=0; k<n; k++) {
+    const int i= s0[k];
+    const int j= s1[k];
+
+    #pragma omp simd
+    for (int d=0; d<dof; d++) {
+      const float va= (i >= 0) ? a[i*dof+d] : b[j*dof+d];
+      const float vb= (j >= 0) ? b[j*dof+d] : va;
+      c[k*dof+d]= va + w*(vb-va);
+    } // endfor(d)
+  } // endfor(k)
+}
+
+
+void H5interp::interpolateHermite(const XcFloat3 *x0, const XcFloat3 *v0, const XcFloat3 *x1,
+                                  const XcFloat3 *v1, XcFloat3 *x, const float w, const float dt)
+{
+  const int n= src0.size();
+  const int *s0= src0.data();
+  const int *s1= src1.data();
+
+  const float w2= w*w;
+  const float w3= w2*w;
+  const float h00=  2.0f*w3 - 3.0f*w2 + 1.0f;
+  const float h10= (     w3 - 2.0f*w2 + w)*dt;
+  const float h01= -2.0f*w3 + 3.0f*w2;
+  const float h11= (     w3 -      w2    )*dt;
+
+  #pragma omp parallel for
+  for (int k=0; k<n; k++) {
+    const int i= s0[k];
+    const int j= s1[k];
+
+    if (i >= 0 && j >= 0) {
+      x[k]= x0[i]*h00 + v0[i]*h10 + x1[j]*h01 + v1[j]*h11;
+    } else {
+      x[k]= (i >= 0) ? x0[i] : x1[j];
+    } // endif
+  } // endfor(k)
+}
+
+
+void H5interp::selectNearest(const char *a, const char *b, char *c, const int itemSize, const float w)
+{
+  const int n= src0.size();
+  const int *s0= src0.data();
+  const int *s1= src1.data();
+
+  #pragma omp parallel for
+  for (int k=0; k<n; k++) {
+    const int i= s0[k];
+    const int j= s1[k];
+    const bool useA= (i >= 0) && (j < 0 || w < 0.5f);
+
+    memcpy(c+size_t(k)*itemSize,useA ? a+size_t(i)*itemSize : b+size_t(j)*itemSize,itemSize);
+  } // endfor(k)
+}
@@ -0,0 +1,78 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#ifndef GIZMO_HEADER_H5interp
+#define GIZMO_HEADER_H5interp
+
+#include "H5pio.h"
+
+/*!
+\verbatim
+ *********************************************************************
+ *
+ * Time interpolation between two loaded frames
+ *
+ * interpolate()
+ *   Given two frames f0 and f1 (H5pio objects after loadFrame())
+ *   and a target time, fills the fields registered with the out
+ *   object. Particles are matched by "ParticleIDs", so each type
+ *   must register that field in all three objects. Fields are
+ *   matched by name; float fields are interpolated, integer and
+ *   boolean fields are taken from the nearer frame. The IDs must
+ *   be unique within each frame. Derived fields of out are not
+ *   interpolated: the buffered ones are evaluated from the
+ *   interpolated inputs, the others when out is saved.
+ *
+ *   On entry, out.nParticles[type] is the capacity of the arrays
+ *   registered with out. On return it is the number of particles
+ *   written, and out.frameTime is the target time, so the result
+ *   can be passed straight to out.saveFrame().
+ *
+ * setMissingPolicy()
+ *   Particles present in only one of the frames are dropped
+ *   (Drop), held at the values of the frame that has them
+ *   (Hold), or kept only while the target time is nearer to
+ *   that frame (Nearest).
+ *
+ * setHermite()
+ *   Interpolates the geometry with a cubic Hermite spline using
+ *   "Velocities" at both ends, instead of linearly.
+ *
+ *********************************************************************
+\endverbatim
+ */
+class H5interp {
+public:
+  H5interp(void);
+
+  enum MISSING_POLICY {Drop, Hold, Nearest};
+
+  void setMissingPolicy(const MISSING_POLICY policy) { missingPolicy= policy; }
+  void setHermite(const bool flag) { useHermite= flag; }
+
+  void interpolate(H5pio &f0, H5pio &f1, const float time, H5pio &out);
+
+private:
+  MISSING_POLICY missingPolicy;
+  bool useHermite;
+
+  // output particle k comes from src0[k] and/or src1[k] (-1 if absent)
+  //
+  vector<int> src0;
+  vector<int> src1;
+
+  int  matchParticles(const int *pid0, const int n0, const int *pid1, const int n1, const float w);
+  bool isSorted(const int *pid, const int n);
+
+  void interpolateFloat(const float *a, const float *b, float *c, const int dof, const float w);
+  void interpolateHermite(const XcFloat3 *x0, const XcFloat3 *v0, const XcFloat3 *x1,
+                          const XcFloat3 *v1, XcFloat3 *x, const float w, const float dt);
+  void selectNearest(const char *a, const char *b, char *c, const int itemSize, const float w);
+};
+
+// GIZMO_HEADER_H5interp
+#endif
@@ -0,0 +1,335 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#include "H5kdtree.h"
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+static const int BUCKET_SIZE= 16;   // max points per leaf
+static const int TASK_SIZE= 32768;  // smaller subtrees are built by one thread
+
+
+H5kdtree::H5kdtree(void)
+{
+  nPoints= 0;
+  nLevels= 0;
+  firstLeaf= 0;
+  nDims= 3;
+}
+
+
+void H5kdtree::build(H5pio &frame, const int type, const int dimensions)
+{
+  const int gid= frame.findField(type,"Coordinates");
+  XcHandleError(gid<0,XCUDA_ERROR,"H5kdtree::build","Coordinates must be registered");
+
+  build((const XcFloat3*)frame.dataPointer[gid],frame.nParticles[type],dimensions);
+}
+
+
+void H5kdtree::build(const XcFloat3 *x, const int n, const int dimensions)
+{
+  XcHandleError(dimensions<2||dimensions>3,XCUDA_ERROR,"H5kdtree::build","Dimensions must be 2 or 3");
+
+  nPoints= n;
+  nDims= dimensions;
+
+  nLevels= 0;
+  while ((long(n) >> nLevels) > BUCKET_SIZE) nLevels++;
+  firstLeaf= (1 << nLevels) - 1;
+
+  node.resize(2*firstLeaf + 1);
+  pointIndex.resize(n);
+  point.resize(n);
+
+  #pragma omp parallel for
+  for (int i=0; i<n; i++) pointIndex[i]= i;
+
+  node[0].begin= 0;
+  node[0].end= n;
+
+  #pragma omp parallel
+  {
+    #pragma omp single
+    buildNode(0,0,x);
+  }
+
+  #pragma omp parallel for
+  for (int p=0; p<n; p++) point[p]= x[pointIndex[p]];
+}
+
+
+void H5kdtree::buildNode(const int i, const int level, const XcFloat3 *x)
+{
+  Node &b= node[i];
+
+  for (int d=0; d<3; d++) {
+    b.lower[d]=  FLT_MAX;
+    b.upper[d]= -FLT_MAX;
+  } // endfor(d)
+
+  for (int p=b.begin; p<b.end; p++) {
+    const float v[3]= {x[pointIndex[p]].x,x[pointIndex[p]].y,x[pointIndex[p]].z};
+    for (int d=0; d<3; d++) {
+      b.lower[d]= std::min(b.lower[d],v[d]);
+      b.upper[d]= std::max(b.upper[d],v[d]);
+    } // endfor(d)
+  } // endfor(p)
+
+  if (level == nLevels) return; // leaf
+
+  int axis= 0;
+  for (int d=1; d<nDims; d++) {
+    if (b.upper[d]-b.lower[d] > b.upper[axis]-b.lower[axis]) axis= d;
+  } // endfor(d)
+
+  const int mid= b.begin + (b.end-b.begin)/2;
+  std::nth_element(pointIndex.begin()+b.begin,pointIndex.begin()+mid,pointIndex.begin()+b.end,
+    [x,axis](const int a, const int c) {
+      return (axis == 0) ? x[a].x < x[c].x : (axis == 1) ? x[a].y < x[c].y : x[a].z < x[c].z;
+    });
+
+  node[2*i+1].begin= b.begin;
+  node[2*i+1].end= mid;
+  node[2*i+2].begin= mid;
+  node[2*i+2].end= b.end;
+
+  if (b.end-b.begin > TASK_SIZE) {
+    #pragma omp task
+    buildNode(2*i+1,level+1,x);
+    #pragma omp task
+    buildNode(2*i+2,level+1,x);
+    #pragma omp taskwait
+  } else {
+    buildNode(2*i+1,level+1,x);
+    buildNode(2*i+2,level+1,x);
+  } // endif
+}
+
+
+float H5kdtree::distance2(const XcFloat3 &a, const XcFloat3 &b)
+{
+  const float dx= a.x-b.x;
+  const float dy= a.y-b.y;
+  const float dz= (nDims == 3) ? a.z-b.z : 0.0f;
+  return dx*dx + dy*dy + dz*dz;
+}
+
+
+float H5kdtree::boxDistance2(const Node &b, const XcFloat3 &q)
+{
+  const float v[3]= {q.x,q.y,q.z};
+  float d2= 0.0f;
+  for (int d=0; d<nDims; d++) {
+    const float s= std::max(std::max(b.lower[d]-v[d],v[d]-b.upper[d]),0.0f);
+    d2 += s*s;
+  } // endfor(d)
+  return d2;
+}
+
+
+// ***** queries *****
+//
+// Depth-first, nearer child first, pruned by the current k-th
+// distance. The k best are kept sorted by insertion (k is small).
+//
+void H5kdtree::nearest(const XcFloat3 &q, const int k, int *index, float *dist2)
+{
+  for (int j=0; j<k; j++) {
+    index[j]= -1;
+    dist2[j]= FLT_MAX;
+  } // endfor(j)
+
+  if (nPoints == 0 || k == 0) return;
+
+  int stack[2*32];
+  float stackDist[2*32];
+  int top= 0;
+  stack[top]= 0;
+  stackDist[top++]= 0.0f;
+
+  while (top > 0) {
+    top--;
+    const int i= stack[top];
+    if (stackDist[top] >= dist2[k-1]) continue;
+
+    if (i >= firstLeaf) {
+      for (int p=node[i].begin; p<node[i].end; p++) {
+        const float d2= distance2(point[p],q);
+        if (d2 >= dist2[k-1]) continue;
+
+        int j= k-1;
+        while (j > 0 && dist2[j-1] > d2) {
+          dist2[j]= dist2[j-1];
+          index[j]= index[j-1];
+          j--;
+        } // endwhile
+        dist2[j]= d2;
+        index[j]= pointIndex[p];
+      } // endfor(p)
+      continue;
+    } // endif
+
+    const float dl= boxDistance2(node[2*i+1],q);
+    const float dr= boxDistance2(node[2*i+2],q);
+    const bool leftFirst= (dl <= dr);
+
+    stack[top]= leftFirst ? 2*i+2 : 2*i+1;
+    stackDist[top++]= leftFirst ? dr : dl;
+    stack[top]= leftFirst ? 2*i+1 : 2*i+2;
+    stackDist[top++]= leftFirst ? dl : dr;
+  } // endwhile
+}
+
+
+template<class VISIT> void H5kdtree::visitWithin(const XcFloat3 &q, const float r2, VISIT visit)
+{
+  if (nPoints == 0) return;
+
+  int stack[2*32];
+  int top= 0;
+  stack[top++]= 0;
+
+  while (top > 0) {
+    const int i= stack[--top];
+    if (boxDistance2(node[i],q) > r2) continue;
+
+    if (i >= firstLeaf) {
+      for (int p=node[i].begin; p<node[i].end; p++) {
+        const float d2= distance2(point[p],q);
+        if (d2 <= r2) visit(pointIndex[p],d2);
+      } // endfor(p)
+    } else {
+      stack[top++]= 2*i+2;
+      stack[top++]= 2*i+1;
+    } // endif
+  } // endwhile
+}
+
+
+void H5kdtree::findNearest(const XcFloat3 *q, const int nq, const int k, int *index, float *dist2)
+{
+  #pragma omp parallel for schedule(dynamic,256)
+  for (int i=0; i<nq; i++) nearest(q[i],k,index+size_t(i)*k,dist2+size_t(i)*k);
+}
+
+
+void H5kdtree::findWithinRadius(const XcFloat3 *q, const int nq, const float *radius,
+                                vector<long> &offset, vector<int> &index)
+{
+  offset.assign(nq+1,0);
+
+  #pragma omp parallel for schedule(dynamic,256)
+  for (int i=0; i<nq; i++) {
+    long count= 0;
+    visitWithin(q[i],radius[i]*radius[i],[&count](const int j, const float d2) { count++; });
+    offset[i+1]= count;
+  } // endfor(i)
+
+  for (int i=0; i<nq; i++) offset[i+1] += offset[i];
+  index.resize(offset[nq]);
+
+  #pragma omp parallel for schedule(dynamic,256)
+  for (int i=0; i<nq; i++) {
+    int *out= index.data() + offset[i];
+    visitWithin(q[i],radius[i]*radius[i],[&out](const int j, const float d2) { *out++= j; });
+  } // endfor(i)
+}
+
+
+// ***** derived fields *****
+//
+float *H5kdtree::derivedField(H5pio &frame, const int type, XcCString name)
+{
+  const int gid= frame.findField(type,name);
+  if (gid >= 0) {
+    XcHandleError(!frame.dataIsFloat1D[gid],XCUDA_ERROR,"H5kdtree::derivedField",
+      "Derived fields must be Float1D fields");
+    return (float*)frame.dataPointer[gid];
+  } // endif
+
+  // a type without particles has nothing to register (and
+  // registerParticles() rejects it)
+  //
+  if (frame.nParticles[type] <= 0) return nullptr;
+
+  // fields are registered for the last type given to
+  // registerParticles(): select type, then restore the caller's
+  //
+  derived.push_back(vector<float>(nPoints,0.0f));
+  float *ptr= derived.back().data();
+
+  const int lastType= frame.theParticleType;
+  frame.registerParticles(frame.nParticles[type],type);
+  frame.registerFloat1DField(H5pio::CENTER_BY_NODE,name,ptr);
+  frame.theParticleType= lastType;
+  return ptr;
+}
+
+
+void H5kdtree::computeSmoothingLength(H5pio &frame, const int type, const int nNeighbors)
+{
+  XcHandleError(nPoints!=frame.nParticles[type],XCUDA_ERROR,"H5kdtree::computeSmoothingLength",
+    "Build the tree from this frame and type first");
+  XcHandleError(nNeighbors<2,XCUDA_ERROR,"H5kdtree::computeSmoothingLength",
+    "nNeighbors counts the particle itself and must be at least 2");
+
+  const int k= std::min(nNeighbors,nPoints);
+  if (k == 0) return;
+
+  float *h= derivedField(frame,type,"SmoothingLength");
+
+  // tree order, so that neighboring queries share cache lines
+  //
+  #pragma omp parallel
+  {
+    vector<int> index(k);
+    vector<float> dist2(k);
+
+    #pragma omp for schedule(dynamic,256)
+    for (int p=0; p<nPoints; p++) {
+      nearest(point[p],k,index.data(),dist2.data());
+      h[pointIndex[p]]= sqrtf(dist2[k-1]);
+    } // endfor(p)
+  }
+}
+
+
+void H5kdtree::computeDensity(H5pio &frame, const int type)
+{
+  XcHandleError(nPoints!=frame.nParticles[type],XCUDA_ERROR,"H5kdtree::computeDensity",
+    "Build the tree from this frame and type first");
+  if (nPoints == 0) return;
+
+  const int gm= frame.findField(type,"Masses");
+  const int gh= frame.findField(type,"SmoothingLength");
+  XcHandleError(gm<0||gh<0,XCUDA_ERROR,"H5kdtree::computeDensity",
+    "Masses and SmoothingLength must be registered");
+
+  const float *m= (const float*)frame.dataPointer[gm];
+  const float *h= (const float*)frame.dataPointer[gh];
+  float *rho= derivedField(frame,type,"Density");
+
+  const float norm= (nDims == 3) ? 8.0f/float(M_PI) : 40.0f/(7.0f*float(M_PI));
+
+  #pragma omp parallel for schedule(dynamic,256)
+  for (int p=0; p<nPoints; p++) {
+    const int i= pointIndex[p];
+    const float H= h[i];
+    const float invH= 1.0f/H;
+
+    double sum= 0.0;
+    visitWithin(point[p],H*H,[&](const int j, const float d2) {
+      const float q= sqrtf(d2)*invH;
+      const float w= (q < 0.5f) ? 1.0f - 6.0f*q*q*(1.0f-q) : 2.0f*(1.0f-q)*(1.0f-q)*(1.0f-q);
+      sum += m[j]*w;
+    });
+
+    rho[i]= float(sum)*norm*((nDims == 3) ? invH*invH*invH : invH*invH);
+  } // endfor(p)
+}
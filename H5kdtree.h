@@ -0,0 +1,99 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#ifndef GIZMO_HEADER_H5kdtree
+#define GIZMO_HEADER_H5kdtree
+
+#include "H5pio.h"
+
+/*!
+\verbatim
+ *********************************************************************
+ *
+ * k-d tree over the Coordinates of a loaded frame
+ *
+ * build()
+ *   Indexes the "Coordinates" registered for one particle type
+ *   (or any array of points). The tree is flat: a complete binary
+ *   tree of bounding boxes stored in one array, over a copy of the
+ *   points reordered so that each leaf is contiguous. Splits are
+ *   at the median of the widest axis, and the upper levels are
+ *   built in parallel. dimensions=2 ignores z, as in disk_2d.
+ *
+ * findNearest()
+ *   Batched k-nearest-neighbor query: for each of nq points, the
+ *   original indices and squared distances of the k nearest tree
+ *   points, nearest first ([nq][k]). Queries run in parallel.
+ *
+ * findWithinRadius()
+ *   Batched radius query: the neighbors of query q are
+ *   index[offset[q]] .. index[offset[q+1]-1].
+ *
+ * computeSmoothingLength()
+ *   SmoothingLength is the radius that holds nNeighbors particles
+ *   (counting the particle itself), as the nbrs of disk_2d, so
+ *   nNeighbors must be at least 2.
+ *
+ * computeDensity()
+ *   SPH density with the cubic-spline kernel, from "Masses" and
+ *   "SmoothingLength" (the kernel support radius).
+ *
+ *   Both write into the frame's registered field of that name, or,
+ *   when there is none, register a buffer owned by the tree with
+ *   registerFloat1DField(), so the next saveFrame() writes it. The
+ *   tree must then outlive that save. Types without particles
+ *   are left alone.
+ *
+ *********************************************************************
+\endverbatim
+ */
+class H5kdtree {
+public:
+  H5kdtree(void);
+
+  void build(H5pio &frame, const int type, const int dimensions=3);
+  void build(const XcFloat3 *x, const int n, const int dimensions=3);
+
+  int getNumberOfPoints(void) { return nPoints; }
+
+  void findNearest(const XcFloat3 *q, const int nq, const int k, int *index, float *dist2);
+  void findWithinRadius(const XcFloat3 *q, const int nq, const float *radius,
+                        vector<long> &offset, vector<int> &index);
+
+  void computeSmoothingLength(H5pio &frame, const int type, const int nNeighbors);
+  void computeDensity(H5pio &frame, const int type);
+
+private:
+  struct Node {
+    float lower[3];
+    float upper[3];
+    int begin;
+    int end;
+  };
+
+  vector<Node> node;       // node i has children 2i+1 and 2i+2
+  vector<XcFloat3> point;  // in tree order
+  vector<int> pointIndex;  // original index of point[p]
+  int nPoints;
+  int nLevels;             // leaves are the nodes of the last level
+  int firstLeaf;
+  int nDims;
+
+  vector< vector<float> > derived; // buffers registered by the tree
+
+  void buildNode(const int i, const int level, const XcFloat3 *x);
+  void nearest(const XcFloat3 &q, const int k, int *index, float *dist2);
+  float boxDistance2(const Node &b, const XcFloat3 &q);
+  float distance2(const XcFloat3 &a, const XcFloat3 &b);
+
+  template<class VISIT> void visitWithin(const XcFloat3 &q, const float r2, VISIT visit);
+
+  float *derivedField(H5pio &frame, const int type, XcCString name);
+};
+
+// GIZMO_HEADER_H5kdtree
+#endif
@@ -6,21 +6,96 @@
 // Copyright (C) 2022 University of Rochester. All rights reserved.
 //
 #include "H5pio.h"
+#include <hdf5_hl.h>
 #include <libgen.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define H5PIO_IO_URING
+#endif
+
+std::mutex H5pio::h5Mutex;
+
+H5pio::H5pio(void) : H5pio(environmentIOProfile())
+{
+}
 
-H5pio::H5pio(void)
+H5pio::H5pio(const IO_PROFILES profile)
 {
   frameTime= 0.0f;
   endOfFile= false;
+  sortByID= false;
 
   fileIsOpen= false;
   file_id= 0;
+  chunkRows= 65536;
+  saveStatistics= false;
+  statisticsBins= 0;
+  lodLevels= 0;
+  lodFactor= 8;
 
   xdmfFileIsOpen= false;
   xdmfFrameID= 0;
   xdmfFile= nullptr;
 
   writeXdmfTerminator= true;
+  xdmfLevel= 0;
+
+  multiTemporalFrameID= 0;
+  downsampledFrameID= 0;
+  theBaseName[0]= '\0';
+  frameCatalogIsValid= false;
+
+  prefetchDepth= 0;
+  prefetchReady= 0;
+  prefetchConsumed= 0;
+  prefetchStop= false;
+
+  liveIsOpen= false;
+  liveIsWriter= false;
+  liveFile_id= 0;
+  liveTime_id= 0;
+  liveRows_id= 0;
+  liveFrames= 0;
+
+  fcplProfile= H5P_DEFAULT;
+  faplProfile= H5P_DEFAULT;
+  faplUnpaged= H5P_DEFAULT;
+
+  dirtyTracking= MarkedRows;
+
+  writePlan.isValid= false;
+  writePlan.scalarSpace= -1;
+  writePlan.typesSpace= -1;
+  writePlanIsWanted= false;
+
+  ioBudget= 0.0f;
+  budgetStride= 8;
+  budgetStart= 0.0;
+  budgetSpent= 0.0;
+  for (int m=0; m<SkippedFrame; m++) budgetCost[m]= -1.0;
+  budgetMode= FullFrame;
+  frameStride= 1;
+  cheapCompression= false;
+
+  rawDataPath= false;
+
+  autotuneOnSave= false;
+  tuneGoal= Balanced;
+  tuneBandwidth= 500.0e6;
+
+  setIOProfile(profile);
 
   resetFields();
 }
@@ -28,12 +103,21 @@ H5pio::H5pio(void)
 H5pio::~H5pio(void)
 {
   closeFiles();
+  closeLiveFile();
+
+  releaseWritePlan();
+
+  // the lists are gone if closeH5Library() was called first
+  //
+  if (fcplProfile != H5P_DEFAULT && H5Iis_valid(fcplProfile) > 0) H5Pclose(fcplProfile);
+  if (faplProfile != H5P_DEFAULT && H5Iis_valid(faplProfile) > 0) H5Pclose(faplProfile);
+  if (faplUnpaged != H5P_DEFAULT && H5Iis_valid(faplUnpaged) > 0) H5Pclose(faplUnpaged);
 }
 
 
 void H5pio::resetFields(void)
 {  
-  for (int i=0; i<N_TYPES; i++) nParticles[i]= 0;
+  for (int i=0; i<N_TYPES; i++) nParticles[i]= registeredParticles[i]= 0;
   theParticleType= 0;
 
   vector<int>().swap(dataParticleType);
@@ -45,6 +129,14 @@ void H5pio::resetFields(void)
   vector<bool>().swap(dataIsGeometry3D);
   vector<string>().swap(dataName);
   vector<void*>().swap(dataPointer);
+  vector<int>().swap(dataDerived);
+  vector<DerivedField>().swap(derivedFields);
+
+  writePlan.isValid= false;
+
+  vector<vector<RowRange>>().swap(dirtyRows);
+  vector<vector<unsigned long long>>().swap(checkpointHashes);
+  checkpointName.clear();
 }
 
 
@@ -54,6 +146,7 @@ void H5pio::registerParticles(const int np, const int type)
   XcHandleError(type<0||type>5, XCUDA_ERROR,"H5pio::registerParticles","invalid particle type");
 
   nParticles[type]= np;
+  registeredParticles[type]= np;
   theParticleType= type;
 }
 
@@ -70,6 +163,7 @@ void H5pio::registerBoolean1DField(const bool isNodeCentered, string name, bool
     dataIsGeometry3D.push_back(false);
     dataName.push_back(name);
     dataPointer.push_back(ptr);
+    dataDerived.push_back(-1);
   } // endif
 }
 
@@ -86,6 +180,7 @@ void H5pio::registerInteger1DField(const bool isNodeCentered, string name, int *
     dataIsGeometry3D.push_back(false);
     dataName.push_back(name);
     dataPointer.push_back(ptr);
+    dataDerived.push_back(-1);
   } // endif
 }
 
@@ -102,6 +197,7 @@ void H5pio::registerFloat1DField(const bool isNodeCentered, string name, float *
     dataIsGeometry3D.push_back(false);
     dataName.push_back(name);
     dataPointer.push_back(ptr);
+    dataDerived.push_back(-1);
   } // endif
 }
 
@@ -118,6 +214,7 @@ void H5pio::registerFloat3DField(const bool isNodeCentered, string name, XcFloat
     dataIsGeometry3D.push_back(false);
     dataName.push_back(name);
     dataPointer.push_back(ptr);
+    dataDerived.push_back(-1);
   } // endif
 }
 
@@ -134,247 +231,4259 @@ void H5pio::registerGeometry3DField(const bool isNodeCentered, string name, XcFl
     dataIsGeometry3D.push_back(true);
     dataName.push_back(name);
     dataPointer.push_back(ptr);
+    dataDerived.push_back(-1);
   } // endif
 }
 
 
+// ***** derived fields *****
+//
+static const int DERIVED_MAX_INPUTS= 8;
+static const int DERIVED_BLOCK_ROWS= 4096; // rows per kernel call (inputs stay in cache)
+
+
+void H5pio::registerDerived1DField(const bool isNodeCentered, string name, const vector<string> &inputs,
+                                   DerivedKernel kernel, const vector<float> &param, float *ptr)
+{
+  XcHandleError(kernel==nullptr,XCUDA_ERROR,"H5pio::registerDerived1DField","No kernel");
+  XcHandleError(inputs.size()>DERIVED_MAX_INPUTS,XCUDA_ERROR,"H5pio::registerDerived1DField",
+    "Too many inputs");
+
+  derivedFields.push_back({inputs,kernel,param});
+
+  dataParticleType.push_back(theParticleType);
+  dataIsNodeCentered.push_back(isNodeCentered);
+  dataIsBoolean1D.push_back(false);
+  dataIsInteger1D.push_back(false);
+  dataIsFloat1D.push_back(true);
+  dataIsFloat3D.push_back(false);
+  dataIsGeometry3D.push_back(false);
+  dataName.push_back(name);
+  dataPointer.push_back(ptr);
+  dataDerived.push_back(derivedFields.size()-1);
+}
+
+
+void H5pio::registerDerived1DField(const bool isNodeCentered, string name, const DERIVED_FIELDS kind,
+                                   const vector<float> &param, float *ptr)
+{
+  // parameters not given take their defaults
+  //
+  vector<float> p;
+
+  switch (kind) {
+    case Temperature:
+      p= {5.0f/3.0f, 1.0f};
+      for (int k=0; k<param.size() && k<2; k++) p[k]= param[k];
+      registerDerived1DField(isNodeCentered,name,{"InternalEnergy"},derivedTemperature,p,ptr);
+      break;
+    case Speed:
+      registerDerived1DField(isNodeCentered,name,{"Velocities"},derivedSpeed,p,ptr);
+      break;
+    case Radius:
+      p= {0.0f, 0.0f, 0.0f};
+      for (int k=0; k<param.size() && k<3; k++) p[k]= param[k];
+      registerDerived1DField(isNodeCentered,name,{"Coordinates"},derivedRadius,p,ptr);
+      break;
+    case Pressure:
+      p= {5.0f/3.0f};
+      for (int k=0; k<param.size() && k<1; k++) p[k]= param[k];
+      registerDerived1DField(isNodeCentered,name,{"Density","InternalEnergy"},derivedPressure,p,ptr);
+      break;
+  } // endswitch
+}
+
+
+void H5pio::evaluateDerivedFields(const int type)
+{
+  evaluateDerivedFields(type,dataPointer,nParticles[type]);
+}
+
+
+// Evaluates the buffered derived fields of one type, in the order
+// they were registered (so one may use another as an input).
+//
+void H5pio::evaluateDerivedFields(const int type, const vector<void*> &ptrs, const int n)
+{
+  for (int gid=0; gid<dataName.size(); gid++) {
+    if (dataParticleType[gid] == type && dataDerived[gid] >= 0 && ptrs[gid] != nullptr) {
+      evaluateDerived(gid,ptrs,0,n,(float*)ptrs[gid]);
+    }
+  } // endfor(gid)
+}
+
+
+// out[0:n] from rows [row0,row0+n) of the inputs in ptrs[]
+//
+void H5pio::evaluateDerived(const int gid, const vector<void*> &ptrs, const long row0, const int n, float *out)
+{
+  const DerivedField &d= derivedFields[dataDerived[gid]];
+  const int type= dataParticleType[gid];
+  const int nIn= d.inputs.size();
+
+  const float *in[DERIVED_MAX_INPUTS];
+  int dof[DERIVED_MAX_INPUTS];
+
+  for (int k=0; k<nIn; k++) {
+    const int ig= findField(type,d.inputs[k].c_str());
+    XcHandleError(ig<0 || ptrs[ig]==nullptr || dataIsBoolean1D[ig] || dataIsInteger1D[ig],XCUDA_ERROR,
+      "H5pio::evaluateDerived","Inputs of derived fields must be registered float fields");
+    dof[k]= (dataIsFloat3D[ig] || dataIsGeometry3D[ig]) ? 3 : 1;
+    in[k]= (const float*)ptrs[ig] + row0*dof[k];
+  } // endfor(k)
+
+  const float *param= d.param.data();
+  const int nBlocks= (n + DERIVED_BLOCK_ROWS - 1)/DERIVED_BLOCK_ROWS;
+
+  #pragma omp parallel for schedule(static)
+  for (int b=0; b<nBlocks; b++) {
+    const int i0= b*DERIVED_BLOCK_ROWS;
+    const int m= (n-i0 < DERIVED_BLOCK_ROWS) ? n-i0 : DERIVED_BLOCK_ROWS;
+
+    const float *blockIn[DERIVED_MAX_INPUTS];
+    for (int k=0; k<nIn; k++) blockIn[k]= in[k] + size_t(i0)*dof[k];
+
+    d.kernel(m,blockIn,out+i0,param);
+  } // endfor(b)
+}
+
+
+// Unbuffered derived field: one dataset chunk is evaluated and
+// written at a time.
+//
+void H5pio::writeDerivedDataset(hid_t group_id, const int gid, const int np)
+{
+  const hsize_t rows= hsize_t(np < chunkRows ? np : chunkRows);
+  vector<float> chunk(rows);
+
+  hsize_t dims[2]= {hsize_t(np),1};
+  hid_t dataspace_id= H5Screate_simple(2,dims,nullptr);
+  {
+    hid_t plist_id= H5Pcreate(H5P_DATASET_CREATE);
+    setCompression(plist_id,group_id,dataName[gid].c_str(),hsize_t(np),1);
+    {
+      hid_t dataset_id= H5Dcreate(group_id,dataName[gid].c_str(),H5T_NATIVE_FLOAT,dataspace_id,
+                                  H5P_DEFAULT,plist_id,H5P_DEFAULT);
+      for (hsize_t row0=0; row0<hsize_t(np); row0+=rows) {
+        const int n= int((row0+rows <= hsize_t(np)) ? rows : np-row0);
+        evaluateDerived(gid,dataPointer,long(row0),n,chunk.data());
+
+        hsize_t offset[2]= {row0,0};
+        hsize_t count[2]= {hsize_t(n),1};
+        H5Sselect_hyperslab(dataspace_id,H5S_SELECT_SET,offset,nullptr,count,nullptr);
+        hid_t memspace_id= H5Screate_simple(2,count,nullptr);
+        H5Dwrite(dataset_id,H5T_NATIVE_FLOAT,memspace_id,dataspace_id,H5P_DEFAULT,chunk.data());
+        H5Sclose(memspace_id);
+      } // endfor(row0)
+      H5Dclose(dataset_id);
+    }
+    H5Pclose(plist_id);
+  }
+  H5Sclose(dataspace_id);
+}
+
+
+void H5pio::derivedTemperature(const int n, const float *const in[], float *out, const float *param)
+{
+  const float *u= in[0];
+  const float c= (param[0]-1.0f)*param[1];
+
+  #pragma omp simd
+  for (int i=0; i<n; i++) out[i]= c*u[i];
+}
+
+
+void H5pio::derivedSpeed(const int n, const float *const in[], float *out, const float *param)
+{
+  const float *v= in[0];
+
+  #pragma omp simd
+  for (int i=0; i<n; i++) out[i]= sqrtf(v[3*i]*v[3*i] + v[3*i+1]*v[3*i+1] + v[3*i+2]*v[3*i+2]);
+}
+
+
+void H5pio::derivedRadius(const int n, const float *const in[], float *out, const float *param)
+{
+  const float *x= in[0];
+  const float cx= param[0];
+  const float cy= param[1];
+  const float cz= param[2];
+
+  #pragma omp simd
+  for (int i=0; i<n; i++) {
+    const float dx= x[3*i]-cx;
+    const float dy= x[3*i+1]-cy;
+    const float dz= x[3*i+2]-cz;
+    out[i]= sqrtf(dx*dx + dy*dy + dz*dz);
+  } // endfor(i)
+}
+
+
+void H5pio::derivedPressure(const int n, const float *const in[], float *out, const float *param)
+{
+  const float *rho= in[0];
+  const float *u= in[1];
+  const float c= param[0]-1.0f;
+
+  #pragma omp simd
+  for (int i=0; i<n; i++) out[i]= c*rho[i]*u[i];
+}
+
+
 int H5pio::getNumberOfParticles(const int type)
 {
   return nParticles[type];
 }
 
 
-// ***** consolidated file I/O *****
-//
-void H5pio::openFiles(XcCString fileName_in)
+int H5pio::getItemSize(const int gid)
+{
+  if (dataIsBoolean1D[gid]) return sizeof(bool);
+  if (dataIsInteger1D[gid]) return sizeof(int);
+  if (dataIsFloat1D[gid])   return sizeof(float);
+  return sizeof(XcFloat3); // Float3D and Geometry3D
+}
+
+
+int H5pio::findField(const int type, XcCString name)
+{
+  for (int gid=0; gid<dataName.size(); gid++) {
+    if (dataParticleType[gid] == type && dataName[gid] == name) return gid;
+  } // endfor(gid)
+
+  return -1;
+}
+
+
+// ***** parallel kernels *****
+//
+int H5pio::getNumberOfThreads(void)
+{
+#ifdef HAS_OMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+
+int H5pio::selectIndices(const unsigned char *mask, const int n, int *index)
+{
+  const int nBlocks= getNumberOfThreads();
+  vector<int> offset(nBlocks+1,0);
+
+  // count per block, scan the block counts, then scatter per block
+  //
+  #pragma omp parallel for
+  for (int b=0; b<nBlocks; b++) {
+    const int lo= long(n)*b/nBlocks;
+    const int hi= long(n)*(b+1)/nBlocks;
+    int count= 0;
+    #pragma omp simd reduction(+:count)
+    for (int i=lo; i<hi; i++) count += (mask[i] != 0);
+    offset[b+1]= count;
+  } // endfor(b)
+
+  for (int b=0; b<nBlocks; b++) offset[b+1] += offset[b];
+
+  #pragma omp parallel for
+  for (int b=0; b<nBlocks; b++) {
+    const int lo= long(n)*b/nBlocks;
+    const int hi= long(n)*(b+1)/nBlocks;
+    int k= offset[b];
+    for (int i=lo; i<hi; i++) {
+      if (mask[i]) index[k++]= i;
+    } // endfor(i)
+  } // endfor(b)
+
+  return offset[nBlocks];
+}
+
+
+void H5pio::sortPermutation(const int *keys, const int n, int *perm)
+{
+  // flip the sign bit so that signed order becomes unsigned order
+  //
+  vector<unsigned> ukeys(n);
+
+  #pragma omp parallel for simd
+  for (int i=0; i<n; i++) ukeys[i]= unsigned(keys[i]) ^ 0x80000000u;
+
+  sortPermutation(ukeys.data(),n,perm);
+}
+
+
+void H5pio::sortPermutation(const unsigned *keys, const int n, int *perm)
+{
+  const int RADIX= 256;
+  const int nBlocks= getNumberOfThreads();
+
+  vector<unsigned> keyA(keys,keys+n);
+  vector<unsigned> keyB(n);
+  vector<int> idxB(n);
+
+  #pragma omp parallel for simd
+  for (int i=0; i<n; i++) perm[i]= i;
+
+  unsigned *srcKey= keyA.data();
+  unsigned *dstKey= keyB.data();
+  int *srcIdx= perm;
+  int *dstIdx= idxB.data();
+
+  vector<int> count(size_t(nBlocks)*RADIX);
+
+  for (int shift=0; shift<32; shift+=8) {
+
+    // histogram of this digit, per block
+    //
+    #pragma omp parallel for
+    for (int b=0; b<nBlocks; b++) {
+      int *c= &count[size_t(b)*RADIX];
+      for (int d=0; d<RADIX; d++) c[d]= 0;
+
+      const int lo= long(n)*b/nBlocks;
+      const int hi= long(n)*(b+1)/nBlocks;
+      for (int i=lo; i<hi; i++) c[(srcKey[i]>>shift) & 0xff]++;
+    } // endfor(b)
+
+    // skip the pass if every key has the same digit (e.g. high bytes of IDs)
+    //
+    bool isTrivial= false;
+    for (int d=0; d<RADIX && !isTrivial; d++) {
+      int total= 0;
+      for (int b=0; b<nBlocks; b++) total += count[size_t(b)*RADIX+d];
+      isTrivial= (total == n);
+    } // endfor(d)
+    if (isTrivial) continue;
+
+    // exclusive scan in digit-major, block-minor order keeps the sort stable
+    //
+    int offset= 0;
+    for (int d=0; d<RADIX; d++) {
+      for (int b=0; b<nBlocks; b++) {
+        int &c= count[size_t(b)*RADIX+d];
+        const int m= c;
+        c= offset;
+        offset += m;
+      } // endfor(b)
+    } // endfor(d)
+
+    #pragma omp parallel for
+    for (int b=0; b<nBlocks; b++) {
+      int *c= &count[size_t(b)*RADIX];
+
+      const int lo= long(n)*b/nBlocks;
+      const int hi= long(n)*(b+1)/nBlocks;
+      for (int i=lo; i<hi; i++) {
+        const int k= c[(srcKey[i]>>shift) & 0xff]++;
+        dstKey[k]= srcKey[i];
+        dstIdx[k]= srcIdx[i];
+      } // endfor(i)
+    } // endfor(b)
+
+    std::swap(srcKey,dstKey);
+    std::swap(srcIdx,dstIdx);
+  } // endfor(shift)
+
+  if (srcIdx != perm) memcpy(perm,srcIdx,size_t(n)*sizeof(int));
+}
+
+
+void H5pio::gatherField(void *data, const int itemSize, const int *perm, const int n)
+{
+  const size_t nBytes= size_t(n)*itemSize;
+
+  char *scratch= new (std::nothrow) char[nBytes];
+  XcHandleError(scratch==nullptr,XCUDA_ERROR,"H5pio::gatherField","out of memory");
+
+  gatherRows(data,itemSize,perm,n,scratch);
+
+  memcpy(data,scratch,nBytes);
+  delete[] scratch;
+}
+
+
+// dst[i]= src[index[i]] for i in [0,n). Gathers in output tiles so
+// each thread streams its writes while the reads follow index[].
+//
+void H5pio::gatherRows(const void *src_in, const int itemSize, const int *index, const int n, void *dst_in)
+{
+  const int TILE= 4096;
+  const char *src= (const char*)src_in;
+  char *dst= (char*)dst_in;
+
+  #pragma omp parallel for schedule(static)
+  for (int t=0; t<n; t+=TILE) {
+    const int hi= (t+TILE < n) ? t+TILE : n;
+
+    if (itemSize == sizeof(float)) {
+      const float *s= (const float*)src;
+      float *d= (float*)dst;
+      for (int i=t; i<hi; i++) d[i]= s[index[i]];
+    } else if (itemSize == sizeof(XcFloat3)) {
+      const XcFloat3 *s= (const XcFloat3*)src;
+      XcFloat3 *d= (XcFloat3*)dst;
+      for (int i=t; i<hi; i++) d[i]= s[index[i]];
+    } else {
+      for (int i=t; i<hi; i++) {
+        memcpy(dst+size_t(i)*itemSize,src+size_t(index[i])*itemSize,itemSize);
+      }
+    } // endif
+  } // endfor(t)
+}
+
+
+// ***** consolidated file I/O *****
+//
+void H5pio::openFiles(XcCString fileName_in, const int depth)
+{
+  stopPrefetch();
+
+  multiTemporalFrameID= 0;
+  downsampledFrameID= 0;
+  XCuda::stringCopy(theBaseName,fileName_in,XCUDA_PATH_LENGTH);
+  stripSuffix(theBaseName);
+  stripID(theBaseName);
+  frameCatalogIsValid= false;
+
+  XcHandleError(depth<0,XCUDA_ERROR,"H5pio::openFiles","prefetchDepth < 0");
+  prefetchDepth= depth;
+  if (prefetchDepth > 0) startPrefetch(1);
+}
+
+
+void H5pio::closeFiles(void)
+{
+  stopPrefetch();
+  closeH5File();
+  closeXdmfFile();
+}
+
+
+void H5pio::saveFrame(const float time, const bool isCheckpoint)
+{
+  const double tuneStart= wallSeconds();
+  if (autotuneOnSave) autotuneFrame(false);
+
+  if (ioBudget <= 0.0f) {
+    writeSeriesFrame(time);
+    return;
+  } // endif
+  budgetSpent += wallSeconds() - tuneStart;
+
+  budgetMode= chooseBudgetMode(isCheckpoint);
+  const double estimate= (budgetMode == SkippedFrame) ? 0.0 : budgetCost[budgetMode];
+  const double start= wallSeconds();
+
+  switch (budgetMode) {
+    case FullFrame:
+      writeSeriesFrame(time);
+      break;
+    case CheapFrame:
+      cheapCompression= true;
+      writeSeriesFrame(time);
+      cheapCompression= false;
+      break;
+    case DownsampledFrame:
+      cheapCompression= true;
+      writeDownsampledFrame(time);
+      cheapCompression= false;
+      break;
+    case SkippedFrame:
+      break;
+  } // endswitch
+
+  const double cost= wallSeconds() - start;
+  budgetSpent += cost;
+  if (budgetMode != SkippedFrame) {
+    double &c= budgetCost[budgetMode];
+    c= (c < 0.0) ? cost : 0.5*(c + cost);
+  } // endif
+
+  logBudget(time,isCheckpoint,estimate,cost);
+}
+
+
+void H5pio::writeSeriesFrame(const float time)
+{
+  multiTemporalFrameID++;
+  frameCatalogIsValid= false;
+
+  char fileName[XCUDA_PATH_LENGTH];
+  frameFileName(multiTemporalFrameID,fileName);
+  writeFrameFiles(fileName,time);
+
+  xdmfFrameID= 0;
+  saveXdmfFrame(time);
+}
+
+
+// The frame file, its XDMF file and those of the levels of detail.
+//
+void H5pio::writeFrameFiles(XcCString fileName, const float time)
+{
+  vector<RawExtent> extents;
+  vector< vector<float> > derived;
+
+  pushXdmfState();
+  {
+    std::lock_guard<std::mutex> lock(h5Mutex);
+    if (rawDataPath) {
+      layoutRawFrame(fileName,time,extents,derived);
+      openXdmfFile();
+      saveXdmfFrame(time);
+      closeXdmfFile();
+    } else {
+      openH5File(fileName,true);
+      openXdmfFile();
+      saveH5Frame(time);
+      saveXdmfFrame(time);
+      closeH5File();
+      closeXdmfFile();
+    } // endif
+
+    saveLevelsXdmf(fileName,time);
+  }
+  popXdmfState();
+
+  if (rawDataPath) transferRaw(hdf5Name,extents,true);
+}
+
+// One XDMF file per level of detail, {frame}_LOD{n}.xdmf
+//
+void H5pio::saveLevelsXdmf(XcCString fileName, const float time)
+{
+  for (int level=1; level<=lodLevels; level++) {
+    char levelName[XCUDA_PATH_LENGTH];
+    XCuda::stringCopy(levelName,fileName,XCUDA_PATH_LENGTH);
+    stripSuffix(levelName);
+    snprintf(levelName+strlen(levelName),XCUDA_PATH_LENGTH-strlen(levelName),"_LOD%d",level);
+
+    xdmfLevel= level;
+    openXdmfFile(levelName);
+    saveXdmfFrame(time);
+    closeXdmfFile();
+    xdmfLevel= 0;
+  } // endfor(level)
+}
+
+void H5pio::loadFrame(void)
+{
+  if (prefetchDepth > 0) {
+
+    // wait for the reader thread, then swap in the decoded frame
+    //
+    {
+      std::unique_lock<std::mutex> lock(prefetchMutex);
+      prefetchSignal.wait(lock,[this]{ return prefetchReady > 0; });
+    }
+
+    PrefetchSlot &slot= prefetchPool[prefetchConsumed % prefetchDepth];
+    multiTemporalFrameID= slot.frameID;
+    endOfFile= slot.isEnd;
+
+    if (!slot.isEnd) {
+      for (int gid=0; gid<dataName.size(); gid++) {
+        if (dataPointer[gid] != nullptr) {
+          memcpy(dataPointer[gid],slot.buffers[gid].data(),slot.buffers[gid].size());
+        }
+      } // endfor(gid)
+      frameTime= slot.time;
+
+      // release the slot; the end-of-file slot is kept so that
+      // repeated calls keep reporting endOfFile
+      //
+      {
+        std::lock_guard<std::mutex> lock(prefetchMutex);
+        prefetchReady--;
+        prefetchConsumed++;
+      }
+      prefetchSignal.notify_all();
+    } // endif
+
+    return;
+  } // endif(prefetch)
+
+  multiTemporalFrameID++;
+  loadFrameFile(multiTemporalFrameID);
+}
+
+
+void H5pio::loadFrame(const int frameID)
+{
+  buildFrameCatalog();
+
+  const int nFrames= frameCatalog.size();
+  XcHandleError(frameID<1||frameID>nFrames,XCUDA_ERROR,"H5pio::loadFrame",
+    "frameID is not in the frame catalog");
+
+  // restart the reader thread behind the requested frame
+  //
+  const int depth= prefetchDepth;
+  stopPrefetch();
+
+  multiTemporalFrameID= frameID;
+  loadFrameFile(frameID);
+
+  if (depth > 0) {
+    prefetchDepth= depth;
+    startPrefetch(frameID+1);
+  } // endif
+}
+
+
+void H5pio::loadFrameAtTime(const float time)
+{
+  buildFrameCatalog();
+
+  const int nFrames= frameCatalog.size();
+  XcHandleError(nFrames==0,XCUDA_ERROR,"H5pio::loadFrameAtTime","empty frame catalog");
+
+  // binary search for the closest frame (frame times are non-decreasing)
+  //
+  int lo= 0;
+  int hi= nFrames-1;
+  while (lo < hi) {
+    int mid= (lo+hi)/2;
+    if (frameCatalog[mid].time < time) lo= mid+1; else hi= mid;
+  } // endwhile
+
+  if (lo > 0 && fabsf(frameCatalog[lo-1].time-time) <= fabsf(frameCatalog[lo].time-time)) lo--;
+
+  loadFrame(frameCatalog[lo].frameID);
+}
+
+
+void H5pio::loadFrameFile(const int frameID)
+{
+  char fileName[XCUDA_PATH_LENGTH];
+  frameFileName(frameID,fileName);
+  FILE *fp= fopen(fileName,"r");
+  endOfFile= bool(fp == nullptr);
+
+  if (fp) {
+    fclose(fp);
+
+    // loadH5Frame() will set these.
+    // closeH5File() will reset them!
+    //
+    float theFrameTime;
+
+    std::lock_guard<std::mutex> lock(h5Mutex);
+    openH5File(fileName,false);
+    {
+      loadH5Frame();
+      theFrameTime= frameTime;
+    }
+    closeH5File();
+
+    frameTime= theFrameTime;
+    endOfFile= false;
+  } // endif
+}
+
+
+void H5pio::frameFileName(const int frameID, XcString fileName)
+{
+  snprintf(fileName,XCUDA_PATH_LENGTH,"%s_%04d.hdf5",theBaseName,frameID);
+}
+
+
+// ***** frame catalog *****
+//
+int H5pio::getNumberOfFrames(void)
+{
+  buildFrameCatalog();
+  return frameCatalog.size();
+}
+
+
+const H5pio::FrameInfo &H5pio::getFrameInfo(const int frameID)
+{
+  buildFrameCatalog();
+  XcHandleError(frameID<1||frameID>frameCatalog.size(),XCUDA_ERROR,"H5pio::getFrameInfo",
+    "frameID is not in the frame catalog");
+
+  return frameCatalog[frameID-1];
+}
+
+
+void H5pio::buildFrameCatalog(const bool forceRebuild)
+{
+  if (frameCatalogIsValid && !forceRebuild) return;
+
+  char catalogName[XCUDA_PATH_LENGTH];
+  snprintf(catalogName,XCUDA_PATH_LENGTH,"%s.catalog",theBaseName);
+
+  if (!forceRebuild && readFrameCatalog(catalogName)) {
+    frameCatalogIsValid= true;
+    return;
+  } // endif
+
+  // find the frames (they are numbered contiguously from 1)
+  //
+  vector<FrameInfo>().swap(frameCatalog);
+
+  char fileName[XCUDA_PATH_LENGTH];
+  for (int frameID=1; ; frameID++) {
+    frameFileName(frameID,fileName);
+    if (access(fileName,R_OK) != 0) break;
+
+    FrameInfo info;
+    info.frameID= frameID;
+    info.time= 0.0f;
+    for (int i=0; i<N_TYPES; i++) info.nParticles[i]= 0;
+    info.fileName= string(basename(fileName));
+    frameCatalog.push_back(info);
+  } // endfor(frameID)
+
+  // only the headers are read; the HDF5 library serializes calls,
+  // so this loop is not threaded
+  //
+  std::lock_guard<std::mutex> lock(h5Mutex);
+  for (int f=0; f<frameCatalog.size(); f++) {
+    FrameInfo &info= frameCatalog[f];
+    frameFileName(info.frameID,fileName);
+
+    hid_t fid= openProfiled(fileName,H5F_ACC_RDONLY,faplProfile);
+    XcHandleError(bool(fid<0),XCUDA_ERROR,"H5pio::buildFrameCatalog",
+      "Unable to open an HDF5 file (check name and/or path)");
+    {
+      hid_t group_id= H5Gopen(fid,"Header",H5P_DEFAULT);
+      readAttribute(group_id,H5T_NATIVE_INT,"NumPart_ThisFile",info.nParticles);
+      readAttribute(group_id,H5T_NATIVE_FLOAT,"Time",&info.time);
+      H5Gclose(group_id);
+    }
+    H5Fclose(fid);
+  } // endfor(f)
+
+  writeFrameCatalog(catalogName);
+  frameCatalogIsValid= true;
+}
+
+
+// Modification time (ns) and size of a frame file, to tell whether
+// the catalog entry still describes it; false if it does not exist.
+//
+static bool frameStamp(XcCString fileName, long long &modified, long long &size)
+{
+  struct stat st;
+  if (stat(fileName,&st) != 0) return false;
+
+  modified= (long long)(st.st_mtim.tv_sec)*1000000000LL + (long long)(st.st_mtim.tv_nsec);
+  size= (long long)(st.st_size);
+  return true;
+}
+
+
+// The cached catalog is trusted if every frame it lists still exists
+// with the same modification time and size, and no frame follows
+// the last one.
+//
+bool H5pio::readFrameCatalog(XcCString catalogName)
+{
+  FILE *fp= fopen(catalogName,"r");
+  if (fp == nullptr) return false;
+
+  vector<FrameInfo>().swap(frameCatalog);
+  bool isCurrent= true;
+
+  char fileName[XCUDA_PATH_LENGTH];
+  char line[XCUDA_PATH_LENGTH];
+  while (fgets(line,XCUDA_PATH_LENGTH,fp)) {
+    if (line[0] == '#') continue;
+
+    FrameInfo info;
+    char name[XCUDA_PATH_LENGTH];
+    int *np= info.nParticles;
+    long long modified= 0, size= 0;
+    int n= sscanf(line,"%d %e %d %d %d %d %d %d %lld %lld %s",&info.frameID,&info.time,
+                  &np[0],&np[1],&np[2],&np[3],&np[4],&np[5],&modified,&size,name);
+    if (n != 11) {
+      isCurrent= false;
+      break;
+    } // endif
+
+    long long fileModified, fileSize;
+    frameFileName(info.frameID,fileName);
+    if (info.frameID != int(frameCatalog.size())+1 || !frameStamp(fileName,fileModified,fileSize) ||
+        fileModified != modified || fileSize != size) {
+      isCurrent= false;
+      break;
+    } // endif
+
+    info.fileName= string(name);
+    frameCatalog.push_back(info);
+  } // endwhile
+  fclose(fp);
+
+  const int nFrames= frameCatalog.size();
+  if (!isCurrent || nFrames == 0) return false;
+
+  frameFileName(nFrames+1,fileName);
+  if (access(fileName,F_OK) == 0) return false;
+
+  return true;
+}
+
+
+void H5pio::writeFrameCatalog(XcCString catalogName)
+{
+  FILE *fp= fopen(catalogName,"w");
+  if (fp == nullptr) return; // read-only series; the catalog stays in memory
+
+  fprintf(fp,"# H5pio frame catalog: frameID time NumPart_ThisFile[6] mtime(ns) size fileName\n");
+
+  char fileName[XCUDA_PATH_LENGTH];
+
+  for (int f=0; f<frameCatalog.size(); f++) {
+    const FrameInfo &info= frameCatalog[f];
+    const int *np= info.nParticles;
+
+    long long modified= 0, size= 0;
+    frameFileName(info.frameID,fileName);
+    frameStamp(fileName,modified,size);
+
+    fprintf(fp,"%d %.8e %d %d %d %d %d %d %lld %lld %s\n",info.frameID,info.time,
+            np[0],np[1],np[2],np[3],np[4],np[5],modified,size,info.fileName.c_str());
+  } // endfor(f)
+
+  fclose(fp);
+}
+
+
+// ***** prefetch support *****
+//
+void H5pio::startPrefetch(const int firstFrameID)
+{
+  // bounded memory: prefetchDepth copies of the registered fields
+  //
+  prefetchPool.resize(prefetchDepth);
+  for (int s=0; s<prefetchDepth; s++) {
+    prefetchPool[s].buffers.resize(dataName.size());
+    for (int gid=0; gid<dataName.size(); gid++) {
+      if (dataPointer[gid] == nullptr) continue; // e.g. unbuffered derived fields
+      size_t nBytes= size_t(nParticles[dataParticleType[gid]])*getItemSize(gid);
+      prefetchPool[s].buffers[gid].resize(nBytes);
+    } // endfor(gid)
+  } // endfor(s)
+
+  prefetchReady= 0;
+  prefetchConsumed= 0;
+  prefetchStop= false;
+
+  prefetchThread= std::thread(&H5pio::prefetchReader,this,firstFrameID);
+}
+
+
+void H5pio::stopPrefetch(void)
+{
+  if (!prefetchThread.joinable()) return;
+
+  {
+    std::lock_guard<std::mutex> lock(prefetchMutex);
+    prefetchStop= true;
+  }
+  prefetchSignal.notify_all();
+  prefetchThread.join();
+
+  vector<PrefetchSlot>().swap(prefetchPool);
+  prefetchDepth= 0;
+  prefetchReady= 0;
+}
+
+
+void H5pio::prefetchReader(const int firstFrameID)
+{
+  for (long n=0; ; n++) {
+    long next;
+    {
+      std::unique_lock<std::mutex> lock(prefetchMutex);
+      prefetchSignal.wait(lock,[this]{ return prefetchStop || prefetchReady < prefetchDepth; });
+      if (prefetchStop) return;
+      next= prefetchConsumed + prefetchReady;
+    }
+
+    // the consumer never touches slots at or beyond prefetchConsumed+prefetchReady
+    //
+    PrefetchSlot &slot= prefetchPool[next % prefetchDepth];
+    slot.frameID= firstFrameID + n;
+    slot.time= 0.0f;
+
+    char fileName[XCUDA_PATH_LENGTH];
+    frameFileName(slot.frameID,fileName);
+    FILE *fp= fopen(fileName,"r");
+    slot.isEnd= bool(fp == nullptr);
+
+    if (fp) {
+      fclose(fp);
+
+      vector<void*> ptrs(dataName.size());
+      for (int gid=0; gid<dataName.size(); gid++) {
+        ptrs[gid]= (dataPointer[gid] != nullptr) ? slot.buffers[gid].data() : nullptr;
+      } // endfor(gid)
+
+      std::lock_guard<std::mutex> lock(h5Mutex);
+      hid_t fid= openProfiled(fileName,H5F_ACC_RDONLY,faplProfile);
+      XcHandleError(bool(fid<0),XCUDA_ERROR,"H5pio::prefetchReader",
+        "Unable to open an HDF5 file (check name and/or path)");
+      readH5Frame(fid,ptrs,&slot.time);
+      H5Fclose(fid);
+    } // endif
+
+    {
+      std::lock_guard<std::mutex> lock(prefetchMutex);
+      prefetchReady++;
+    }
+    prefetchSignal.notify_all();
+
+    if (slot.isEnd) return;
+  } // endfor(n)
+}
+
+
+// ***** prepared write plan *****
+//
+void H5pio::prepareFrame(void)
+{
+  std::lock_guard<std::mutex> lock(h5Mutex);
+
+  writePlanIsWanted= true;
+  buildWritePlan();
+}
+
+
+// The plan is used if prepareFrame() was called and the frame is
+// written as planned; with rebuild, a stale plan is rebuilt (the
+// caller holds h5Mutex), otherwise it is not used.
+//
+bool H5pio::usesWritePlan(const bool rebuild)
+{
+  if (!writePlanIsWanted || cheapCompression || frameStride > 1) return false;
+
+  bool matches= writePlan.isValid && writePlan.chunkRows == chunkRows &&
+                writePlan.dataspace.size() == dataName.size();
+  for (int type=0; type<N_TYPES && matches; type++) {
+    matches= (writePlan.nParticles[type] == nParticles[type]);
+  } // endfor(type)
+
+  if (!matches && rebuild) buildWritePlan();
+  return matches || rebuild;
+}
+
+
+void H5pio::buildWritePlan(void)
+{
+  releaseWritePlan();
+
+  const int nFields= dataName.size();
+  writePlan.chunkRows= chunkRows;
+  for (int type=0; type<N_TYPES; type++) writePlan.nParticles[type]= nParticles[type];
+  writePlan.dataspace.assign(nFields,-1);
+  writePlan.dcpl.assign(nFields,-1);
+  writePlan.memType.assign(nFields,-1);
+
+  hsize_t dims= 1;
+  writePlan.scalarSpace= H5Screate_simple(1,&dims,nullptr);
+  dims= N_TYPES;
+  writePlan.typesSpace= H5Screate_simple(1,&dims,nullptr);
+
+  for (int gid=0; gid<nFields; gid++) {
+    const int type= dataParticleType[gid];
+    const int np= nParticles[type];
+    if (np == 0 || (dataDerived[gid] >= 0 && dataPointer[gid] == nullptr)) continue;
+
+    const hsize_t dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+    hsize_t dims[2]= {hsize_t(np),dof};
+    writePlan.dataspace[gid]= H5Screate_simple(2,dims,nullptr);
+    writePlan.dcpl[gid]= H5Pcreate(H5P_DATASET_CREATE);
+    setCompression(writePlan.dcpl[gid],type,dataName[gid].c_str(),hsize_t(np),dof);
+    writePlan.memType[gid]= memTypeOf(gid);
+  } // endfor(gid)
+
+  // the fields' XDMF, written to memory with a marker for the file name
+  //
+  char *text= nullptr;
+  size_t size= 0;
+  FILE *stream= open_memstream(&text,&size);
+  XcHandleError(stream==nullptr,XCUDA_ERROR,"H5pio::buildWritePlan","Unable to open a memory stream");
+
+  writeXdmfFields(stream,"\x01",0);
+  fclose(stream);
+
+  writePlan.xdmfText.assign(1,string());
+  for (size_t i=0; i<size; i++) {
+    if (text[i] == '\x01') {
+      writePlan.xdmfText.push_back(string());
+    } else {
+      writePlan.xdmfText.back() += text[i];
+    } // endif
+  } // endfor(i)
+  free(text);
+
+  writePlan.isValid= true;
+}
+
+
+// the objects are gone if closeH5Library() was called first
+//
+void H5pio::releaseWritePlan(void)
+{
+  for (int gid=0; gid<writePlan.dataspace.size(); gid++) {
+    if (writePlan.dataspace[gid] >= 0 && H5Iis_valid(writePlan.dataspace[gid]) > 0) H5Sclose(writePlan.dataspace[gid]);
+    if (writePlan.dcpl[gid] >= 0 && H5Iis_valid(writePlan.dcpl[gid]) > 0) H5Pclose(writePlan.dcpl[gid]);
+  } // endfor(gid)
+  if (writePlan.scalarSpace >= 0 && H5Iis_valid(writePlan.scalarSpace) > 0) H5Sclose(writePlan.scalarSpace);
+  if (writePlan.typesSpace >= 0 && H5Iis_valid(writePlan.typesSpace) > 0) H5Sclose(writePlan.typesSpace);
+
+  writePlan.dataspace.clear();
+  writePlan.dcpl.clear();
+  writePlan.memType.clear();
+  writePlan.xdmfText.clear();
+  writePlan.scalarSpace= -1;
+  writePlan.typesSpace= -1;
+  writePlan.isValid= false;
+}
+
+
+// ***** I/O profiles *****
+//
+H5pio::IO_PROFILES H5pio::environmentIOProfile(void)
+{
+  const char *profileName= getenv("H5PIO_PROFILE");
+  if (profileName == nullptr || profileName[0] == '\0') return DefaultProfile;
+
+  if (strcasecmp(profileName,"default") == 0) return DefaultProfile;
+  if (strcasecmp(profileName,"lustre") == 0) return Lustre;
+  if (strcasecmp(profileName,"nvme") == 0) return NVMe;
+
+  XcHandleError(true,XCUDA_ERROR,"H5pio::environmentIOProfile",
+    "H5PIO_PROFILE must be default, lustre or nvme");
+  return DefaultProfile;
+}
+
+H5pio::IOProfile H5pio::getIOProfile(const IO_PROFILES profile)
+{
+  IOProfile p= {0,0,0,0,0,0,false};
+
+  switch (profile) {
+    case DefaultProfile:
+      break;
+    case Lustre:
+      p= {hsize_t(1)<<20,hsize_t(64)<<10,size_t(1)<<20,size_t(32)<<20,hsize_t(1)<<20,size_t(16)<<20,true};
+      break;
+    case NVMe:
+      p= {hsize_t(4)<<10,hsize_t(4)<<10,size_t(256)<<10,size_t(8)<<20,hsize_t(64)<<10,size_t(4)<<20,true};
+      break;
+  } // endswitch
+
+  return p;
+}
+
+
+void H5pio::setIOProfile(const IOProfile &profile)
+{
+  XcHandleError(profile.pageBufferBytes>0&&(profile.pageBytes==0||profile.pageBufferBytes<profile.pageBytes),
+    XCUDA_ERROR,"H5pio::setIOProfile","A page buffer needs paged file space and holds at least one page");
+
+  std::lock_guard<std::mutex> lock(h5Mutex);
+
+  if (fcplProfile != H5P_DEFAULT) H5Pclose(fcplProfile);
+  if (faplProfile != H5P_DEFAULT) H5Pclose(faplProfile);
+  if (faplUnpaged != H5P_DEFAULT) H5Pclose(faplUnpaged);
+  fcplProfile= H5P_DEFAULT;
+  faplProfile= H5P_DEFAULT;
+  faplUnpaged= H5P_DEFAULT;
+  ioProfile= profile;
+
+  if (profile.pageBytes > 0) {
+    fcplProfile= H5Pcreate(H5P_FILE_CREATE);
+    H5Pset_file_space_strategy(fcplProfile,H5F_FSPACE_STRATEGY_PAGE,false,1);
+    H5Pset_file_space_page_size(fcplProfile,profile.pageBytes);
+  } // endif
+
+  if (profile.alignment > 0 || profile.sieveBytes > 0 || profile.metadataCacheBytes > 0 ||
+      profile.pageBufferBytes > 0 || profile.latestFormat) {
+    faplProfile= H5Pcreate(H5P_FILE_ACCESS);
+
+    if (profile.alignment > 0) H5Pset_alignment(faplProfile,profile.alignThreshold,profile.alignment);
+    if (profile.sieveBytes > 0) H5Pset_sieve_buf_size(faplProfile,profile.sieveBytes);
+
+    if (profile.metadataCacheBytes > 0) {
+      H5AC_cache_config_t mdc;
+      mdc.version= H5AC__CURR_CACHE_CONFIG_VERSION;
+      H5Pget_mdc_config(faplProfile,&mdc);
+      mdc.set_initial_size= true;
+      mdc.initial_size= profile.metadataCacheBytes;
+      if (mdc.max_size < 4*profile.metadataCacheBytes) mdc.max_size= 4*profile.metadataCacheBytes;
+      if (mdc.min_size > profile.metadataCacheBytes) mdc.min_size= profile.metadataCacheBytes;
+      H5Pset_mdc_config(faplProfile,&mdc);
+    } // endif
+
+    if (profile.latestFormat) H5Pset_libver_bounds(faplProfile,H5F_LIBVER_LATEST,H5F_LIBVER_LATEST);
+
+    // files that were not written with paged space are opened without the page buffer
+    //
+    if (profile.pageBufferBytes > 0) {
+      faplUnpaged= H5Pcopy(faplProfile);
+      H5Pset_page_buffer_size(faplProfile,profile.pageBufferBytes,0,0);
+    } // endif
+  } // endif
+}
+
+
+hid_t H5pio::openProfiled(XcCString fileName, const unsigned flags, hid_t fapl_id)
+{
+  if (fapl_id != faplProfile || faplUnpaged == H5P_DEFAULT) return H5Fopen(fileName,flags,fapl_id);
+
+  hid_t fid;
+  H5E_BEGIN_TRY {
+    fid= H5Fopen(fileName,flags,faplProfile);
+  } H5E_END_TRY;
+  if (fid < 0) fid= H5Fopen(fileName,flags,faplUnpaged);
+
+  return fid;
+}
+
+
+// ***** incremental checkpoints *****
+//
+// 64-bit hash of a block of bytes, one multiply-xorshift step per word
+//
+static unsigned long long hashBlock(const char *p, const size_t n)
+{
+  unsigned long long h= 0x9e3779b97f4a7c15ULL ^ n;
+  size_t i= 0;
+  for (; i+8<=n; i+=8) {
+    unsigned long long w;
+    memcpy(&w,p+i,8);
+    h= (h ^ (w*0xbf58476d1ce4e5b9ULL))*0x94d049bb133111ebULL;
+    h ^= h >> 29;
+  } // endfor(i)
+
+  unsigned long long w= 0;
+  memcpy(&w,p+i,n-i);
+  h= (h ^ (w*0xbf58476d1ce4e5b9ULL))*0x94d049bb133111ebULL;
+  return h ^ (h >> 32);
+}
+
+
+static hsize_t datasetChunkRows(hid_t dataset_id)
+{
+  hsize_t cdims[2]= {0,0};
+  hid_t plist_id= H5Dget_create_plist(dataset_id);
+  if (H5Pget_layout(plist_id) == H5D_CHUNKED) H5Pget_chunk(plist_id,2,cdims);
+  H5Pclose(plist_id);
+
+  return cdims[0];
+}
+
+
+void H5pio::markDirty(const int type, XcCString name, const int row0, const int nRows)
+{
+  const int gid= findField(type,name);
+  XcHandleError(gid<0,XCUDA_ERROR,"H5pio::markDirty","Field is not registered");
+  XcHandleError(row0<0||nRows<0||long(row0)+nRows>nParticles[type],XCUDA_ERROR,"H5pio::markDirty",
+    "Rows are out of range");
+
+  if (dirtyRows.size() < dataName.size()) dirtyRows.resize(dataName.size());
+  if (nRows > 0) dirtyRows[gid].push_back(RowRange{row0,nRows});
+}
+
+
+void H5pio::markAllDirty(void)
+{
+  dirtyRows.assign(dataName.size(),vector<RowRange>());
+  for (int gid=0; gid<dataName.size(); gid++) {
+    const long np= nParticles[dataParticleType[gid]];
+    if (np > 0) dirtyRows[gid].push_back(RowRange{0,np});
+  } // endfor(gid)
+}
+
+
+long H5pio::saveCheckpoint(XcCString fileName, const float time, const bool forceFull)
+{
+  char hdf5File[XCUDA_PATH_LENGTH];
+  XCuda::stringCopy(hdf5File,fileName,XCUDA_PATH_LENGTH);
+  addSuffix(hdf5File,".hdf5");
+
+  // the marks only describe the file of the last checkpoint
+  const bool wholeFrame= saveStatistics || lodLevels > 0 || !zoneMapNames.empty();
+  const bool sameMarks= (dirtyTracking != MarkedRows || checkpointName == hdf5File);
+  const bool canUpdate= !forceFull && !wholeFrame && sameMarks && access(hdf5File,R_OK|W_OK) == 0;
+
+  if (dirtyRows.size() < dataName.size()) dirtyRows.resize(dataName.size());
+  if (checkpointHashes.size() < dataName.size()) checkpointHashes.resize(dataName.size());
+  if (checkpointName != hdf5File) {
+    for (int gid=0; gid<dataName.size(); gid++) checkpointHashes[gid].clear();
+  } // endif
+
+  long rows= -1;
+  {
+    std::lock_guard<std::mutex> lock(h5Mutex);
+
+    if (canUpdate) {
+      openH5File(hdf5File,false);
+      rows= writeCheckpointInPlace(time);
+      closeH5File();
+    } // endif
+
+    if (rows < 0) {
+      // chunks rewritten in place free their old space; it is kept
+      // in the file so later checkpoints reuse it
+      hid_t fcpl_id= (fcplProfile == H5P_DEFAULT) ? H5Pcreate(H5P_FILE_CREATE) : H5Pcopy(fcplProfile);
+      H5F_fspace_strategy_t strategy;
+      hbool_t persist;
+      hsize_t threshold;
+      H5Pget_file_space_strategy(fcpl_id,&strategy,&persist,&threshold);
+      H5Pset_file_space_strategy(fcpl_id,strategy,true,threshold);
+      openH5File(hdf5File,true,fcpl_id,faplProfile);
+      H5Pclose(fcpl_id);
+      saveH5Frame(time);
+
+      rows= 0;
+      for (int gid=0; gid<dataName.size(); gid++) {
+        const int type= dataParticleType[gid];
+        rows += nParticles[type];
+        if (dirtyTracking != BlockHashes || dataPointer[gid] == nullptr || dataDerived[gid] >= 0) continue;
+
+        char path[XCUDA_PATH_LENGTH];
+        snprintf(path,XCUDA_PATH_LENGTH,"PartType%d/%s",type,dataName[gid].c_str());
+        hid_t dataset_id= H5Dopen(file_id,path,H5P_DEFAULT);
+        hashChunks(dataPointer[gid],getItemSize(gid),nParticles[type],datasetChunkRows(dataset_id),
+                   checkpointHashes[gid]);
+        H5Dclose(dataset_id);
+      } // endfor(gid)
+      if (dirtyTracking == BlockHashes) writeChunkHashes();
+
+      closeH5File();
+    } // endif
+  }
+
+  checkpointName= string(hdf5File);
+  dirtyRows.assign(dataName.size(),vector<RowRange>());
+
+  return rows;
+}
+
+
+// The file must hold the registered particles and fields with the
+// same shapes; returns -1 otherwise, before anything is written. The
+// rows of the dirty chunks are written in runs of adjacent chunks.
+//
+long H5pio::writeCheckpointInPlace(const float time)
+{
+  int fileParticles[N_TYPES];
+  for (int type=0; type<N_TYPES; type++) fileParticles[type]= -1;
+  {
+    if (H5Lexists(file_id,"Header",H5P_DEFAULT) <= 0) return -1;
+    hid_t group_id= H5Gopen(file_id,"Header",H5P_DEFAULT);
+    readAttribute(group_id,H5T_NATIVE_INT,"NumPart_ThisFile",fileParticles);
+    H5Gclose(group_id);
+  }
+  for (int type=0; type<N_TYPES; type++) {
+    if (fileParticles[type] != nParticles[type]) return -1;
+  } // endfor(type)
+
+  const int nFields= dataName.size();
+  vector<hid_t> dataset(nFields,-1);
+  vector<hsize_t> cRows(nFields,0);
+  bool matches= true;
+
+  for (int gid=0; gid<nFields && matches; gid++) {
+    const int type= dataParticleType[gid];
+    if (nParticles[type] == 0) continue;
+    if (dataPointer[gid] == nullptr && dataDerived[gid] < 0) continue; // not written
+
+    char partType[16];
+    sprintf(partType,"PartType%d",type);
+    char path[XCUDA_PATH_LENGTH];
+    snprintf(path,XCUDA_PATH_LENGTH,"%s/%s",partType,dataName[gid].c_str());
+    if (H5Lexists(file_id,partType,H5P_DEFAULT) <= 0 || H5Lexists(file_id,path,H5P_DEFAULT) <= 0) {
+      matches= false;
+      break;
+    } // endif
+
+    dataset[gid]= H5Dopen(file_id,path,H5P_DEFAULT);
+    hid_t dataspace_id= H5Dget_space(dataset[gid]);
+    hsize_t dims[2]= {0,0};
+    const int rank= H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+    H5Sclose(dataspace_id);
+
+    const hsize_t dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+    cRows[gid]= datasetChunkRows(dataset[gid]);
+    matches= (rank == 2 && dims[0] == hsize_t(nParticles[type]) && dims[1] == dof && cRows[gid] > 0);
+  } // endfor(gid)
+
+  if (!matches) {
+    for (int gid=0; gid<nFields; gid++) if (dataset[gid] >= 0) H5Dclose(dataset[gid]);
+    return -1;
+  } // endif
+
+  // rows that changed: from the marks or hashes of the stored fields,
+  // and from the inputs of the derived ones
+  //
+  vector<vector<RowRange>> changed(nFields);
+  vector<char> dirty;
+
+  for (int gid=0; gid<nFields; gid++) {
+    if (dataset[gid] < 0 || dataDerived[gid] >= 0) continue;
+
+    findDirtyChunks(gid,dataset[gid],cRows[gid],dirty);
+    const long np= nParticles[dataParticleType[gid]];
+    for (long c=0; c<dirty.size(); c++) {
+      if (!dirty[c]) continue;
+      const long r0= c*long(cRows[gid]);
+      changed[gid].push_back(RowRange{r0,std::min(long(cRows[gid]),np-r0)});
+    } // endfor(c)
+  } // endfor(gid)
+
+  for (int gid=0; gid<nFields; gid++) {
+    if (dataset[gid] < 0 || dataDerived[gid] < 0) continue;
+    const DerivedField &d= derivedFields[dataDerived[gid]];
+    for (int k=0; k<d.inputs.size(); k++) {
+      const int ig= findField(dataParticleType[gid],d.inputs[k].c_str());
+      if (ig >= 0) changed[gid].insert(changed[gid].end(),changed[ig].begin(),changed[ig].end());
+    } // endfor(k)
+  } // endfor(gid)
+
+  // overwrite the dirty chunks
+  //
+  long rows= 0;
+
+  for (int gid=0; gid<nFields; gid++) {
+    if (dataset[gid] < 0) continue;
+
+    const long np= nParticles[dataParticleType[gid]];
+    const long cr= long(cRows[gid]);
+    const long nChunks= (np + cr-1)/cr;
+    const hsize_t dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+    const int itemSize= getItemSize(gid);
+
+    dirty.assign(nChunks,0);
+    for (const RowRange &r : changed[gid]) {
+      for (long c=r.row0/cr; c<=(r.row0+r.nRows-1)/cr; c++) dirty[c]= 1;
+    } // endfor(r)
+
+    vector<float> derived;
+    hid_t filespace_id= H5Dget_space(dataset[gid]);
+
+    for (long c0=0; c0<nChunks; ) {
+      if (!dirty[c0]) { c0++; continue; }
+      long c1= c0+1;
+      while (c1 < nChunks && dirty[c1]) c1++;
+
+      const long r0= c0*cr;
+      const long n= std::min(c1*cr,np) - r0;
+      const void *data= (char*)dataPointer[gid] + size_t(r0)*itemSize;
+      if (dataDerived[gid] >= 0) {
+        float *out= (float*)dataPointer[gid] + r0; // buffered: refreshed in place
+        if (dataPointer[gid] == nullptr) {
+          derived.resize(n);
+          out= derived.data();
+        } // endif
+        evaluateDerived(gid,dataPointer,r0,int(n),out);
+        data= out;
+      } // endif
+
+      hsize_t offset[2]= {hsize_t(r0),0};
+      hsize_t count[2]= {hsize_t(n),dof};
+      H5Sselect_hyperslab(filespace_id,H5S_SELECT_SET,offset,nullptr,count,nullptr);
+      hid_t memspace_id= H5Screate_simple(2,count,nullptr);
+      H5Dwrite(dataset[gid],memTypeOf(gid),memspace_id,filespace_id,H5P_DEFAULT,data);
+      H5Sclose(memspace_id);
+
+      rows += n;
+      c0= c1;
+    } // endfor(c0)
+
+    H5Sclose(filespace_id);
+    H5Dclose(dataset[gid]);
+  } // endfor(gid)
+
+  // header time, and the hashes of the new contents
+  //
+  frameTime= time;
+  hid_t group_id= H5Gopen(file_id,"Header",H5P_DEFAULT);
+  writeAttribute(group_id,H5T_NATIVE_FLOAT,"Time",&frameTime);
+  H5Gclose(group_id);
+
+  if (dirtyTracking == BlockHashes) {
+    writeChunkHashes();
+  } else if (H5Lexists(file_id,"ChunkHashes",H5P_DEFAULT) > 0) {
+    H5Ldelete(file_id,"ChunkHashes",H5P_DEFAULT); // no longer describes the file
+  } // endif
+
+  return rows;
+}
+
+
+void H5pio::findDirtyChunks(const int gid, hid_t dataset_id, const hsize_t cRows, vector<char> &dirty)
+{
+  const long np= nParticles[dataParticleType[gid]];
+  const long nChunks= (np + long(cRows)-1)/long(cRows);
+  dirty.assign(nChunks,0);
+
+  if (dirtyTracking == MarkedRows) {
+    for (const RowRange &r : dirtyRows[gid]) {
+      for (long c=r.row0/long(cRows); c<=(r.row0+r.nRows-1)/long(cRows); c++) dirty[c]= 1;
+    } // endfor(r)
+    return;
+  } // endif
+
+  if (checkpointHashes[gid].size() != nChunks) readChunkHashes(gid,nChunks);
+
+  vector<unsigned long long> hash;
+  hashChunks(dataPointer[gid],getItemSize(gid),np,cRows,hash);
+
+  const vector<unsigned long long> &stored= checkpointHashes[gid];
+  for (long c=0; c<nChunks; c++) dirty[c]= (stored.size() != nChunks || stored[c] != hash[c]);
+
+  checkpointHashes[gid].swap(hash);
+}
+
+
+void H5pio::readChunkHashes(const int gid, const hsize_t nChunks)
+{
+  checkpointHashes[gid].clear();
+
+  char group[XCUDA_PATH_LENGTH], path[XCUDA_PATH_LENGTH];
+  snprintf(group,XCUDA_PATH_LENGTH,"ChunkHashes/PartType%d",dataParticleType[gid]);
+  snprintf(path,XCUDA_PATH_LENGTH,"%s/%s",group,dataName[gid].c_str());
+  if (H5Lexists(file_id,"ChunkHashes",H5P_DEFAULT) <= 0) return;
+  if (H5Lexists(file_id,group,H5P_DEFAULT) <= 0) return;
+  if (H5Lexists(file_id,path,H5P_DEFAULT) <= 0) return;
+
+  hid_t dataset_id= H5Dopen(file_id,path,H5P_DEFAULT);
+  hid_t dataspace_id= H5Dget_space(dataset_id);
+  if (H5Sget_simple_extent_npoints(dataspace_id) == hssize_t(nChunks)) {
+    checkpointHashes[gid].resize(nChunks);
+    H5Dread(dataset_id,H5T_NATIVE_ULLONG,H5S_ALL,H5S_ALL,H5P_DEFAULT,checkpointHashes[gid].data());
+  } // endif
+  H5Sclose(dataspace_id);
+  H5Dclose(dataset_id);
+}
+
+
+// /ChunkHashes/PartType{t}/{name}: one hash per chunk of the dataset
+//
+void H5pio::writeChunkHashes(void)
+{
+  hid_t root_id= (H5Lexists(file_id,"ChunkHashes",H5P_DEFAULT) > 0)
+               ? H5Gopen(file_id,"ChunkHashes",H5P_DEFAULT)
+               : H5Gcreate(file_id,"ChunkHashes",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+
+  for (int gid=0; gid<dataName.size(); gid++) {
+    const vector<unsigned long long> &hash= checkpointHashes[gid];
+    if (hash.empty()) continue;
+
+    char partType[16];
+    sprintf(partType,"PartType%d",dataParticleType[gid]);
+    hid_t group_id= (H5Lexists(root_id,partType,H5P_DEFAULT) > 0)
+                  ? H5Gopen(root_id,partType,H5P_DEFAULT)
+                  : H5Gcreate(root_id,partType,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+
+    const char *name= dataName[gid].c_str();
+    hid_t dataset_id= -1;
+    if (H5Lexists(group_id,name,H5P_DEFAULT) > 0) {
+      dataset_id= H5Dopen(group_id,name,H5P_DEFAULT);
+      hid_t dataspace_id= H5Dget_space(dataset_id);
+      const bool sameSize= (H5Sget_simple_extent_npoints(dataspace_id) == hssize_t(hash.size()));
+      H5Sclose(dataspace_id);
+      if (!sameSize) {
+        H5Dclose(dataset_id);
+        H5Ldelete(group_id,name,H5P_DEFAULT);
+        dataset_id= -1;
+      } // endif
+    } // endif
+
+    if (dataset_id < 0) {
+      hsize_t dims= hash.size();
+      hid_t dataspace_id= H5Screate_simple(1,&dims,nullptr);
+      dataset_id= H5Dcreate(group_id,name,H5T_NATIVE_ULLONG,dataspace_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+      H5Sclose(dataspace_id);
+    } // endif
+
+    H5Dwrite(dataset_id,H5T_NATIVE_ULLONG,H5S_ALL,H5S_ALL,H5P_DEFAULT,hash.data());
+    H5Dclose(dataset_id);
+    H5Gclose(group_id);
+  } // endfor(gid)
+
+  H5Gclose(root_id);
+}
+
+
+void H5pio::hashChunks(const void *data, const int itemSize, const long np, const hsize_t cRows,
+                       vector<unsigned long long> &hash)
+{
+  const long cr= long(cRows);
+  const long nChunks= (np + cr-1)/cr;
+  hash.resize(nChunks);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (long c=0; c<nChunks; c++) {
+    const char *p= (const char*)data + size_t(c)*cr*itemSize;
+    hash[c]= hashBlock(p,size_t(std::min(cr,np-c*cr))*itemSize);
+  } // endfor(c)
+}
+
+
+// ***** I/O budget *****
+//
+void H5pio::setIOBudget(const float fraction, const int stride, XcCString logFile)
+{
+  XcHandleError(fraction>=1.0f,XCUDA_ERROR,"H5pio::setIOBudget","fraction >= 1");
+  XcHandleError(stride<2,XCUDA_ERROR,"H5pio::setIOBudget","stride < 2");
+
+  ioBudget= fraction;
+  budgetStride= stride;
+  budgetLogName= string(logFile);
+  budgetStart= wallSeconds();
+  budgetSpent= 0.0;
+  for (int m=0; m<SkippedFrame; m++) budgetCost[m]= -1.0;
+  budgetMode= FullFrame;
+}
+
+
+double H5pio::getIOFraction(void)
+{
+  const double elapsed= wallSeconds() - budgetStart;
+  return (ioBudget > 0.0f && elapsed > 0.0) ? budgetSpent/elapsed : 0.0;
+}
+
+
+double H5pio::wallSeconds(void)
+{
+  const std::chrono::duration<double> t= std::chrono::steady_clock::now().time_since_epoch();
+  return t.count();
+}
+
+
+// The frame fits if, with its estimated cost c, the time in
+// saveFrame() stays within the fraction f of the elapsed time:
+// spent + c <= f*(elapsed + c). The first frame measures the full
+// frame; until they are measured, a cheap frame is guessed at half of
+// it and a downsampled one at 1/stride of the cheap one.
+//
+H5pio::BUDGET_MODE H5pio::chooseBudgetMode(const bool isCheckpoint)
+{
+  if (isCheckpoint) return FullFrame;
+
+  const double f= ioBudget;
+  const double allowance= f*(wallSeconds() - budgetStart) - budgetSpent;
+
+  const double full= budgetCost[FullFrame];
+  if (full < 0.0) return FullFrame;
+
+  if (budgetCost[CheapFrame] < 0.0) budgetCost[CheapFrame]= 0.5*full;
+  if (budgetCost[DownsampledFrame] < 0.0) budgetCost[DownsampledFrame]= budgetCost[CheapFrame]/budgetStride;
+
+  for (int m=FullFrame; m<SkippedFrame; m++) {
+    if (budgetCost[m]*(1.0-f) <= allowance) return BUDGET_MODE(m);
+  } // endfor(m)
+
+  return SkippedFrame;
+}
+
+
+// Every budgetStride-th particle of each type is copied to temporary
+// buffers that stand in for the registered fields while the frame is
+// written. The masses are rescaled so each type keeps its total mass.
+// The frame goes to its own series, "{baseName}_DS_{frameID}.hdf5",
+// so the counts of the full series stay those registered.
+//
+void H5pio::writeDownsampledFrame(const float time)
+{
+  const vector<void*> registered= dataPointer;
+  int savedParticles[N_TYPES];
+  vector<vector<char>> copies(dataName.size());
+
+  for (int type=0; type<N_TYPES; type++) {
+    const int np= nParticles[type];
+    const int n= (np + budgetStride-1)/budgetStride;
+    savedParticles[type]= np;
+    if (np == 0) continue;
+
+    vector<int> index(n);
+    #pragma omp parallel for
+    for (int i=0; i<n; i++) index[i]= i*budgetStride;
+
+    for (int gid=0; gid<dataName.size(); gid++) {
+      if (dataParticleType[gid] != type || registered[gid] == nullptr) continue;
+
+      const int itemSize= getItemSize(gid);
+      copies[gid].resize(size_t(n)*itemSize);
+      gatherRows(registered[gid],itemSize,index.data(),n,copies[gid].data());
+      dataPointer[gid]= copies[gid].data();
+    } // endfor(gid)
+
+    const int gm= findField(type,"Masses");
+    if (gm >= 0 && registered[gm] != nullptr && dataIsFloat1D[gm]) {
+      const float *m0= (const float*)registered[gm];
+      float *m= (float*)dataPointer[gm];
+      double totalMass= 0.0, sampledMass= 0.0;
+      #pragma omp parallel for reduction(+:totalMass)
+      for (int i=0; i<np; i++) totalMass += m0[i];
+      #pragma omp parallel for reduction(+:sampledMass)
+      for (int i=0; i<n; i++) sampledMass += m[i];
+
+      const float scale= (sampledMass > 0.0) ? float(totalMass/sampledMass) : 0.0f;
+      #pragma omp parallel for
+      for (int i=0; i<n; i++) m[i] *= scale;
+    } // endif
+
+    nParticles[type]= n;
+  } // endfor(type)
+
+  downsampledFrameID++;
+  char fileName[XCUDA_PATH_LENGTH];
+  snprintf(fileName,XCUDA_PATH_LENGTH,"%s_DS_%04d.hdf5",theBaseName,downsampledFrameID);
+
+  frameStride= budgetStride;
+  writeFrameFiles(fileName,time);
+  frameStride= 1;
+
+  dataPointer= registered;
+  for (int type=0; type<N_TYPES; type++) nParticles[type]= savedParticles[type];
+}
+
+
+void H5pio::logBudget(const float time, const bool isCheckpoint, const double estimate, const double cost)
+{
+  char logName[XCUDA_PATH_LENGTH];
+  if (budgetLogName.empty()) {
+    snprintf(logName,XCUDA_PATH_LENGTH,"%s.iolog",theBaseName);
+  } else {
+    XCuda::stringCopy(logName,budgetLogName.c_str(),XCUDA_PATH_LENGTH);
+  } // endif
+
+  struct stat st;
+  const bool isNew= (stat(logName,&st) != 0);
+
+  FILE *fp= fopen(logName,"a");
+  if (fp == nullptr) return;
+
+  const char *mode[]= {"full","cheap","downsampled","skipped"};
+  if (isNew) {
+    fprintf(fp,"# H5pio I/O budget %.4f: frameID time mode checkpoint estimate[s] cost[s] elapsed[s] spent[s]\n",
+            ioBudget);
+  } // endif
+
+  const int frameID= (budgetMode == SkippedFrame) ? 0 :
+                     (budgetMode == DownsampledFrame) ? downsampledFrameID : multiTemporalFrameID;
+  fprintf(fp,"%d %.8e %s %d %.4e %.4e %.4e %.4e\n",frameID,
+          time,mode[budgetMode],int(isCheckpoint),estimate,cost,wallSeconds()-budgetStart,budgetSpent);
+  fclose(fp);
+}
+
+
+// ***** compression autotuning *****
+//
+static const int TUNE_SAMPLE_CHUNKS= 4;
+
+void H5pio::setAutotune(const bool enable, const TUNE_GOAL goal, const double bytesPerSecond)
+{
+  XcHandleError(bytesPerSecond<=0.0,XCUDA_ERROR,"H5pio::setAutotune","bytesPerSecond <= 0");
+
+  autotuneOnSave= enable;
+  tuneGoal= goal;
+  tuneBandwidth= bytesPerSecond;
+}
+
+
+void H5pio::autotune(void)
+{
+  autotuneFrame(true);
+}
+
+
+// Tunes the datasets of /PartType{t} in a snapshot and writes the
+// .tune file of its series.
+//
+void H5pio::autotune(XcCString snapshotFile)
+{
+  char fileName[XCUDA_PATH_LENGTH];
+  XCuda::stringCopy(fileName,snapshotFile,XCUDA_PATH_LENGTH);
+  addSuffix(fileName,".hdf5");
+
+  {
+    std::lock_guard<std::mutex> lock(h5Mutex);
+
+    hid_t fid= openProfiled(fileName,H5F_ACC_RDONLY,faplProfile);
+    XcHandleError(bool(fid<0),XCUDA_ERROR,"H5pio::autotune",
+      "Unable to open an HDF5 file (check name and/or path)");
+
+    for (int type=0; type<N_TYPES; type++) {
+      char partType[16];
+      sprintf(partType,"PartType%d",type);
+      if (H5Lexists(fid,partType,H5P_DEFAULT) <= 0) continue;
+
+      hid_t group_id= H5Gopen(fid,partType,H5P_DEFAULT);
+      H5G_info_t info;
+      H5Gget_info(group_id,&info);
+
+      for (hsize_t k=0; k<info.nlinks; k++) {
+        char name[XCUDA_PATH_LENGTH];
+        H5Lget_name_by_idx(group_id,".",H5_INDEX_NAME,H5_ITER_INC,k,name,XCUDA_PATH_LENGTH,H5P_DEFAULT);
+
+        hid_t dataset_id;
+        H5E_BEGIN_TRY {
+          dataset_id= H5Dopen(group_id,name,H5P_DEFAULT);
+        } H5E_END_TRY;
+        if (dataset_id < 0) continue; // e.g. a level-of-detail group
+
+        hid_t dataspace_id= H5Dget_space(dataset_id);
+        hsize_t dims[2]= {0,0};
+        const int rank= H5Sget_simple_extent_ndims(dataspace_id);
+        if (rank == 2 && H5Sget_simple_extent_dims(dataspace_id,dims,nullptr) == 2 && dims[0] > 0) {
+          hid_t fileType= H5Dget_type(dataset_id);
+          hid_t memType= H5Tget_native_type(fileType,H5T_DIR_ASCEND);
+
+          const hsize_t m= std::min(dims[0],hsize_t(TUNE_SAMPLE_CHUNKS)*chunkRows);
+          hsize_t offset[2]= {(dims[0]-m)/2,0};
+          hsize_t count[2]= {m,dims[1]};
+          vector<char> sample(size_t(m*dims[1])*H5Tget_size(memType));
+
+          H5Sselect_hyperslab(dataspace_id,H5S_SELECT_SET,offset,nullptr,count,nullptr);
+          hid_t memspace_id= H5Screate_simple(2,count,nullptr);
+          H5Dread(dataset_id,memType,memspace_id,dataspace_id,H5P_DEFAULT,sample.data());
+          H5Sclose(memspace_id);
+
+          char key[XCUDA_PATH_LENGTH];
+          snprintf(key,XCUDA_PATH_LENGTH,"%s/%s",partType,name);
+          setTuning(tuneField(key,memType,int(dims[1]),sample.data(),m));
+
+          H5Tclose(memType);
+          H5Tclose(fileType);
+        } // endif
+        H5Sclose(dataspace_id);
+        H5Dclose(dataset_id);
+      } // endfor(k)
+      H5Gclose(group_id);
+    } // endfor(type)
+
+    H5Fclose(fid);
+  }
+
+  char tuneName[XCUDA_PATH_LENGTH];
+  XCuda::stringCopy(tuneName,fileName,XCUDA_PATH_LENGTH);
+  stripSuffix(tuneName);
+  stripID(tuneName);
+  XCuda::stringCat(tuneName,".tune",XCUDA_PATH_LENGTH);
+  writeTuning(tuneName);
+}
+
+
+// Tunes the registered fields that have particles, from a sample in
+// the middle of each; unless retune, only the fields not yet tuned
+// (after reading the series' .tune file once).
+//
+void H5pio::autotuneFrame(const bool retune)
+{
+  char tuneName[XCUDA_PATH_LENGTH];
+  snprintf(tuneName,XCUDA_PATH_LENGTH,"%s.tune",theBaseName);
+
+  if (!retune && tuning.empty() && theBaseName[0] != '\0') readTuning(tuneName);
+
+  bool changed= false;
+
+  for (int gid=0; gid<dataName.size(); gid++) {
+    const int type= dataParticleType[gid];
+    const long np= nParticles[type];
+    if (np == 0) continue;
+    if (dataPointer[gid] == nullptr && dataDerived[gid] < 0) continue;
+
+    char key[XCUDA_PATH_LENGTH];
+    snprintf(key,XCUDA_PATH_LENGTH,"PartType%d/%s",type,dataName[gid].c_str());
+
+    bool isTuned= false;
+    for (int k=0; k<tuning.size(); k++) isTuned= isTuned || (tuning[k].key == key);
+    if (isTuned && !retune) continue;
+
+    const long m= std::min(np,long(TUNE_SAMPLE_CHUNKS)*chunkRows);
+    const long row0= (np-m)/2;
+    const int dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+
+    // derived fields are evaluated for the sample only
+    //
+    vector<float> derived;
+    const void *sample= (char*)dataPointer[gid] + size_t(row0)*getItemSize(gid);
+    if (dataDerived[gid] >= 0) {
+      derived.resize(m);
+      evaluateDerived(gid,dataPointer,row0,int(m),derived.data());
+      sample= derived.data();
+    } // endif
+
+    {
+      std::lock_guard<std::mutex> lock(h5Mutex);
+      setTuning(tuneField(key,memTypeOf(gid),dof,sample,hsize_t(m)));
+    }
+    changed= true;
+  } // endfor(gid)
+
+  if (changed && theBaseName[0] != '\0') writeTuning(tuneName);
+}
+
+
+// Writes the sample with each candidate to an in-memory file; the
+// caller holds h5Mutex.
+//
+H5pio::TunedField H5pio::tuneField(XcCString key, hid_t memType, const int dof, const void *sample,
+                                   const hsize_t rows)
+{
+  struct Trial {Compression compression; double seconds; double bytes;};
+
+  const double rawBytes= double(rows)*dof*H5Tget_size(memType);
+
+  auto measure= [&](const Compression &c) {
+    hid_t fapl_id= H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_core(fapl_id,size_t(rawBytes)+(size_t(1)<<20),false);
+    hid_t fid= H5Fcreate("H5pio_autotune",H5F_ACC_TRUNC,H5P_DEFAULT,fapl_id);
+    XcHandleError(bool(fid<0),XCUDA_ERROR,"H5pio::tuneField","Unable to create an in-memory file");
+
+    hsize_t dims[2]= {rows,hsize_t(dof)};
+    hsize_t cdims[2]= {std::min(rows,hsize_t(c.chunkRows)),hsize_t(dof)};
+    hid_t dataspace_id= H5Screate_simple(2,dims,nullptr);
+    hid_t plist_id= H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(plist_id,2,cdims);
+    if (c.shuffle) H5Pset_shuffle(plist_id);
+    if (c.level > 0) H5Pset_deflate(plist_id,c.level);
+    hid_t dataset_id= H5Dcreate(fid,"sample",memType,dataspace_id,H5P_DEFAULT,plist_id,H5P_DEFAULT);
+
+    const auto start= std::chrono::steady_clock::now();
+    H5Dwrite(dataset_id,memType,H5S_ALL,H5S_ALL,H5P_DEFAULT,sample);
+    H5Dflush(dataset_id);
+    const std::chrono::duration<double> elapsed= std::chrono::steady_clock::now() - start;
+
+    Trial trial= {c,elapsed.count(),double(H5Dget_storage_size(dataset_id))};
+
+    H5Dclose(dataset_id);
+    H5Pclose(plist_id);
+    H5Sclose(dataspace_id);
+    H5Fclose(fid);
+    H5Pclose(fapl_id);
+
+    return trial;
+  };
+
+  // the goal's choice among trials
+  //
+  auto choose= [&](const vector<Trial> &trials) {
+    vector<double> effective(trials.size());
+    double smallest= 1.0e30;
+    for (int i=0; i<trials.size(); i++) {
+      effective[i]= trials[i].seconds + trials[i].bytes/tuneBandwidth;
+      smallest= std::min(smallest,trials[i].bytes);
+    } // endfor(i)
+
+    int best= -1;
+    for (int i=0; i<trials.size(); i++) {
+      bool better= false;
+      if (tuneGoal == MaxThroughput) {
+        better= (best < 0 || effective[i] < effective[best]);
+      } else if (tuneGoal == MinSize) {
+        better= (trials[i].bytes <= 1.01*smallest) && (best < 0 || trials[i].seconds < trials[best].seconds);
+      } else {
+        better= (best < 0 || trials[i].bytes*effective[i] < trials[best].bytes*effective[best]);
+      } // endif
+      if (better) best= i;
+    } // endfor(i)
+
+    return trials[best];
+  };
+
+  // deflate level and shuffle at chunkRows, then the chunk size
+  //
+  const int levels[]= {0,1,3,6,9};
+  vector<Trial> trials;
+  for (int level : levels) {
+    trials.push_back(measure(Compression{level,false,chunkRows}));
+    if (level > 0) trials.push_back(measure(Compression{level,true,chunkRows}));
+  } // endfor(level)
+  Trial best= choose(trials);
+
+  trials.assign(1,best);
+  for (int divisor=2; divisor<=4; divisor*=2) {
+    if (chunkRows/divisor < 1) break;
+    Compression c= best.compression;
+    c.chunkRows= chunkRows/divisor;
+    trials.push_back(measure(c));
+  } // endfor(divisor)
+  best= choose(trials);
+
+  TunedField field;
+  field.key= string(key);
+  field.compression= best.compression;
+  field.ratio= float(rawBytes/std::max(best.bytes,1.0));
+  field.bytesPerSecond= float(rawBytes/std::max(best.seconds,1.0e-9));
+
+  return field;
+}
+
+
+void H5pio::setTuning(const TunedField &field)
+{
+  writePlan.isValid= false;
+
+  for (int k=0; k<tuning.size(); k++) {
+    if (tuning[k].key == field.key) {
+      tuning[k]= field;
+      return;
+    } // endif
+  } // endfor(k)
+
+  tuning.push_back(field);
+}
+
+
+H5pio::Compression H5pio::getCompression(const int type, XcCString name)
+{
+  char key[XCUDA_PATH_LENGTH];
+  snprintf(key,XCUDA_PATH_LENGTH,"PartType%d/%s",type,name);
+
+  for (int k=0; k<tuning.size(); k++) {
+    if (tuning[k].key == key) return tuning[k].compression;
+  } // endfor(k)
+
+  return Compression{6,false,chunkRows};
+}
+
+
+bool H5pio::readTuning(XcCString fileName)
+{
+  FILE *fp= fopen(fileName,"r");
+  if (fp == nullptr) return false;
+
+  char line[XCUDA_PATH_LENGTH];
+  while (fgets(line,XCUDA_PATH_LENGTH,fp)) {
+    if (line[0] == '#') continue;
+
+    TunedField field;
+    char key[XCUDA_PATH_LENGTH];
+    int shuffle= 0;
+    field.ratio= 0.0f;
+    field.bytesPerSecond= 0.0f;
+    int n= sscanf(line,"%s %d %d %d %e %e",key,&field.compression.level,&shuffle,
+                  &field.compression.chunkRows,&field.ratio,&field.bytesPerSecond);
+    if (n < 4 || field.compression.chunkRows < 1) continue;
+
+    field.key= string(key);
+    field.compression.shuffle= (shuffle != 0);
+    setTuning(field);
+  } // endwhile
+  fclose(fp);
+
+  return true;
+}
+
+
+void H5pio::writeTuning(XcCString fileName)
+{
+  FILE *fp= fopen(fileName,"w");
+  if (fp == nullptr) return; // read-only series; the tuning stays in memory
+
+  const char *goal[]= {"MaxThroughput","MinSize","Balanced"};
+  fprintf(fp,"# H5pio compression tuning (%s, %.3e B/s): field level shuffle chunkRows ratio bytesPerSecond\n",
+          goal[tuneGoal],tuneBandwidth);
+
+  for (int k=0; k<tuning.size(); k++) {
+    const TunedField &field= tuning[k];
+    fprintf(fp,"%s %d %d %d %.4e %.4e\n",field.key.c_str(),field.compression.level,
+            int(field.compression.shuffle),field.compression.chunkRows,field.ratio,field.bytesPerSecond);
+  } // endfor(k)
+
+  fclose(fp);
+}
+
+
+// Chunks and filters of dataset name in group_id, from the tuning of
+// its particle type (also for the level-of-detail groups below it).
+//
+void H5pio::setCompression(hid_t plist_id, hid_t group_id, XcCString name, const hsize_t rows, const hsize_t dof)
+{
+  char path[XCUDA_PATH_LENGTH];
+  int type= -1;
+  if (H5Iget_name(group_id,path,XCUDA_PATH_LENGTH) > 0) sscanf(path,"/PartType%d",&type);
+
+  setCompression(plist_id,type,name,rows,dof);
+}
+
+void H5pio::setCompression(hid_t plist_id, const int type, XcCString name, const hsize_t rows, const hsize_t dof)
+{
+  Compression c= (type >= 0) ? getCompression(type,name) : Compression{6,false,chunkRows};
+  if (cheapCompression && c.level > 1) {
+    c.level= 1;
+    c.shuffle= true;
+  } // endif
+
+  hsize_t cdims[2]= {std::min(rows,hsize_t(c.chunkRows)),dof};
+  H5Pset_chunk(plist_id,2,cdims);
+  if (c.shuffle) H5Pset_shuffle(plist_id);
+  if (c.level > 0) H5Pset_deflate(plist_id,c.level);
+}
+
+
+// ***** utilities for HDF5 I/O *****
+//
+void H5pio::openH5File(XcCString fileName, const bool createFile)
+{
+  openH5File(fileName,createFile,fcplProfile,faplProfile);
+}
+
+void H5pio::openH5File(XcCString fileName, const bool createFile, hid_t fcpl_id, hid_t fapl_id)
+{
+  frameTime= 0.0f;
+  endOfFile= false;
+
+  XCuda::stringCopy(hdf5Name,fileName,XCUDA_PATH_LENGTH);
+  addSuffix(hdf5Name,".hdf5");
+
+  for (int i=0; i<N_TYPES; i++) streamRows[i]= 0;
+
+  if (createFile) {
+    file_id= H5Fcreate(hdf5Name,H5F_ACC_TRUNC,fcpl_id,fapl_id);
+  } else {
+    file_id= openProfiled(hdf5Name,H5F_ACC_RDWR,fapl_id); // 02/21/2020 H5F_ACC_RDONLY
+  }
+
+  XcHandleError(bool(file_id<0),XCUDA_ERROR,"H5pio::openH5File",
+    "Unable to create or open an HDF5 file (check name and/or path)");
+
+  fileIsOpen= true;
+}
+
+void H5pio::closeH5File(void)
+{
+  if (!fileIsOpen) return;
+
+  H5Fclose(file_id);
+  fileIsOpen= false;
+
+  frameTime= 0.0f;
+  endOfFile= true;
+}
+
+void H5pio::saveH5Frame(const float time)
+{
+  if (!fileIsOpen || endOfFile) return;
+
+  frameTime= time;
+  const bool planned= usesWritePlan(true);
+
+  writeH5Header();
+
+  lodCount.assign(size_t(lodLevels+1)*N_TYPES,0);
+
+  for (int type=0; type<N_TYPES; type++) {
+    const int np= nParticles[type];
+    if (np > 0) {
+
+      char partType[16];
+      sprintf(partType,"PartType%d",type);
+
+      evaluateDerivedFields(type,dataPointer,np);
+
+      hid_t group_id= H5Gcreate(file_id,partType,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+      {
+        for (int gid=0; gid<dataName.size(); gid++) {
+          if (dataParticleType[gid] == type) {
+
+            bool isNodeCentered= dataIsNodeCentered[gid]; // N/A
+            bool isBoolean1D= dataIsBoolean1D[gid];
+            bool isInteger1D= dataIsInteger1D[gid];
+            bool isFloat1D= dataIsFloat1D[gid];
+            bool isFloat3D= dataIsFloat3D[gid];
+            bool isGeometry3D= dataIsGeometry3D[gid];
+            char *name= (char*)dataName[gid].c_str();
+            void *ptr= dataPointer[gid];
+
+            if (dataDerived[gid] >= 0 && ptr == nullptr) {
+              writeDerivedDataset(group_id,gid,np);
+            } else if (planned && writePlan.dataspace[gid] >= 0) {
+              if (ptr != nullptr) {
+                hid_t dataset_id= H5Dcreate(group_id,name,writePlan.memType[gid],writePlan.dataspace[gid],
+                                            H5P_DEFAULT,writePlan.dcpl[gid],H5P_DEFAULT);
+                H5Dwrite(dataset_id,writePlan.memType[gid],H5S_ALL,H5S_ALL,H5P_DEFAULT,ptr);
+                H5Dclose(dataset_id);
+              } // endif
+            } else if (isBoolean1D) {
+              writeDataset(group_id,H5T_NATIVE_HBOOL,np,1,name,ptr);
+            } else if (isInteger1D) {
+              writeDataset(group_id,H5T_NATIVE_INT,np,1,name,ptr);
+            } else if (isFloat1D) {
+              writeDataset(group_id,H5T_NATIVE_FLOAT,np,1,name,ptr);
+            } else if (isFloat3D) {
+              writeDataset(group_id,H5T_NATIVE_FLOAT,np,3,name,ptr);
+            } else if (isGeometry3D) {
+              writeDataset(group_id,H5T_NATIVE_FLOAT,np,3,name,ptr);
+            } // endif
+
+            if (isZoneMapField(gid)) writeZoneMap(type,gid,np);
+            if (saveStatistics) writeStatistics(type,gid,np,group_id);
+
+          } // endif
+        } // endfor(gid)
+
+        if (lodLevels > 0) writeLevelsOfDetail(type,np,group_id);
+      }
+      H5Gclose(group_id);
+
+    } // endif
+  } // endfor(type)
+}
+
+
+void H5pio::writeH5Header(void)
+{
+  hid_t group_id= H5Gcreate(file_id,"Header",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  {
+    int flag_DoublePrecision= 0; // single for now
+    float massTable[N_TYPES]; for (int i=0; i<N_TYPES; i++) massTable[i]= 0.0f; // in datasets
+    int numFilesPerSnapshot= 1;
+    int numPart_Total_HighWord[N_TYPES]; for (int i=0; i<N_TYPES; i++) numPart_Total_HighWord[i]= 0; // ?
+
+    // the group is new: with a write plan, the attributes are created
+    // on its dataspaces without looking for existing ones
+    //
+    const bool planned= usesWritePlan(false);
+    auto attribute= [&](hid_t type, XcCString name, void *data, const int nDims) {
+      if (!planned) {
+        writeAttribute(group_id,type,name,data,nDims);
+        return;
+      } // endif
+      hid_t space_id= (nDims == 1) ? writePlan.scalarSpace : writePlan.typesSpace;
+      hid_t attribute_id= H5Acreate(group_id,name,type,space_id,H5P_DEFAULT,H5P_DEFAULT);
+      H5Awrite(attribute_id,type,data);
+      H5Aclose(attribute_id);
+    };
+
+    attribute(H5T_NATIVE_INT,   "Flag_DoublePrecision", &flag_DoublePrecision, 1);
+    attribute(H5T_NATIVE_FLOAT, "MassTable", &massTable, N_TYPES);
+    attribute(H5T_NATIVE_INT,   "NumFilesPerSnapshot", &numFilesPerSnapshot, 1);
+    attribute(H5T_NATIVE_INT,   "NumPart_ThisFile", nParticles, N_TYPES);
+    attribute(H5T_NATIVE_INT,   "NumPart_Total", &nParticles, N_TYPES);
+    attribute(H5T_NATIVE_INT,   "NumPart_Total_HighWord", &numPart_Total_HighWord, N_TYPES);
+    attribute(H5T_NATIVE_FLOAT, "Time", &frameTime, 1);
+    if (frameStride > 1) attribute(H5T_NATIVE_INT,"DownsampleStride",&frameStride,1);
+  }
+  H5Gclose(group_id);
+}
+
+
+void H5pio::loadH5Frame(void)
+{
+  if (!fileIsOpen) return;
+
+  readH5Frame(file_id,dataPointer,&frameTime);
+}
+
+
+// Reads the registered fields of an open file into ptrs[], which
+// is parallel to dataPointer[]. Does not touch the object's file
+// state, so it may be called by the prefetch thread.
+//
+void H5pio::readH5Frame(hid_t fid, const vector<void*> &ptrs, float *time)
+{
+  hid_t group_id= H5Gopen(fid,"Header",H5P_DEFAULT);
+  {
+    int np[N_TYPES];
+    *time= 0.0f;
+    
+    readAttribute(group_id,H5T_NATIVE_INT,"NumPart_ThisFile",np);
+    readAttribute(group_id,H5T_NATIVE_FLOAT,"Time",time);
+
+    for (int i=0; i<N_TYPES; i++) {
+      XcHandleError(bool(np[i] != nParticles[i]),XCUDA_ERROR,"H5pio::loadH5Frame",
+        "Inconsistent number of particles; bad checkpoint file?");
+    } // endfor
+  }
+  H5Gclose(group_id);
+
+  for (int type=0; type<N_TYPES; type++) {
+    const int np= nParticles[type];
+    if (np > 0) {
+
+      char partType[16];
+      sprintf(partType,"PartType%d",type);
+
+      hid_t group_id= H5Gopen(fid,partType,H5P_DEFAULT);
+      {
+
+        for (int gid=0; gid<dataName.size(); gid++) {
+          if (dataParticleType[gid] == type && dataDerived[gid] < 0) {
+
+            bool isNodeCentered= dataIsNodeCentered[gid]; // N/A
+            bool isBoolean1D= dataIsBoolean1D[gid];
+            bool isInteger1D= dataIsInteger1D[gid];
+            bool isFloat1D= dataIsFloat1D[gid];
+            bool isFloat3D= dataIsFloat3D[gid];
+            bool isGeometry3D= dataIsGeometry3D[gid];
+            char *name= (char*)dataName[gid].c_str();
+            void *ptr= ptrs[gid];
+
+            if (isBoolean1D) {
+              readDataset(group_id,H5T_NATIVE_HBOOL,name,ptr);
+            } else if (isInteger1D) {
+              readDataset(group_id,H5T_NATIVE_INT,name,ptr);
+            } else if (isFloat1D) {
+              readDataset(group_id,H5T_NATIVE_FLOAT,name,ptr);
+            } else if (isFloat3D) {
+              readDataset(group_id,H5T_NATIVE_FLOAT,name,ptr);
+            } else if (isGeometry3D) {
+              readDataset(group_id,H5T_NATIVE_FLOAT,name,ptr);
+            }
+
+          } // endif
+        } // endfor(gid)
+      }
+      H5Gclose(group_id);
+
+
+    } // endif
+  } // endfor(type)
+
+  if (sortByID) sortFieldsByID(ptrs);
+
+  for (int type=0; type<N_TYPES; type++) evaluateDerivedFields(type,ptrs,nParticles[type]);
+}
+
+
+// One radix sort of the IDs per type; the permutation is then
+// applied to every registered field of that type.
+//
+void H5pio::sortFieldsByID(const vector<void*> &ptrs)
+{
+  vector<int> perm;
+
+  for (int type=0; type<N_TYPES; type++) {
+    const int np= nParticles[type];
+    const int idGid= findField(type,"ParticleIDs");
+    if (np <= 1 || idGid < 0 || ptrs[idGid] == nullptr) continue;
+
+    perm.resize(np);
+    sortPermutation((int*)ptrs[idGid],np,perm.data());
+
+    for (int gid=0; gid<dataName.size(); gid++) {
+      if (dataParticleType[gid] == type && ptrs[gid] != nullptr && dataDerived[gid] < 0) {
+        gatherField(ptrs[gid],getItemSize(gid),perm.data(),np);
+      }
+    } // endfor(gid)
+  } // endfor(type)
+}
+
+// ***** subset export and streamed writing *****
+//
+hid_t H5pio::memTypeOf(const int gid)
+{
+  if (dataIsBoolean1D[gid]) return H5T_NATIVE_HBOOL;
+  if (dataIsInteger1D[gid]) return H5T_NATIVE_INT;
+  return H5T_NATIVE_FLOAT;
+}
+
+
+// mask[i]= 1 if particle i of type satisfies every range
+//
+void H5pio::selectRanges(const int type, const vector<Range> &where, unsigned char *mask)
+{
+  const int np= nParticles[type];
+
+  #pragma omp parallel for simd
+  for (int i=0; i<np; i++) mask[i]= 1;
+
+  for (int p=0; p<where.size(); p++) {
+    const int gid= findField(type,where[p].name.c_str());
+    const double lo= where[p].lo;
+    const double hi= where[p].hi;
+
+    if (dataIsFloat1D[gid]) {
+      const float *v= (const float*)dataPointer[gid];
+      #pragma omp parallel for simd
+      for (int i=0; i<np; i++) mask[i] &= (unsigned char)((v[i] >= lo) & (v[i] <= hi));
+    } else if (dataIsInteger1D[gid]) {
+      const int *v= (const int*)dataPointer[gid];
+      #pragma omp parallel for simd
+      for (int i=0; i<np; i++) mask[i] &= (unsigned char)((v[i] >= lo) & (v[i] <= hi));
+    } else {
+      XcHandleError(true,XCUDA_ERROR,"H5pio::exportFrame","Range fields must be float or integer scalars");
+    }
+  } // endfor(p)
+}
+
+
+void H5pio::exportFrame(XcCString fileName, const vector<Range> &where)
+{
+  vector< vector<unsigned char> > masks(N_TYPES);
+  const unsigned char *maskPtr[N_TYPES];
+
+  for (int type=0; type<N_TYPES; type++) {
+    bool hasFields= (nParticles[type] > 0);
+    for (int p=0; p<where.size() && hasFields; p++) {
+      const int gid= findField(type,where[p].name.c_str());
+      hasFields= (gid >= 0) && (dataPointer[gid] != nullptr);
+    } // endfor(p)
+
+    // types without every range field are left out (all-zero mask)
+    //
+    masks[type].assign(nParticles[type],0);
+    if (hasFields) selectRanges(type,where,masks[type].data());
+    maskPtr[type]= masks[type].data();
+  } // endfor(type)
+
+  exportFrame(fileName,maskPtr);
+}
+
+
+// Compacts every registered field of every type with the masks, then
+// writes the compacted copy as a complete snapshot and XDMF file.
+//
+void H5pio::exportFrame(XcCString fileName, const unsigned char *masks[N_TYPES])
+{
+  H5pio subset;
+  subset.setIOProfile(ioProfile);
+  subset.chunkRows= chunkRows;
+  subset.tuning= tuning;
+  subset.saveStatistics= saveStatistics;
+  subset.statisticsBins= statisticsBins;
+  subset.zoneMapNames= zoneMapNames;
+
+  vector< vector<char> > buffers(dataName.size());
+  vector<int> index;
+
+  for (int type=0; type<N_TYPES; type++) {
+    const int np= nParticles[type];
+    if (np == 0) continue;
+
+    index.resize(np);
+    const int nSel= (masks[type] != nullptr) ? selectIndices(masks[type],np,index.data()) : np;
+    if (nSel == 0) continue;
+
+    if (masks[type] == nullptr) {
+      #pragma omp parallel for simd
+      for (int i=0; i<np; i++) index[i]= i;
+    }
+
+    subset.registerParticles(nSel,type);
+
+    for (int gid=0; gid<dataName.size(); gid++) {
+      if (dataParticleType[gid] != type) continue;
+
+      if (dataPointer[gid] == nullptr) {
+        if (dataDerived[gid] >= 0) registerFieldLike(subset,gid,nullptr); // evaluated by subset.saveH5Frame()
+        continue;
+      } // endif
+
+      const int itemSize= getItemSize(gid);
+      buffers[gid].resize(size_t(nSel)*itemSize);
+      gatherRows(dataPointer[gid],itemSize,index.data(),nSel,buffers[gid].data());
+
+      registerFieldLike(subset,gid,buffers[gid].data());
+    } // endfor(gid)
+  } // endfor(type)
+
+  std::lock_guard<std::mutex> lock(h5Mutex);
+
+  subset.openH5File(fileName,true);
+  subset.openXdmfFile();
+  subset.saveH5Frame(frameTime);
+  subset.saveXdmfFrame(frameTime);
+  subset.closeXdmfFile();
+  subset.closeH5File();
+}
+
+
+// Registers field gid with target, for the data at ptr. Unbuffered
+// derived fields stay derived, so target evaluates them as it saves.
+//
+void H5pio::registerFieldLike(H5pio &target, const int gid, void *ptr)
+{
+  const bool isNodeCentered= dataIsNodeCentered[gid];
+
+  if (ptr == nullptr && dataDerived[gid] >= 0) {
+    const DerivedField &d= derivedFields[dataDerived[gid]];
+    target.registerDerived1DField(isNodeCentered,dataName[gid],d.inputs,d.kernel,d.param);
+  } else if (dataIsBoolean1D[gid]) {
+    target.registerBoolean1DField(isNodeCentered,dataName[gid],(bool*)ptr);
+  } else if (dataIsInteger1D[gid]) {
+    target.registerInteger1DField(isNodeCentered,dataName[gid],(int*)ptr);
+  } else if (dataIsFloat1D[gid]) {
+    target.registerFloat1DField(isNodeCentered,dataName[gid],(float*)ptr);
+  } else if (dataIsFloat3D[gid]) {
+    target.registerFloat3DField(isNodeCentered,dataName[gid],(XcFloat3*)ptr);
+  } else if (dataIsGeometry3D[gid]) {
+    target.registerGeometry3DField(isNodeCentered,dataName[gid],(XcFloat3*)ptr);
+  }
+}
+
+
+void H5pio::appendH5Block(const int type, const int nRows)
+{
+  if (!fileIsOpen || nRows <= 0) return;
+
+  char partType[16];
+  sprintf(partType,"PartType%d",type);
+
+  if (!H5Lexists(file_id,partType,H5P_DEFAULT)) {
+    H5Gclose(H5Gcreate(file_id,partType,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT));
+  }
+
+  const hsize_t row0= streamRows[type];
+
+  evaluateDerivedFields(type,dataPointer,nRows);
+  vector<float> scratch;
+
+  hid_t group_id= H5Gopen(file_id,partType,H5P_DEFAULT);
+  {
+    for (int gid=0; gid<dataName.size(); gid++) {
+      if (dataParticleType[gid] != type) continue;
+
+      void *data= dataPointer[gid];
+      if (data == nullptr) {
+        if (dataDerived[gid] < 0) continue;
+        scratch.resize(nRows);
+        evaluateDerived(gid,dataPointer,0,nRows,scratch.data());
+        data= scratch.data();
+      } // endif
+
+      const char *name= dataName[gid].c_str();
+      const hsize_t dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+      const hid_t memType= memTypeOf(gid);
+
+      hid_t dataset_id= (row0 == 0) ? createExtendibleDataset(group_id,memType,dof,name)
+                                    : H5Dopen(group_id,name,H5P_DEFAULT);
+      appendRows(dataset_id,memType,row0,nRows,dof,data);
+      H5Dclose(dataset_id);
+    } // endfor(gid)
+  }
+  H5Gclose(group_id);
+
+  streamRows[type] += nRows;
+}
+
+
+// Empty [0][dof] dataset of chunkRows-row chunks that grows by rows
+//
+hid_t H5pio::createExtendibleDataset(hid_t group_id, hid_t type, const hsize_t dof, XcCString name)
+{
+  hsize_t dims[2]= {0,dof};
+  hsize_t maxDims[2]= {H5S_UNLIMITED,dof};
+  hid_t dataspace_id= H5Screate_simple(2,dims,maxDims);
+  hid_t plist_id= H5Pcreate(H5P_DATASET_CREATE);
+  setCompression(plist_id,group_id,name,H5S_UNLIMITED,dof);
+  hid_t dataset_id= H5Dcreate(group_id,name,type,dataspace_id,H5P_DEFAULT,plist_id,H5P_DEFAULT);
+  H5Pclose(plist_id);
+  H5Sclose(dataspace_id);
+
+  return dataset_id;
+}
+
+
+void H5pio::appendRows(hid_t dataset_id, hid_t memType, const hsize_t row0, const hsize_t nRows,
+                       const hsize_t dof, const void* data)
+{
+  hsize_t dims[2]= {row0+nRows,dof};
+  H5Dset_extent(dataset_id,dims);
+
+  hsize_t offset[2]= {row0,0};
+  hsize_t count[2]= {nRows,dof};
+  hid_t filespace_id= H5Dget_space(dataset_id);
+  H5Sselect_hyperslab(filespace_id,H5S_SELECT_SET,offset,nullptr,count,nullptr);
+  hid_t memspace_id= H5Screate_simple(2,count,nullptr);
+  {
+    H5Dwrite(dataset_id,memType,memspace_id,filespace_id,H5P_DEFAULT,data);
+  }
+  H5Sclose(memspace_id);
+  H5Sclose(filespace_id);
+}
+
+
+// The totals become nParticles[], so that saveXdmfFrame() describes
+// the streamed datasets.
+//
+void H5pio::endH5Stream(const float time)
+{
+  if (!fileIsOpen) return;
+
+  for (int type=0; type<N_TYPES; type++) {
+    XcHandleError(streamRows[type]>0x7fffffff,XCUDA_ERROR,"H5pio::endH5Stream",
+      "More than 2^31-1 particles of one type");
+    nParticles[type]= int(streamRows[type]);
+  } // endfor(type)
+
+  frameTime= time;
+  writeH5Header();
+}
+
+
+// ***** subfiles and virtual frames *****
+//
+void H5pio::subfileName(const int frameID, const int writer, XcString fileName)
+{
+  snprintf(fileName,XCUDA_PATH_LENGTH,"%s_%04d_w%03d.hdf5",theBaseName,frameID,writer);
+}
+
+
+void H5pio::saveSubfile(const int frameID, const int writer, const float time)
+{
+  char fileName[XCUDA_PATH_LENGTH];
+  subfileName(frameID,writer,fileName);
+
+  std::lock_guard<std::mutex> lock(h5Mutex);
+  openH5File(fileName,true);
+  saveH5Frame(time);
+  closeH5File();
+}
+
+
+static herr_t listSubfileDataset(hid_t group_id, const char *name, const H5L_info_t *info, void *data)
+{
+  H5O_info_t oinfo;
+  H5Oget_info_by_name(group_id,name,&oinfo,H5P_DEFAULT);
+  if (oinfo.type == H5O_TYPE_DATASET) ((vector<string>*)data)->push_back(string(name));
+  return 0;
+}
+
+
+// Each dataset of the first subfile that has particles of a type is
+// mapped, piece by piece, from every subfile with particles of that
+// type. Datasets whose rows are not the particles (levels of detail)
+// are left out.
+//
+void H5pio::buildVirtualFrame(const int frameID, const int nWriters, const float time)
+{
+  XcHandleError(nWriters<1,XCUDA_ERROR,"H5pio::buildVirtualFrame","nWriters < 1");
+
+  char fileName[XCUDA_PATH_LENGTH];
+  frameFileName(frameID,fileName);
+
+  vector<string> pieceName(nWriters);
+  vector<int> pieceCount(size_t(nWriters)*N_TYPES);
+
+  pushXdmfState();
+  {
+    std::lock_guard<std::mutex> lock(h5Mutex);
+
+    // particle counts of the pieces
+    //
+    for (int w=0; w<nWriters; w++) {
+      char pieceFile[XCUDA_PATH_LENGTH];
+      subfileName(frameID,w,pieceFile);
+      pieceName[w]= string(basename(pieceFile));
+
+      hid_t fid= openProfiled(pieceFile,H5F_ACC_RDONLY,faplProfile);
+      XcHandleError(bool(fid<0),XCUDA_ERROR,"H5pio::buildVirtualFrame",
+        "Unable to open a subfile (check name and/or path)");
+      hid_t group_id= H5Gopen(fid,"Header",H5P_DEFAULT);
+      readAttribute(group_id,H5T_NATIVE_INT,"NumPart_ThisFile",&pieceCount[size_t(w)*N_TYPES]);
+      H5Gclose(group_id);
+      H5Fclose(fid);
+    } // endfor(w)
+
+    for (int type=0; type<N_TYPES; type++) {
+      long total= 0;
+      for (int w=0; w<nWriters; w++) total += pieceCount[size_t(w)*N_TYPES+type];
+      XcHandleError(total>0x7fffffff,XCUDA_ERROR,"H5pio::buildVirtualFrame",
+        "More than 2^31-1 particles of one type");
+      nParticles[type]= int(total);
+    } // endfor(type)
+
+    openH5File(fileName,true);
+    frameTime= time;
+    writeH5Header();
+
+    for (int type=0; type<N_TYPES; type++) {
+      const int np= nParticles[type];
+      if (np == 0) continue;
+
+      char partType[16];
+      sprintf(partType,"PartType%d",type);
+
+      int first= 0;
+      while (pieceCount[size_t(first)*N_TYPES+type] == 0) first++;
+
+      char firstFile[XCUDA_PATH_LENGTH];
+      subfileName(frameID,first,firstFile);
+      hid_t fid= openProfiled(firstFile,H5F_ACC_RDONLY,faplProfile);
+      hid_t source_id= H5Gopen(fid,partType,H5P_DEFAULT);
+
+      vector<string> names;
+      H5Literate(source_id,H5_INDEX_NAME,H5_ITER_INC,nullptr,listSubfileDataset,&names);
+
+      hid_t group_id= H5Gcreate(file_id,partType,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+      {
+        for (int k=0; k<names.size(); k++) {
+          hid_t dataset_id= H5Dopen(source_id,names[k].c_str(),H5P_DEFAULT);
+          hid_t type_id= H5Dget_type(dataset_id);
+          hsize_t dims[2]= {0,1};
+          hid_t dataspace_id= H5Dget_space(dataset_id);
+          const int rank= H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+          H5Sclose(dataspace_id);
+          H5Dclose(dataset_id);
+
+          if (rank == 2 && dims[0] == hsize_t(pieceCount[size_t(first)*N_TYPES+type])) {
+            char sourcePath[XCUDA_PATH_LENGTH];
+            snprintf(sourcePath,XCUDA_PATH_LENGTH,"/%s/%s",partType,names[k].c_str());
+
+            hsize_t vdims[2]= {hsize_t(np),dims[1]};
+            hid_t vspace_id= H5Screate_simple(2,vdims,nullptr);
+            hid_t plist_id= H5Pcreate(H5P_DATASET_CREATE);
+
+            hsize_t row0= 0;
+            for (int w=0; w<nWriters; w++) {
+              const hsize_t n= pieceCount[size_t(w)*N_TYPES+type];
+              if (n == 0) continue;
+
+              hsize_t offset[2]= {row0,0};
+              hsize_t count[2]= {n,dims[1]};
+              hid_t sspace_id= H5Screate_simple(2,count,nullptr);
+              H5Sselect_hyperslab(vspace_id,H5S_SELECT_SET,offset,nullptr,count,nullptr);
+              H5Pset_virtual(plist_id,vspace_id,pieceName[w].c_str(),sourcePath,sspace_id);
+              H5Sclose(sspace_id);
+              row0 += n;
+            } // endfor(w)
+
+            H5Sselect_all(vspace_id);
+            H5Dclose(H5Dcreate(group_id,names[k].c_str(),type_id,vspace_id,H5P_DEFAULT,plist_id,H5P_DEFAULT));
+            H5Pclose(plist_id);
+            H5Sclose(vspace_id);
+          } // endif
+
+          H5Tclose(type_id);
+        } // endfor(k)
+      }
+      H5Gclose(group_id);
+
+      H5Gclose(source_id);
+      H5Fclose(fid);
+    } // endfor(type)
+
+    openXdmfFile();
+    saveXdmfFrame(time);
+    closeXdmfFile();
+    closeH5File();
+  }
+  popXdmfState();
+}
+
+
+// The rows of each type are split into nWriters contiguous pieces,
+// each registered (without copying) with its own H5pio object.
+//
+void H5pio::saveFrameSubfiles(const float time, const int nWriters)
+{
+  XcHandleError(nWriters<1,XCUDA_ERROR,"H5pio::saveFrameSubfiles","nWriters < 1");
+  if (autotuneOnSave) autotuneFrame(false);
+
+  multiTemporalFrameID++;
+  frameCatalogIsValid= false;
+
+  for (int type=0; type<N_TYPES; type++) {
+    if (nParticles[type] > 0) evaluateDerivedFields(type);
+  } // endfor(type)
+
+  for (int w=0; w<nWriters; w++) {
+    H5pio piece;
+    piece.setIOProfile(ioProfile);
+    piece.chunkRows= chunkRows;
+    piece.tuning= tuning;
+    XCuda::stringCopy(piece.theBaseName,theBaseName,XCUDA_PATH_LENGTH);
+
+    for (int type=0; type<N_TYPES; type++) {
+      const long np= nParticles[type];
+      const int row0= int(np*w/nWriters);
+      const int n= int(np*(w+1)/nWriters) - row0;
+      if (n == 0) continue;
+
+      piece.registerParticles(n,type);
+      for (int gid=0; gid<dataName.size(); gid++) {
+        if (dataParticleType[gid] != type) continue;
+        if (dataPointer[gid] == nullptr && dataDerived[gid] < 0) continue;
+
+        char *ptr= (char*)dataPointer[gid];
+        registerFieldLike(piece,gid,(ptr != nullptr) ? ptr + size_t(row0)*getItemSize(gid) : nullptr);
+      } // endfor(gid)
+    } // endfor(type)
+
+    piece.saveSubfile(multiTemporalFrameID,w,time);
+  } // endfor(w)
+
+  buildVirtualFrame(multiTemporalFrameID,nWriters,time);
+
+  if (saveStatistics || !zoneMapNames.empty() || lodLevels > 0) {
+    char fileName[XCUDA_PATH_LENGTH];
+    frameFileName(multiTemporalFrameID,fileName);
+
+    pushXdmfState();
+    {
+      std::lock_guard<std::mutex> lock(h5Mutex);
+      writeFrameSummaries(fileName);
+      saveLevelsXdmf(fileName,time);
+    }
+    popXdmfState();
+  } // endif
+
+  xdmfFrameID= 0;
+  saveXdmfFrame(time);
+}
+
+
+// Statistics, zone maps and levels of detail of the whole arrays,
+// added to an existing frame (the caller holds h5Mutex)
+//
+void H5pio::writeFrameSummaries(XcCString fileName)
+{
+  openH5File(fileName,false);
+  lodCount.assign(size_t(lodLevels+1)*N_TYPES,0);
+
+  for (int type=0; type<N_TYPES; type++) {
+    const int np= nParticles[type];
+    if (np == 0) continue;
+
+    char partType[16];
+    sprintf(partType,"PartType%d",type);
+    hid_t group_id= H5Gopen(file_id,partType,H5P_DEFAULT);
+    {
+      for (int gid=0; gid<dataName.size(); gid++) {
+        if (dataParticleType[gid] != type || dataPointer[gid] == nullptr) continue;
+
+        if (isZoneMapField(gid)) writeZoneMap(type,gid,np);
+        if (saveStatistics) writeStatistics(type,gid,np,group_id);
+      } // endfor(gid)
+
+      if (lodLevels > 0) writeLevelsOfDetail(type,np,group_id);
+    }
+    H5Gclose(group_id);
+  } // endfor(type)
+
+  closeH5File();
+}
+
+
+// ***** SWMR live files *****
+//
+// SWMR forbids creating objects once writing has started, so the
+// writer creates every dataset of every registered field up front.
+//
+void H5pio::openLiveFile(XcCString fileName_in, const bool createFile)
+{
+  closeLiveFile();
+
+  char fileName[XCUDA_PATH_LENGTH];
+  XCuda::stringCopy(fileName,fileName_in,XCUDA_PATH_LENGTH);
+  addSuffix(fileName,".hdf5");
+
+  std::lock_guard<std::mutex> lock(h5Mutex);
+
+  hid_t fapl_id= H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_libver_bounds(fapl_id,H5F_LIBVER_LATEST,H5F_LIBVER_LATEST);
+  if (createFile) {
+    liveFile_id= H5Fcreate(fileName,H5F_ACC_TRUNC,H5P_DEFAULT,fapl_id);
+  } else {
+    liveFile_id= H5Fopen(fileName,H5F_ACC_RDONLY|H5F_ACC_SWMR_READ,fapl_id);
+  }
+  H5Pclose(fapl_id);
+
+  XcHandleError(bool(liveFile_id<0),XCUDA_ERROR,"H5pio::openLiveFile",
+    "Unable to create or open an HDF5 file (check name and/or path)");
+
+  liveDataset.assign(dataName.size(),-1);
+  for (int i=0; i<N_TYPES; i++) liveRows[i]= 0;
+  liveFrames= 0;
+  liveIsWriter= createFile;
+
+  if (createFile) {
+    hid_t group_id= H5Gcreate(liveFile_id,"Frames",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    liveTime_id= createExtendibleDataset(group_id,H5T_NATIVE_FLOAT,1,"Time");
+    liveRows_id= createExtendibleDataset(group_id,H5T_NATIVE_LLONG,N_TYPES,"Rows");
+    H5Gclose(group_id);
+
+    for (int type=0; type<N_TYPES; type++) {
+      char partType[16];
+      sprintf(partType,"PartType%d",type);
+
+      hid_t group_id= -1;
+      for (int gid=0; gid<dataName.size(); gid++) {
+        if (dataParticleType[gid] != type) continue;
+        if (group_id < 0) group_id= H5Gcreate(liveFile_id,partType,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+
+        const hsize_t dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+        liveDataset[gid]= createExtendibleDataset(group_id,memTypeOf(gid),dof,dataName[gid].c_str());
+      } // endfor(gid)
+      if (group_id >= 0) H5Gclose(group_id);
+    } // endfor(type)
+
+    H5Fstart_swmr_write(liveFile_id);
+  } else {
+    liveTime_id= H5Dopen(liveFile_id,"Frames/Time",H5P_DEFAULT);
+    liveRows_id= H5Dopen(liveFile_id,"Frames/Rows",H5P_DEFAULT);
+    XcHandleError(bool(liveTime_id<0||liveRows_id<0),XCUDA_ERROR,"H5pio::openLiveFile",
+      "Not a live file");
+
+    for (int gid=0; gid<dataName.size(); gid++) {
+      if (dataPointer[gid] == nullptr || dataDerived[gid] >= 0) continue;
+
+      char path[XCUDA_PATH_LENGTH];
+      snprintf(path,XCUDA_PATH_LENGTH,"PartType%d/%s",dataParticleType[gid],dataName[gid].c_str());
+      liveDataset[gid]= H5Dopen(liveFile_id,path,H5P_DEFAULT);
+      XcHandleError(bool(liveDataset[gid]<0),XCUDA_ERROR,"H5pio::openLiveFile",
+        "Field not found in the live file");
+    } // endfor(gid)
+  }
+
+  liveIsOpen= true;
+}
+
+
+void H5pio::closeLiveFile(void)
+{
+  if (!liveIsOpen) return;
+
+  std::lock_guard<std::mutex> lock(h5Mutex);
+
+  for (int gid=0; gid<liveDataset.size(); gid++) {
+    if (liveDataset[gid] >= 0) H5Dclose(liveDataset[gid]);
+  } // endfor(gid)
+  vector<hid_t>().swap(liveDataset);
+
+  H5Dclose(liveTime_id);
+  H5Dclose(liveRows_id);
+  H5Fclose(liveFile_id);
+  liveIsOpen= false;
+}
+
+
+// The rows are flushed before the index entry that makes them part
+// of a frame, so a reader that sees the entry can read the rows.
+//
+void H5pio::appendLiveFrame(const float time)
+{
+  XcHandleError(!liveIsOpen||!liveIsWriter,XCUDA_ERROR,"H5pio::appendLiveFrame",
+    "No live file is open for writing");
+
+  for (int type=0; type<N_TYPES; type++) {
+    if (nParticles[type] > 0) evaluateDerivedFields(type,dataPointer,nParticles[type]);
+  } // endfor(type)
+
+  std::lock_guard<std::mutex> lock(h5Mutex);
+
+  vector<float> scratch;
+
+  for (int gid=0; gid<dataName.size(); gid++) {
+    const int type= dataParticleType[gid];
+    const int np= nParticles[type];
+    if (np == 0) continue;
+
+    const void *data= dataPointer[gid];
+    if (data == nullptr) {
+      if (dataDerived[gid] < 0) continue;
+      scratch.resize(np);
+      evaluateDerived(gid,dataPointer,0,np,scratch.data());
+      data= scratch.data();
+    } // endif
+
+    const hsize_t dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+    appendRows(liveDataset[gid],memTypeOf(gid),liveRows[type],np,dof,data);
+    H5Dflush(liveDataset[gid]);
+  } // endfor(gid)
+
+  long long rows[N_TYPES];
+  for (int type=0; type<N_TYPES; type++) {
+    liveRows[type] += nParticles[type];
+    rows[type]= liveRows[type];
+  } // endfor(type)
+
+  appendRows(liveTime_id,H5T_NATIVE_FLOAT,liveFrames,1,1,&time);
+  appendRows(liveRows_id,H5T_NATIVE_LLONG,liveFrames,1,N_TYPES,rows);
+  H5Dflush(liveTime_id);
+  H5Dflush(liveRows_id);
+
+  liveFrames++;
+  frameTime= time;
+}
+
+
+int H5pio::loadLatestFrame(void)
+{
+  XcHandleError(!liveIsOpen||liveIsWriter,XCUDA_ERROR,"H5pio::loadLatestFrame",
+    "No live file is open for reading");
+
+  std::unique_lock<std::mutex> lock(h5Mutex);
+
+  // Rows is written last, so its extent is the number of whole frames
+  //
+  H5Drefresh(liveRows_id);
+  hsize_t dims[2]= {0,N_TYPES};
+  hid_t dataspace_id= H5Dget_space(liveRows_id);
+  H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+  H5Sclose(dataspace_id);
+
+  const int nFrames= int(dims[0]);
+  if (nFrames <= liveFrames) return 0;
+
+  const int frame= nFrames-1;
+  long long rows[2][N_TYPES];
+  for (int type=0; type<N_TYPES; type++) rows[0][type]= 0;
+
+  H5Drefresh(liveTime_id);
+  readRows(liveTime_id,H5T_NATIVE_FLOAT,frame,1,&frameTime);
+  if (frame > 0) {
+    readRows(liveRows_id,H5T_NATIVE_LLONG,frame-1,2,rows);
+  } else {
+    readRows(liveRows_id,H5T_NATIVE_LLONG,0,1,rows[1]);
+  }
+
+  for (int gid=0; gid<dataName.size(); gid++) {
+    const int type= dataParticleType[gid];
+    XcHandleError(liveDataset[gid]>=0&&rows[1][type]-rows[0][type]>registeredParticles[type],XCUDA_ERROR,
+      "H5pio::loadLatestFrame","Registered arrays are too small for the frame");
+  } // endfor(gid)
+
+  for (int gid=0; gid<dataName.size(); gid++) {
+    if (liveDataset[gid] < 0) continue;
+
+    const int type= dataParticleType[gid];
+    const hsize_t np= rows[1][type]-rows[0][type];
+    if (np == 0) continue;
+
+    H5Drefresh(liveDataset[gid]);
+    readRows(liveDataset[gid],memTypeOf(gid),rows[0][type],np,dataPointer[gid]);
+  } // endfor(gid)
+  lock.unlock();
+
+  for (int type=0; type<N_TYPES; type++) nParticles[type]= int(rows[1][type]-rows[0][type]);
+
+  if (sortByID) sortFieldsByID(dataPointer);
+  for (int type=0; type<N_TYPES; type++) {
+    if (nParticles[type] > 0) evaluateDerivedFields(type,dataPointer,nParticles[type]);
+  } // endfor(type)
+
+  liveFrames= nFrames;
+  endOfFile= false;
+  return nFrames;
+}
+
+
+// ***** in-memory file images *****
+//
+static const size_t IMAGE_INCREMENT= size_t(16) << 20; // core driver growth, bytes
+
+void H5pio::saveFrameImage(const float time, vector<char> &image)
+{
+  // the name only identifies the open image; nothing is written to disk
+  //
+  char imageName[XCUDA_PATH_LENGTH];
+  snprintf(imageName,XCUDA_PATH_LENGTH,"H5pio_image_%p.hdf5",(void*)this);
+
+  std::lock_guard<std::mutex> lock(h5Mutex);
+
+  hid_t fapl_id= H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_core(fapl_id,IMAGE_INCREMENT,false);
+  openH5File(imageName,true,H5P_DEFAULT,fapl_id);
+  H5Pclose(fapl_id);
+
+  saveH5Frame(time);
+  H5Fflush(file_id,H5F_SCOPE_LOCAL);
+
+  const ssize_t size= H5Fget_file_image(file_id,nullptr,0);
+  XcHandleError(size<0,XCUDA_ERROR,"H5pio::saveFrameImage","Unable to get the file image");
+  image.resize(size);
+  H5Fget_file_image(file_id,image.data(),size);
+
+  closeH5File();
+}
+
+
+void H5pio::loadFrameImage(const void *image, const size_t size)
+{
+  std::lock_guard<std::mutex> lock(h5Mutex);
+
+  hid_t fid= H5LTopen_file_image((void*)image,size,H5LT_FILE_IMAGE_DONT_COPY|H5LT_FILE_IMAGE_DONT_RELEASE);
+  XcHandleError(bool(fid<0),XCUDA_ERROR,"H5pio::loadFrameImage","Not an HDF5 file image");
+
+  readH5Frame(fid,dataPointer,&frameTime);
+  H5Fclose(fid);
+
+  endOfFile= false;
+}
+
+
+void H5pio::writeFrameImage(XcCString fileName_in, const vector<char> &image)
+{
+  char fileName[XCUDA_PATH_LENGTH];
+  XCuda::stringCopy(fileName,fileName_in,XCUDA_PATH_LENGTH);
+  addSuffix(fileName,".hdf5");
+
+  FILE *fp= fopen(fileName,"wb");
+  XcHandleError(fp==nullptr,XCUDA_ERROR,"H5pio::writeFrameImage",
+    "Unable to create a file (check name and/or path)");
+
+  const size_t nWritten= fwrite(image.data(),1,image.size(),fp);
+  fclose(fp);
+
+  XcHandleError(nWritten!=image.size(),XCUDA_ERROR,"H5pio::writeFrameImage","Short write");
+}
+
+
+// ***** raw data path *****
+//
+static const size_t RAW_ALIGN= 4096;            // O_DIRECT offsets, lengths and addresses
+static const size_t RAW_BLOCK= size_t(1) << 20; // bytes per request
+static const int    RAW_DEPTH= 8;               // requests in flight
+
+// Requests of up to RAW_BLOCK bytes at aligned offsets, RAW_DEPTH in
+// flight through io_uring, or issued in runs of consecutive blocks
+// with pwritev()/preadv() where io_uring cannot be set up. Data at
+// an aligned address is transferred in place; the rest goes through
+// a staging block.
+//
+class RawQueue {
+public:
+  RawQueue(const int fd, const bool isWrite);
+ ~RawQueue(void);
+
+  void transfer(char *data, const size_t bytes, const off_t offset);
+  bool finish(void); // waits for every request; false if one failed
+
+private:
+  int fd;
+  bool isWrite;
+  bool ok;
+  char *staging;                // RAW_DEPTH blocks
+
+  struct iovec iov[RAW_DEPTH];  // by slot
+  char *data[RAW_DEPTH];        // where each slot's bytes come from or go
+  off_t offset[RAW_DEPTH];
+
+  int freeSlot[RAW_DEPTH];
+  int nFree;
+  int nQueued;                  // pwritev(): slots of the pending run, in order
+
+  void complete(const int s, const long result);
+  void flushRun(void);
+
+  int ringFd;                   // -1: no io_uring
+#ifdef H5PIO_IO_URING
+  unsigned nToSubmit;
+  int nInFlight;
+  void *sqMap, *cqMap;
+  size_t sqBytes, cqBytes, sqeBytes;
+  unsigned *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+#endif
+
+  bool openRing(void);
+  void closeRing(void);
+  void submit(const int s);
+  void enterRing(const unsigned minComplete);
+};
+
+RawQueue::RawQueue(const int theFd, const bool theIsWrite)
+{
+  fd= theFd;
+  isWrite= theIsWrite;
+  ok= true;
+
+  void *p= nullptr;
+  staging= (posix_memalign(&p,RAW_ALIGN,RAW_DEPTH*RAW_BLOCK) == 0) ? (char*)p : nullptr;
+  XcHandleError(staging==nullptr,XCUDA_ERROR,"H5pio::transferRaw","Unable to allocate the staging buffers");
+
+  for (int s=0; s<RAW_DEPTH; s++) freeSlot[s]= RAW_DEPTH-1-s;
+  nFree= RAW_DEPTH;
+  nQueued= 0;
+
+  ringFd= -1;
+  openRing();
+}
+
+RawQueue::~RawQueue(void)
+{
+  closeRing();
+  free(staging);
+}
+
+
+void RawQueue::transfer(char *src, const size_t bytes, const off_t offset0)
+{
+  for (size_t done=0; done<bytes; done+=RAW_BLOCK) {
+    const size_t n= std::min(RAW_BLOCK,bytes-done);
+
+    int s;
+    if (ringFd >= 0) {
+      while (nFree == 0) enterRing(1);
+      s= freeSlot[--nFree];
+    } else {
+      if (nQueued > 0 && (nQueued == RAW_DEPTH ||
+                          offset[nQueued-1] + off_t(iov[nQueued-1].iov_len) != offset0 + off_t(done))) flushRun();
+      s= nQueued++;
+    } // endif
+
+    data[s]= src + done;
+    offset[s]= offset0 + off_t(done);
+
+    const bool inPlace= (uintptr_t(data[s]) % RAW_ALIGN == 0);
+    iov[s].iov_base= inPlace ? data[s] : staging + size_t(s)*RAW_BLOCK;
+    iov[s].iov_len= n;
+    if (isWrite && !inPlace) memcpy(iov[s].iov_base,data[s],n);
+
+    if (ringFd >= 0) submit(s);
+  } // endfor(done)
+}
+
+
+bool RawQueue::finish(void)
+{
+  if (ringFd >= 0) {
+#ifdef H5PIO_IO_URING
+    while (nInFlight > 0) enterRing(1);
+#endif
+  } else {
+    flushRun();
+  } // endif
+
+  return ok;
+}
+
+
+void RawQueue::complete(const int s, const long result)
+{
+  if (result != long(iov[s].iov_len)) {
+    ok= false;
+  } else if (!isWrite && iov[s].iov_base != data[s]) {
+    memcpy(data[s],iov[s].iov_base,iov[s].iov_len);
+  } // endif
+
+  if (ringFd >= 0) freeSlot[nFree++]= s;
+}
+
+
+void RawQueue::flushRun(void)
+{
+  if (nQueued == 0) return;
+
+  long bytes= 0;
+  for (int s=0; s<nQueued; s++) bytes += long(iov[s].iov_len);
+
+  const long n= isWrite ? long(pwritev(fd,iov,nQueued,offset[0])) : long(preadv(fd,iov,nQueued,offset[0]));
+  for (int s=0; s<nQueued; s++) complete(s,(n == bytes) ? long(iov[s].iov_len) : -1);
+
+  nQueued= 0;
+}
+
+
+// io_uring through the system calls (no liburing): the submission
+// and completion rings and the submission entries are mapped from
+// the ring's file descriptor
+//
+bool RawQueue::openRing(void)
+{
+#ifdef H5PIO_IO_URING
+  struct io_uring_params params;
+  memset(&params,0,sizeof(params));
+
+  ringFd= int(syscall(__NR_io_uring_setup,RAW_DEPTH,&params));
+  if (ringFd < 0) return false;
+
+  sqBytes= params.sq_off.array + params.sq_entries*sizeof(unsigned);
+  cqBytes= params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+  sqeBytes= params.sq_entries*sizeof(struct io_uring_sqe);
+
+  sqMap= mmap(nullptr,sqBytes,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,ringFd,IORING_OFF_SQ_RING);
+  cqMap= mmap(nullptr,cqBytes,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,ringFd,IORING_OFF_CQ_RING);
+  void *sqeMap= mmap(nullptr,sqeBytes,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,ringFd,IORING_OFF_SQES);
+  sqes= (sqeMap == MAP_FAILED) ? nullptr : (struct io_uring_sqe*)sqeMap;
+
+  if (sqMap == MAP_FAILED || cqMap == MAP_FAILED || sqes == nullptr) {
+    closeRing();
+    return false;
+  } // endif
+
+  char *sq= (char*)sqMap;
+  sqTail=  (unsigned*)(sq + params.sq_off.tail);
+  sqMask=  (unsigned*)(sq + params.sq_off.ring_mask);
+  sqArray= (unsigned*)(sq + params.sq_off.array);
+
+  char *cq= (char*)cqMap;
+  cqHead= (unsigned*)(cq + params.cq_off.head);
+  cqTail= (unsigned*)(cq + params.cq_off.tail);
+  cqMask= (unsigned*)(cq + params.cq_off.ring_mask);
+  cqes=   (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+  nToSubmit= 0;
+  nInFlight= 0;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void RawQueue::closeRing(void)
+{
+#ifdef H5PIO_IO_URING
+  if (ringFd < 0) return;
+
+  if (sqMap != MAP_FAILED) munmap(sqMap,sqBytes);
+  if (cqMap != MAP_FAILED) munmap(cqMap,cqBytes);
+  if (sqes != nullptr) munmap(sqes,sqeBytes);
+  close(ringFd);
+  ringFd= -1;
+#endif
+}
+
+
+void RawQueue::submit(const int s)
+{
+#ifdef H5PIO_IO_URING
+  const unsigned tail= *sqTail; // only this thread moves it
+  const unsigned index= tail & *sqMask;
+
+  struct io_uring_sqe *sqe= &sqes[index];
+  memset(sqe,0,sizeof(*sqe));
+  sqe->opcode= isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+  sqe->fd= fd;
+  sqe->addr= (unsigned long long)(uintptr_t)&iov[s];
+  sqe->len= 1;
+  sqe->off= (unsigned long long)offset[s];
+  sqe->user_data= (unsigned long long)s;
+
+  sqArray[index]= index;
+  __atomic_store_n(sqTail,tail+1,__ATOMIC_RELEASE);
+
+  nToSubmit++;
+  nInFlight++;
+
+  // the slots are all taken: submit the batch
+  //
+  if (nFree == 0) enterRing(0);
+#endif
+}
+
+
+// Submits the queued requests, waits for minComplete completions and
+// reaps every completion that has arrived.
+//
+void RawQueue::enterRing(const unsigned minComplete)
+{
+#ifdef H5PIO_IO_URING
+  const unsigned flags= (minComplete > 0) ? IORING_ENTER_GETEVENTS : 0;
+  const long nSubmitted= syscall(__NR_io_uring_enter,ringFd,nToSubmit,minComplete,flags,nullptr,0);
+
+  if (nSubmitted < 0) {
+    if (errno == EINTR) return;
+    ok= false;
+    nInFlight= 0; // the ring is unusable; finish() returns false
+    return;
+  } // endif
+  nToSubmit -= unsigned(nSubmitted);
+
+  unsigned head= *cqHead;
+  const unsigned tail= __atomic_load_n(cqTail,__ATOMIC_ACQUIRE);
+  for (; head!=tail; head++) {
+    const struct io_uring_cqe *cqe= &cqes[head & *cqMask];
+    complete(int(cqe->user_data),long(cqe->res));
+    nInFlight--;
+  } // endfor(head)
+  __atomic_store_n(cqHead,head,__ATOMIC_RELEASE);
+#endif
+}
+
+
+static bool transferBuffered(const int fd, char *data, const size_t bytes, const off_t offset, const bool isWrite)
+{
+  size_t done= 0;
+  while (done < bytes) {
+    const ssize_t n= isWrite ? pwrite(fd,data+done,bytes-done,offset+off_t(done))
+                             : pread(fd,data+done,bytes-done,offset+off_t(done));
+    if (n <= 0) return false;
+    done += size_t(n);
+  } // endwhile
+
+  return true;
+}
+
+
+void H5pio::saveRawFrame(XcCString fileName, const float time)
+{
+  vector<RawExtent> extents;
+  vector< vector<float> > derived;
+  char rawName[XCUDA_PATH_LENGTH];
+
+  {
+    std::lock_guard<std::mutex> lock(h5Mutex);
+    layoutRawFrame(fileName,time,extents,derived);
+    XCuda::stringCopy(rawName,hdf5Name,XCUDA_PATH_LENGTH);
+  }
+
+  transferRaw(rawName,extents,true);
+}
+
+
+void H5pio::loadRawFrame(XcCString fileName_in)
+{
+  char fileName[XCUDA_PATH_LENGTH];
+  XCuda::stringCopy(fileName,fileName_in,XCUDA_PATH_LENGTH);
+  addSuffix(fileName,".hdf5");
+
+  vector<RawExtent> extents;
+  {
+    std::lock_guard<std::mutex> lock(h5Mutex);
+
+    hid_t fid= openProfiled(fileName,H5F_ACC_RDONLY,faplProfile);
+    XcHandleError(bool(fid<0),XCUDA_ERROR,"H5pio::loadRawFrame",
+      "Unable to open an HDF5 file (check name and/or path)");
+
+    hid_t group_id= H5Gopen(fid,"Header",H5P_DEFAULT);
+    {
+      int np[N_TYPES];
+      frameTime= 0.0f;
+
+      readAttribute(group_id,H5T_NATIVE_INT,"NumPart_ThisFile",np);
+      readAttribute(group_id,H5T_NATIVE_FLOAT,"Time",&frameTime);
+
+      for (int i=0; i<N_TYPES; i++) {
+        XcHandleError(bool(np[i] != nParticles[i]),XCUDA_ERROR,"H5pio::loadRawFrame",
+          "Inconsistent number of particles; bad checkpoint file?");
+      } // endfor
+    }
+    H5Gclose(group_id);
+
+    // contiguous datasets of the memory type are read raw, the
+    // others (chunked, compressed, converted) through HDF5
+    //
+    for (int type=0; type<N_TYPES; type++) {
+      const int np= nParticles[type];
+      if (np == 0) continue;
+
+      char partType[16];
+      sprintf(partType,"PartType%d",type);
+
+      hid_t group_id= H5Gopen(fid,partType,H5P_DEFAULT);
+      {
+        for (int gid=0; gid<dataName.size(); gid++) {
+          if (dataParticleType[gid] != type || dataDerived[gid] >= 0 || dataPointer[gid] == nullptr) continue;
+
+          const hid_t memType= memTypeOf(gid);
+          const size_t bytes= size_t(np)*getItemSize(gid);
+
+          hid_t dataset_id= H5Dopen(group_id,dataName[gid].c_str(),H5P_DEFAULT);
+          hid_t type_id= H5Dget_type(dataset_id);
+          {
+            const haddr_t offset= H5Dget_offset(dataset_id); // undefined unless contiguous and allocated
+
+            if (offset != HADDR_UNDEF && H5Tequal(type_id,memType) > 0 &&
+                H5Dget_storage_size(dataset_id) == hsize_t(bytes)) {
+              extents.push_back({(char*)dataPointer[gid],bytes,off_t(offset)});
+            } else {
+              H5Dread(dataset_id,memType,H5S_ALL,H5S_ALL,H5P_DEFAULT,dataPointer[gid]);
+            } // endif
+          }
+          H5Tclose(type_id);
+          H5Dclose(dataset_id);
+        } // endfor(gid)
+      }
+      H5Gclose(group_id);
+    } // endfor(type)
+
+    H5Fclose(fid);
+  }
+
+  transferRaw(fileName,extents,false);
+
+  if (sortByID) sortFieldsByID(dataPointer);
+
+  for (int type=0; type<N_TYPES; type++) evaluateDerivedFields(type,dataPointer,nParticles[type]);
+
+  endOfFile= false;
+}
+
+
+// Creates the frame file with each field as a contiguous dataset,
+// allocated but neither filled nor written, and lists where each
+// field's bytes go. The caller holds h5Mutex; the file is closed on
+// return.
+//
+void H5pio::layoutRawFrame(XcCString fileName, const float time, vector<RawExtent> &extents,
+                           vector< vector<float> > &derived)
+{
+  hid_t fapl_id= (faplProfile == H5P_DEFAULT) ? H5Pcreate(H5P_FILE_ACCESS) : H5Pcopy(faplProfile);
+  H5Pset_alignment(fapl_id,RAW_ALIGN,std::max(hsize_t(RAW_ALIGN),ioProfile.alignment));
+  openH5File(fileName,true,fcplProfile,fapl_id);
+  H5Pclose(fapl_id);
+
+  frameTime= time;
+  writeH5Header();
+
+  lodCount.assign(size_t(lodLevels+1)*N_TYPES,0);
+  extents.clear();
+  derived.clear();
+
+  hid_t plist_id= H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_layout(plist_id,H5D_CONTIGUOUS);
+  H5Pset_alloc_time(plist_id,H5D_ALLOC_TIME_EARLY);
+  H5Pset_fill_time(plist_id,H5D_FILL_TIME_NEVER);
+
+  for (int type=0; type<N_TYPES; type++) {
+    const int np= nParticles[type];
+    if (np == 0) continue;
+
+    char partType[16];
+    sprintf(partType,"PartType%d",type);
+
+    evaluateDerivedFields(type,dataPointer,np);
+
+    hid_t group_id= H5Gcreate(file_id,partType,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    {
+      for (int gid=0; gid<dataName.size(); gid++) {
+        if (dataParticleType[gid] != type) continue;
+
+        // unbuffered derived fields are evaluated in full here
+        //
+        char *ptr= (char*)dataPointer[gid];
+        if (dataDerived[gid] >= 0 && ptr == nullptr) {
+          derived.emplace_back(np);
+          evaluateDerived(gid,dataPointer,0,np,derived.back().data());
+          ptr= (char*)derived.back().data();
+        } // endif
+        if (ptr == nullptr) continue;
+
+        const hsize_t dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+        hsize_t dims[2]= {hsize_t(np),dof};
+
+        hid_t dataspace_id= H5Screate_simple(2,dims,nullptr);
+        hid_t dataset_id= H5Dcreate(group_id,dataName[gid].c_str(),memTypeOf(gid),dataspace_id,
+                                    H5P_DEFAULT,plist_id,H5P_DEFAULT);
+        const haddr_t offset= H5Dget_offset(dataset_id);
+        H5Dclose(dataset_id);
+        H5Sclose(dataspace_id);
+
+        XcHandleError(offset==HADDR_UNDEF,XCUDA_ERROR,"H5pio::layoutRawFrame","Dataset was not allocated");
+        extents.push_back({ptr,size_t(np)*getItemSize(gid),off_t(offset)});
+
+        if (isZoneMapField(gid)) writeZoneMap(type,gid,np);
+        if (saveStatistics) writeStatistics(type,gid,np,group_id);
+      } // endfor(gid)
+
+      if (lodLevels > 0) writeLevelsOfDetail(type,np,group_id);
+    }
+    H5Gclose(group_id);
+  } // endfor(type)
+
+  H5Pclose(plist_id);
+  closeH5File();
+}
+
+
+// Moves each extent between memory and the file: its whole 4 KiB
+// blocks with O_DIRECT requests, the partial blocks at its ends
+// through the page cache. No HDF5 calls, so h5Mutex is not held.
+//
+void H5pio::transferRaw(XcCString fileName, const vector<RawExtent> &extents, const bool isWrite)
+{
+  if (extents.empty()) return;
+
+  const int flags= isWrite ? O_WRONLY : O_RDONLY;
+  int fd= open(fileName,flags|O_DIRECT);
+  if (fd < 0) fd= open(fileName,flags); // file systems without O_DIRECT (tmpfs)
+  const int bufferedFd= open(fileName,flags);
+
+  if (fd < 0 || bufferedFd < 0) {
+    if (fd >= 0) close(fd);
+    if (bufferedFd >= 0) close(bufferedFd);
+    XcHandleError(true,XCUDA_ERROR,"H5pio::transferRaw","Unable to open an HDF5 file (check name and/or path)");
+    return;
+  } // endif
+
+  bool ok= true;
+  {
+    RawQueue queue(fd,isWrite);
+
+    for (const RawExtent &e : extents) {
+      const off_t begin= e.offset;
+      const off_t end= e.offset + off_t(e.bytes);
+      const off_t a0= (begin + off_t(RAW_ALIGN)-1)/off_t(RAW_ALIGN)*off_t(RAW_ALIGN);
+      const off_t a1= end/off_t(RAW_ALIGN)*off_t(RAW_ALIGN);
+
+      if (a0 >= a1) {
+        ok= transferBuffered(bufferedFd,e.data,e.bytes,begin,isWrite) && ok;
+        continue;
+      } // endif
+
+      ok= transferBuffered(bufferedFd,e.data,size_t(a0-begin),begin,isWrite) && ok;
+      ok= transferBuffered(bufferedFd,e.data+(a1-begin),size_t(end-a1),a1,isWrite) && ok;
+      queue.transfer(e.data+(a0-begin),size_t(a1-a0),a0);
+    } // endfor(e)
+
+    ok= queue.finish() && ok;
+  }
+
+  close(fd);
+  close(bufferedFd);
+
+  XcHandleError(!ok,XCUDA_ERROR,"H5pio::transferRaw","Short or failed raw transfer");
+}
+
+
+// ***** levels of detail *****
+//
+void H5pio::setLevelsOfDetail(const int nLevels, const int factor)
+{
+  XcHandleError(nLevels<0,XCUDA_ERROR,"H5pio::setLevelsOfDetail","nLevels < 0");
+  XcHandleError(factor<2,XCUDA_ERROR,"H5pio::setLevelsOfDetail","factor < 2");
+
+  lodLevels= nLevels;
+  lodFactor= factor;
+}
+
+
+// 10 bits per axis, interleaved
+//
+static inline unsigned mortonKey(unsigned x, unsigned y, unsigned z)
+{
+  unsigned v[3]= {x,y,z};
+  for (int d=0; d<3; d++) {
+    v[d]= (v[d] | (v[d] << 16)) & 0x030000FF;
+    v[d]= (v[d] | (v[d] <<  8)) & 0x0300F00F;
+    v[d]= (v[d] | (v[d] <<  4)) & 0x030C30C3;
+    v[d]= (v[d] | (v[d] <<  2)) & 0x09249249;
+  } // endfor(d)
+  return v[0] | (v[1] << 1) | (v[2] << 2);
+}
+
+
+static inline unsigned long long mixBits(unsigned long long z)
+{
+  z= (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+  z= (z ^ (z >> 27))*0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+
+// Each level keeps one particle, chosen by a hash of (level,run),
+// from every run of factor^level particles in Morton order. The
+// selected rows of all fields are gathered and written with
+// writeDataset(); unbuffered derived fields are evaluated from the
+// gathered inputs.
+//
+void H5pio::writeLevelsOfDetail(const int type, const int np, hid_t group_id)
+{
+  vector<int> perm(np);
+
+  const int gx= findField(type,"Coordinates");
+  if (gx >= 0 && dataPointer[gx] != nullptr) {
+    const XcFloat3 *x= (const XcFloat3*)dataPointer[gx];
+
+    float x0= x[0].x, x1= x[0].x;
+    float y0= x[0].y, y1= x[0].y;
+    float z0= x[0].z, z1= x[0].z;
+    #pragma omp parallel for reduction(min:x0,y0,z0) reduction(max:x1,y1,z1)
+    for (int i=0; i<np; i++) {
+      x0= std::min(x0,x[i].x); x1= std::max(x1,x[i].x);
+      y0= std::min(y0,x[i].y); y1= std::max(y1,x[i].y);
+      z0= std::min(z0,x[i].z); z1= std::max(z1,x[i].z);
+    } // endfor(i)
+
+    const float sx= (x1 > x0) ? 1023.0f/(x1-x0) : 0.0f;
+    const float sy= (y1 > y0) ? 1023.0f/(y1-y0) : 0.0f;
+    const float sz= (z1 > z0) ? 1023.0f/(z1-z0) : 0.0f;
+
+    vector<unsigned> keys(np);
+    #pragma omp parallel for
+    for (int i=0; i<np; i++) {
+      keys[i]= mortonKey(unsigned((x[i].x-x0)*sx),unsigned((x[i].y-y0)*sy),unsigned((x[i].z-z0)*sz));
+    } // endfor(i)
+
+    sortPermutation(keys.data(),np,perm.data());
+  } else {
+    #pragma omp parallel for
+    for (int i=0; i<np; i++) perm[i]= i;
+  } // endif
+
+  const int gm= findField(type,"Masses");
+  const bool hasMasses= (gm >= 0 && dataPointer[gm] != nullptr && dataIsFloat1D[gm]);
+  double totalMass= 0.0;
+  if (hasMasses) {
+    const float *m= (const float*)dataPointer[gm];
+    #pragma omp parallel for reduction(+:totalMass)
+    for (int i=0; i<np; i++) totalMass += m[i];
+  } // endif
+
+  vector<int> index;
+  vector< vector<char> > buffers(dataName.size());
+  vector<void*> ptrs(dataName.size(),nullptr);
+
+  long stride= 1;
+  for (int level=1; level<=lodLevels; level++) {
+    stride *= lodFactor;
+    if (stride > np) break;
+
+    const int nSel= int((np + stride - 1)/stride);
+    index.resize(nSel);
+
+    #pragma omp parallel for
+    for (int k=0; k<nSel; k++) {
+      const long b0= long(k)*stride;
+      const long length= std::min(stride,long(np)-b0);
+      const unsigned long long h= mixBits((unsigned long long)(level) << 40 | (unsigned long long)(k));
+      index[k]= perm[b0 + long(h % (unsigned long long)(length))];
+    } // endfor(k)
+
+    for (int gid=0; gid<dataName.size(); gid++) {
+      if (dataParticleType[gid] != type || dataPointer[gid] == nullptr) continue;
+
+      const int itemSize= getItemSize(gid);
+      buffers[gid].resize(size_t(nSel)*itemSize);
+      gatherRows(dataPointer[gid],itemSize,index.data(),nSel,buffers[gid].data());
+      ptrs[gid]= buffers[gid].data();
+    } // endfor(gid)
+
+    if (hasMasses) {
+      float *m= (float*)ptrs[gm];
+      double levelMass= 0.0;
+      #pragma omp parallel for reduction(+:levelMass)
+      for (int i=0; i<nSel; i++) levelMass += m[i];
+
+      const float scale= (levelMass > 0.0) ? float(totalMass/levelMass) : 0.0f;
+      #pragma omp parallel for
+      for (int i=0; i<nSel; i++) m[i] *= scale;
+    } // endif
+
+    for (int gid=0; gid<dataName.size(); gid++) {
+      if (dataParticleType[gid] != type || dataPointer[gid] != nullptr || dataDerived[gid] < 0) continue;
+
+      buffers[gid].resize(size_t(nSel)*sizeof(float));
+      evaluateDerived(gid,ptrs,0,nSel,(float*)buffers[gid].data());
+      ptrs[gid]= buffers[gid].data();
+    } // endfor(gid)
+
+    char levelName[16];
+    sprintf(levelName,"LOD_%d",level);
+
+    hid_t level_id= H5Gcreate(group_id,levelName,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    {
+      for (int gid=0; gid<dataName.size(); gid++) {
+        if (dataParticleType[gid] != type || ptrs[gid] == nullptr) continue;
+
+        const int dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+        writeDataset(level_id,memTypeOf(gid),nSel,dof,dataName[gid].c_str(),ptrs[gid]);
+      } // endfor(gid)
+    }
+    H5Gclose(level_id);
+
+    lodCount[level*N_TYPES+type]= nSel;
+  } // endfor(level)
+}
+
+
+int H5pio::loadH5FrameLevel(const int level)
+{
+  if (!fileIsOpen) return 0;
+  XcHandleError(level<1,XCUDA_ERROR,"H5pio::loadH5FrameLevel","level < 1");
+
+  hid_t header_id= H5Gopen(file_id,"Header",H5P_DEFAULT);
+  readAttribute(header_id,H5T_NATIVE_FLOAT,"Time",&frameTime);
+  H5Gclose(header_id);
+
+  int nLoaded= 0;
+
+  for (int type=0; type<N_TYPES; type++) {
+    const int capacity= registeredParticles[type];
+    if (capacity == 0) continue;
+
+    char path[32];
+    sprintf(path,"PartType%d",type);
+    const bool hasType= H5Lexists(file_id,path,H5P_DEFAULT) > 0;
+    sprintf(path,"PartType%d/LOD_%d",type,level);
+
+    if (!hasType || H5Lexists(file_id,path,H5P_DEFAULT) <= 0) {
+      nParticles[type]= 0; // fewer particles than one run of the level
+      continue;
+    } // endif
+
+    hid_t group_id= H5Gopen(file_id,path,H5P_DEFAULT);
+    int rows= 0;
+    {
+      for (int gid=0; gid<dataName.size(); gid++) {
+        if (dataParticleType[gid] != type || dataPointer[gid] == nullptr || dataDerived[gid] >= 0) continue;
+
+        hid_t dataset_id= H5Dopen(group_id,dataName[gid].c_str(),H5P_DEFAULT);
+        XcHandleError(bool(dataset_id<0),XCUDA_ERROR,"H5pio::loadH5FrameLevel",
+          "Field not found in the level of detail");
+
+        hsize_t dims[2]= {0,1};
+        hid_t dataspace_id= H5Dget_space(dataset_id);
+        H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+        H5Sclose(dataspace_id);
+
+        XcHandleError(dims[0]>hsize_t(capacity),XCUDA_ERROR,"H5pio::loadH5FrameLevel",
+          "Registered arrays are too small for the level");
+        rows= int(dims[0]);
+
+        H5Dread(dataset_id,memTypeOf(gid),H5S_ALL,H5S_ALL,H5P_DEFAULT,dataPointer[gid]);
+        H5Dclose(dataset_id);
+      } // endfor(gid)
+    }
+    H5Gclose(group_id);
+
+    nParticles[type]= rows;
+    evaluateDerivedFields(type,dataPointer,rows);
+    nLoaded += rows;
+  } // endfor(type)
+
+  return nLoaded;
+}
+
+
+int H5pio::loadFrameLevel(const int frameID, const int level)
+{
+  char fileName[XCUDA_PATH_LENGTH];
+  frameFileName(frameID,fileName);
+
+  std::lock_guard<std::mutex> lock(h5Mutex);
+
+  float theFrameTime;
+  int nLoaded;
+
+  openH5File(fileName,false);
+  {
+    nLoaded= loadH5FrameLevel(level);
+    theFrameTime= frameTime;
+  }
+  closeH5File();
+
+  multiTemporalFrameID= frameID;
+  frameTime= theFrameTime;
+  endOfFile= false;
+
+  return nLoaded;
+}
+
+
+// ***** summary statistics *****
+//
+// One parallel pass per component for min/max/sum, and a second one
+// for the histogram, over the buffer that saveH5Frame() just wrote.
+// NaN and infinite values are left out of both; the number of finite
+// values is returned.
+//
+template <typename T>
+static size_t summarize(const T *data, const size_t n, const int dof, const int d,
+                        double *vMin, double *vMax, double *vSum)
+{
+  T tMin= std::numeric_limits<T>::max();
+  T tMax= std::numeric_limits<T>::lowest();
+  double sum= 0.0;
+  size_t count= 0;
+
+  #pragma omp parallel for simd reduction(min:tMin) reduction(max:tMax) reduction(+:sum,count)
+  for (size_t i=0; i<n; i++) {
+    const T v= data[i*dof+d];
+    if (isfinite(double(v))) {
+      tMin= (v < tMin) ? v : tMin;
+      tMax= (v > tMax) ? v : tMax;
+      sum += double(v);
+      count++;
+    }
+  } // endfor(i)
+
+  *vMin= (count > 0) ? double(tMin) : NAN;
+  *vMax= (count > 0) ? double(tMax) : NAN;
+  *vSum= sum;
+  return count;
+}
+
+template <typename T>
+static void histogram(const T *data, const size_t n, const int dof, const int d,
+                      const double vMin, const double vMax, const int nBins, long long *bins)
 {
-  multiTemporalFrameID= 0;
-  XCuda::stringCopy(theBaseName,fileName_in,XCUDA_PATH_LENGTH);
-  stripSuffix(theBaseName);
-  stripID(theBaseName);
+  const double scale= (vMax > vMin) ? nBins/(vMax-vMin) : 0.0;
+
+  #pragma omp parallel
+  {
+    vector<long long> local(nBins,0);
+
+    #pragma omp for nowait
+    for (size_t i=0; i<n; i++) {
+      const double v= double(data[i*dof+d]);
+      if (!isfinite(v)) continue;
+      int b= int((v - vMin)*scale);
+      b= (b < 0) ? 0 : (b >= nBins ? nBins-1 : b);
+      local[b]++;
+    } // endfor(i)
+
+    #pragma omp critical
+    for (int b=0; b<nBins; b++) bins[b] += local[b];
+  }
 }
 
 
-void H5pio::closeFiles(void)
+void H5pio::setStatistics(const bool flag, const int nBins)
 {
-  closeH5File();
-  closeXdmfFile();
+  XcHandleError(nBins<0,XCUDA_ERROR,"H5pio::setStatistics","nBins < 0");
+
+  saveStatistics= flag;
+  statisticsBins= nBins;
 }
 
 
-void H5pio::saveFrame(const float time)
+void H5pio::writeStatistics(const int type, const int gid, const int np, hid_t group_id)
 {
-  multiTemporalFrameID++;
+  const void *ptr= dataPointer[gid];
+  if (ptr == nullptr || np <= 0) return;
 
-  char fileName[XCUDA_PATH_LENGTH];
-  sprintf(fileName,"%s_%04d.hdf5",theBaseName,multiTemporalFrameID);
+  const int dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+  const int nBins= statisticsBins;
 
-  pushXdmfState();
+  double vMin[3], vMax[3], vSum[3], vMean[3];
+  vector<long long> bins(size_t(dof)*nBins,0);
+
+  for (int d=0; d<dof; d++) {
+    size_t count;
+    if (dataIsBoolean1D[gid]) {
+      count= summarize((const bool*)ptr,np,dof,d,&vMin[d],&vMax[d],&vSum[d]);
+    } else if (dataIsInteger1D[gid]) {
+      count= summarize((const int*)ptr,np,dof,d,&vMin[d],&vMax[d],&vSum[d]);
+    } else {
+      count= summarize((const float*)ptr,np,dof,d,&vMin[d],&vMax[d],&vSum[d]);
+    }
+    vMean[d]= (count > 0) ? vSum[d]/double(count) : NAN;
+
+    if (nBins > 0) {
+      long long *b= &bins[size_t(d)*nBins];
+      if (dataIsBoolean1D[gid]) {
+        histogram((const bool*)ptr,np,dof,d,vMin[d],vMax[d],nBins,b);
+      } else if (dataIsInteger1D[gid]) {
+        histogram((const int*)ptr,np,dof,d,vMin[d],vMax[d],nBins,b);
+      } else {
+        histogram((const float*)ptr,np,dof,d,vMin[d],vMax[d],nBins,b);
+      }
+    } // endif
+  } // endfor(d)
+
+  // attributes of the dataset
+  //
+  hid_t dataset_id= H5Dopen(group_id,dataName[gid].c_str(),H5P_DEFAULT);
   {
-    openH5File(fileName,true);
-    openXdmfFile();
-    saveH5Frame(time);
-    saveXdmfFrame(time);
-    closeH5File();
-    closeXdmfFile();
+    writeAttribute(dataset_id,H5T_NATIVE_DOUBLE,"Minimum",vMin,dof);
+    writeAttribute(dataset_id,H5T_NATIVE_DOUBLE,"Maximum",vMax,dof);
+    writeAttribute(dataset_id,H5T_NATIVE_DOUBLE,"Mean",vMean,dof);
+    writeAttribute(dataset_id,H5T_NATIVE_DOUBLE,"Sum",vSum,dof);
+    if (nBins > 0) {
+      writeAttribute(dataset_id,H5T_NATIVE_LLONG,"Histogram",bins.data(),dof*nBins);
+    }
   }
-  popXdmfState();
+  H5Dclose(dataset_id);
 
-  xdmfFrameID= 0;
-  saveXdmfFrame(time);
+  // and in the header
+  //
+  hid_t header_id= H5Gopen(file_id,"Header",H5P_DEFAULT);
+  {
+    char name[XCUDA_PATH_LENGTH];
+    const char *field= dataName[gid].c_str();
+
+    snprintf(name,XCUDA_PATH_LENGTH,"PartType%d_%s_Minimum",type,field);
+    writeAttribute(header_id,H5T_NATIVE_DOUBLE,name,vMin,dof);
+    snprintf(name,XCUDA_PATH_LENGTH,"PartType%d_%s_Maximum",type,field);
+    writeAttribute(header_id,H5T_NATIVE_DOUBLE,name,vMax,dof);
+    snprintf(name,XCUDA_PATH_LENGTH,"PartType%d_%s_Mean",type,field);
+    writeAttribute(header_id,H5T_NATIVE_DOUBLE,name,vMean,dof);
+    snprintf(name,XCUDA_PATH_LENGTH,"PartType%d_%s_Sum",type,field);
+    writeAttribute(header_id,H5T_NATIVE_DOUBLE,name,vSum,dof);
+  }
+  H5Gclose(header_id);
 }
 
-void H5pio::loadFrame(void)
+
+void H5pio::readStatistics(const int type, XcCString name, vector<Statistics> &series)
 {
-  multiTemporalFrameID++;
+  buildFrameCatalog();
+  vector<Statistics>().swap(series);
 
-  char fileName[XCUDA_PATH_LENGTH];
-  sprintf(fileName,"%s_%04d.hdf5",theBaseName,multiTemporalFrameID);
-  FILE *fp= fopen(fileName,"r");
-  endOfFile= bool(fp == nullptr);
+  char path[XCUDA_PATH_LENGTH];
+  snprintf(path,XCUDA_PATH_LENGTH,"PartType%d/%s",type,name);
 
-  if (fp) {
-    fclose(fp);
+  std::lock_guard<std::mutex> lock(h5Mutex);
 
-    // loadH5Frame() will set these.
-    // closeH5File() will reset them!
-    //
-    float theFrameTime;
+  for (int f=0; f<frameCatalog.size(); f++) {
+    const FrameInfo &info= frameCatalog[f];
+    if (info.nParticles[type] == 0) continue;
 
-    openH5File(fileName,false);
+    char fileName[XCUDA_PATH_LENGTH];
+    frameFileName(info.frameID,fileName);
+
+    hid_t fid= openProfiled(fileName,H5F_ACC_RDONLY,faplProfile);
+    XcHandleError(bool(fid<0),XCUDA_ERROR,"H5pio::readStatistics",
+      "Unable to open an HDF5 file (check name and/or path)");
     {
-      loadH5Frame();
-      theFrameTime= frameTime;
+      hid_t dataset_id= H5Dopen(fid,path,H5P_DEFAULT);
+      XcHandleError(bool(dataset_id<0),XCUDA_ERROR,"H5pio::readStatistics",
+        "Field not found in file");
+
+      if (H5Aexists(dataset_id,"Sum") > 0) {
+        Statistics stats;
+        stats.frameID= info.frameID;
+        stats.time= info.time;
+
+        hsize_t dims[2]= {0,1};
+        hid_t dataspace_id= H5Dget_space(dataset_id);
+        H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+        H5Sclose(dataspace_id);
+        stats.dof= int(dims[1]);
+
+        readAttribute(dataset_id,H5T_NATIVE_DOUBLE,"Minimum",stats.minimum);
+        readAttribute(dataset_id,H5T_NATIVE_DOUBLE,"Maximum",stats.maximum);
+        readAttribute(dataset_id,H5T_NATIVE_DOUBLE,"Mean",stats.mean);
+        readAttribute(dataset_id,H5T_NATIVE_DOUBLE,"Sum",stats.sum);
+
+        if (H5Aexists(dataset_id,"Histogram") > 0) {
+          hid_t attribute_id= H5Aopen(dataset_id,"Histogram",H5P_DEFAULT);
+          hid_t space_id= H5Aget_space(attribute_id);
+          stats.histogram.resize(H5Sget_simple_extent_npoints(space_id));
+          H5Sclose(space_id);
+          H5Aread(attribute_id,H5T_NATIVE_LLONG,stats.histogram.data());
+          H5Aclose(attribute_id);
+        } // endif
+
+        series.push_back(stats);
+      } // endif
+
+      H5Dclose(dataset_id);
     }
-    closeH5File();
+    H5Fclose(fid);
+  } // endfor(f)
+}
 
-    frameTime= theFrameTime;
-    endOfFile= false;
-  } // endif
+
+// ***** zone maps and filtered loads *****
+//
+void H5pio::enableZoneMap(XcCString name)
+{
+  zoneMapNames.push_back(string(name));
 }
 
 
-// ***** utilities for HDF5 I/O *****
+bool H5pio::isZoneMapField(const int gid)
+{
+  if (dataIsBoolean1D[gid] || dataPointer[gid] == nullptr) return false;
+
+  for (int k=0; k<zoneMapNames.size(); k++) {
+    if (zoneMapNames[k] == dataName[gid]) return true;
+  } // endfor(k)
+
+  return false;
+}
+
+
+// Per-chunk [min,max] of each component, computed from the in-memory
+// buffer that was just written (no extra I/O).
 //
-void H5pio::openH5File(XcCString fileName, const bool createFile)
+void H5pio::writeZoneMap(const int type, const int gid, const int np)
 {
-  frameTime= 0.0f;
-  endOfFile= false;
+  // one entry per dataset chunk, with the field's tuned chunk size
+  //
+  const int dof= (dataIsFloat3D[gid] || dataIsGeometry3D[gid]) ? 3 : 1;
+  const int fieldRows= getCompression(type,dataName[gid].c_str()).chunkRows;
+  const int rows= (np < fieldRows) ? np : fieldRows;
+  const int nChunks= (np + rows - 1)/rows;
+
+  vector<double> zoneMap(size_t(nChunks)*2*dof);
+
+  const float *fdata= (const float*)dataPointer[gid];
+  const int   *idata= (const int*)dataPointer[gid];
+  const bool isInteger= dataIsInteger1D[gid];
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int c=0; c<nChunks; c++) {
+    const size_t lo= size_t(c)*rows;
+    const size_t hi= (lo+rows < np) ? lo+rows : np;
+
+    for (int d=0; d<dof; d++) {
+      double vMin=  HUGE_VAL;
+      double vMax= -HUGE_VAL;
+      if (isInteger) {
+        int iMin= idata[lo];
+        int iMax= idata[lo];
+        #pragma omp simd reduction(min:iMin) reduction(max:iMax)
+        for (size_t i=lo; i<hi; i++) {
+          iMin= (idata[i] < iMin) ? idata[i] : iMin;
+          iMax= (idata[i] > iMax) ? idata[i] : iMax;
+        }
+        vMin= iMin;
+        vMax= iMax;
+      } else {
+        float fMin= fdata[lo*dof+d];
+        float fMax= fdata[lo*dof+d];
+        #pragma omp simd reduction(min:fMin) reduction(max:fMax)
+        for (size_t i=lo; i<hi; i++) {
+          fMin= (fdata[i*dof+d] < fMin) ? fdata[i*dof+d] : fMin;
+          fMax= (fdata[i*dof+d] > fMax) ? fdata[i*dof+d] : fMax;
+        }
+        vMin= fMin;
+        vMax= fMax;
+      } // endif
+      zoneMap[(size_t(c)*dof + d)*2 + 0]= vMin;
+      zoneMap[(size_t(c)*dof + d)*2 + 1]= vMax;
+    } // endfor(d)
+  } // endfor(c)
 
-  XCuda::stringCopy(hdf5Name,fileName,XCUDA_PATH_LENGTH);
-  addSuffix(hdf5Name,".hdf5");
+  char partType[16];
+  sprintf(partType,"PartType%d",type);
 
-  if (createFile) {
-    file_id= H5Fcreate(hdf5Name,H5F_ACC_TRUNC,H5P_DEFAULT,H5P_DEFAULT);
-  } else {
-    file_id= H5Fopen(hdf5Name,H5F_ACC_RDWR,H5P_DEFAULT); // 02/21/2020 H5F_ACC_RDONLY
+  if (!H5Lexists(file_id,"ZoneMaps",H5P_DEFAULT)) {
+    H5Gclose(H5Gcreate(file_id,"ZoneMaps",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT));
   }
 
-  XcHandleError(bool(file_id<0),XCUDA_ERROR,"H5pio::openH5File",
-    "Unable to create or open an HDF5 file (check name and/or path)");
+  hid_t maps_id= H5Gopen(file_id,"ZoneMaps",H5P_DEFAULT);
+  {
+    if (!H5Lexists(maps_id,partType,H5P_DEFAULT)) {
+      H5Gclose(H5Gcreate(maps_id,partType,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT));
+    }
 
-  fileIsOpen= true;
+    hid_t group_id= H5Gopen(maps_id,partType,H5P_DEFAULT);
+    {
+      hsize_t dims[2]= {hsize_t(nChunks),hsize_t(2*dof)};
+      hid_t dataspace_id= H5Screate_simple(2,dims,nullptr);
+      hid_t dataset_id= H5Dcreate(group_id,dataName[gid].c_str(),H5T_NATIVE_DOUBLE,dataspace_id,
+                                  H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+      H5Dwrite(dataset_id,H5T_NATIVE_DOUBLE,H5S_ALL,H5S_ALL,H5P_DEFAULT,zoneMap.data());
+
+      int theChunkRows= rows;
+      writeAttribute(dataset_id,H5T_NATIVE_INT,"ChunkRows",&theChunkRows);
+
+      H5Dclose(dataset_id);
+      H5Sclose(dataspace_id);
+    }
+    H5Gclose(group_id);
+  }
+  H5Gclose(maps_id);
 }
 
-void H5pio::closeH5File(void)
+
+int H5pio::loadFrameWhere(const int frameID, const int type, const vector<Range> &where)
 {
-  if (!fileIsOpen) return;
+  char fileName[XCUDA_PATH_LENGTH];
+  frameFileName(frameID,fileName);
 
-  H5Fclose(file_id);
-  fileIsOpen= false;
+  std::lock_guard<std::mutex> lock(h5Mutex);
 
-  frameTime= 0.0f;
-  endOfFile= true;
+  float theFrameTime;
+  int nSelected;
+
+  openH5File(fileName,false);
+  {
+    nSelected= loadH5FrameWhere(type,where);
+    theFrameTime= frameTime;
+  }
+  closeH5File();
+
+  multiTemporalFrameID= frameID;
+  frameTime= theFrameTime;
+  endOfFile= false;
+
+  return nSelected;
 }
 
-void H5pio::saveH5Frame(const float time)
+
+int H5pio::loadH5FrameWhere(const int type, const vector<Range> &where)
 {
-  if (!fileIsOpen || endOfFile) return;
+  if (!fileIsOpen) return 0;
 
-  frameTime= time;
+  const int capacity= nParticles[type];
 
-  hid_t group_id= H5Gcreate(file_id,"Header",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
-  {
-    int flag_DoublePrecision= 0; // single for now
-    float massTable[N_TYPES]; for (int i=0; i<N_TYPES; i++) massTable[i]= 0.0f; // in datasets
-    int numFilesPerSnapshot= 1;
-    int numPart_Total_HighWord[N_TYPES]; for (int i=0; i<N_TYPES; i++) numPart_Total_HighWord[i]= 0; // ?
+  hid_t header_id= H5Gopen(file_id,"Header",H5P_DEFAULT);
+  readAttribute(header_id,H5T_NATIVE_FLOAT,"Time",&frameTime);
+  H5Gclose(header_id);
+
+  char partType[16];
+  sprintf(partType,"PartType%d",type);
+
+  hid_t group_id= H5Gopen(file_id,partType,H5P_DEFAULT);
+  XcHandleError(bool(group_id<0),XCUDA_ERROR,"H5pio::loadH5FrameWhere",
+    "Particle type not found in file");
+
+  // registered fields of this type
+  //
+  vector<int> gids;
+  vector<hid_t> fieldSets;
+  for (int gid=0; gid<dataName.size(); gid++) {
+    if (dataParticleType[gid] == type && dataPointer[gid] != nullptr && dataDerived[gid] < 0) {
+      gids.push_back(gid);
+      fieldSets.push_back(H5Dopen(group_id,dataName[gid].c_str(),H5P_DEFAULT));
+    }
+  } // endfor(gid)
 
-    writeAttribute(group_id,H5T_NATIVE_INT,   "Flag_DoublePrecision", &flag_DoublePrecision);
-    writeAttribute(group_id,H5T_NATIVE_FLOAT, "MassTable", &massTable, N_TYPES);
-    writeAttribute(group_id,H5T_NATIVE_INT,   "NumFilesPerSnapshot", &numFilesPerSnapshot);
-    writeAttribute(group_id,H5T_NATIVE_INT,   "NumPart_ThisFile", nParticles, N_TYPES);
-    writeAttribute(group_id,H5T_NATIVE_INT,   "NumPart_Total", &nParticles, N_TYPES);
-    writeAttribute(group_id,H5T_NATIVE_INT,   "NumPart_Total_HighWord", &numPart_Total_HighWord, N_TYPES);
-    writeAttribute(group_id,H5T_NATIVE_FLOAT, "Time", &frameTime);
+  // predicate fields (scalars)
+  //
+  const int nPred= where.size();
+  vector<hid_t> predSets(nPred);
+  hsize_t nRows= 0;
+  hsize_t rows= 0;
+
+  for (int p=0; p<nPred; p++) {
+    predSets[p]= H5Dopen(group_id,where[p].name.c_str(),H5P_DEFAULT);
+    XcHandleError(bool(predSets[p]<0),XCUDA_ERROR,"H5pio::loadH5FrameWhere",
+      "Predicate field not found in file");
+
+    hsize_t dims[2]= {0,1};
+    hid_t dataspace_id= H5Dget_space(predSets[p]);
+    H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+    H5Sclose(dataspace_id);
+    XcHandleError(dims[1]!=1,XCUDA_ERROR,"H5pio::loadH5FrameWhere",
+      "Predicate fields must be scalars");
+    nRows= dims[0];
+
+    if (p == 0) {
+      hid_t plist_id= H5Dget_create_plist(predSets[p]);
+      if (H5Pget_layout(plist_id) == H5D_CHUNKED) {
+        hsize_t cdims[2]= {0,1};
+        H5Pget_chunk(plist_id,2,cdims);
+        rows= cdims[0];
+      }
+      H5Pclose(plist_id);
+    }
+  } // endfor(p)
+
+  if (nRows == 0 && fieldSets.size() > 0) {
+    hsize_t dims[2]= {0,1};
+    hid_t dataspace_id= H5Dget_space(fieldSets[0]);
+    H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+    H5Sclose(dataspace_id);
+    nRows= dims[0];
   }
+  if (rows == 0) rows= (nRows < hsize_t(chunkRows)) ? nRows : hsize_t(chunkRows);
 
-  for (int type=0; type<N_TYPES; type++) {
-    const int np= nParticles[type];
-    if (np > 0) {
+  const int nChunks= (rows > 0) ? int((nRows + rows - 1)/rows) : 0;
 
-      char partType[16];
-      sprintf(partType,"PartType%d",type);
+  // skip chunks whose zone maps cannot match
+  //
+  vector<unsigned char> candidate(nChunks,1);
+  for (int p=0; p<nPred; p++) {
+    char path[XCUDA_PATH_LENGTH];
+    snprintf(path,XCUDA_PATH_LENGTH,"ZoneMaps/%s/%s",partType,where[p].name.c_str());
+
+    if (!H5Lexists(file_id,"ZoneMaps",H5P_DEFAULT)) break;
+    char typePath[32];
+    snprintf(typePath,32,"ZoneMaps/%s",partType);
+    if (!H5Lexists(file_id,typePath,H5P_DEFAULT)) break;
+    if (!H5Lexists(file_id,path,H5P_DEFAULT)) continue;
+
+    hid_t dataset_id= H5Dopen(file_id,path,H5P_DEFAULT);
+    {
+      int mapRows= 0;
+      readAttribute(dataset_id,H5T_NATIVE_INT,"ChunkRows",&mapRows);
+
+      hsize_t dims[2]= {0,0};
+      hid_t dataspace_id= H5Dget_space(dataset_id);
+      H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+      H5Sclose(dataspace_id);
+
+      // the fields may be tuned to different chunk sizes: a chunk is
+      // skipped when no entry of the map that overlaps it can match
+      //
+      const hsize_t nEntries= (mapRows > 0) ? (nRows + mapRows - 1)/hsize_t(mapRows) : 0;
+      if (mapRows > 0 && dims[0] == nEntries && dims[1] == 2) {
+        vector<double> zoneMap(size_t(nEntries)*2);
+        H5Dread(dataset_id,H5T_NATIVE_DOUBLE,H5S_ALL,H5S_ALL,H5P_DEFAULT,zoneMap.data());
+
+        for (int c=0; c<nChunks; c++) {
+          const hsize_t e0= hsize_t(c)*rows/mapRows;
+          const hsize_t e1= std::min(nEntries,(std::min(hsize_t(c+1)*rows,nRows) + mapRows - 1)/mapRows);
+
+          bool mayMatch= false;
+          for (hsize_t e=e0; e<e1 && !mayMatch; e++) {
+            mayMatch= !(zoneMap[2*e+1] < where[p].lo || zoneMap[2*e] > where[p].hi);
+          } // endfor(e)
+          if (!mayMatch) candidate[c]= 0;
+        } // endfor(c)
+      } // endif
+    }
+    H5Dclose(dataset_id);
+  } // endfor(p)
 
-      hid_t group_id= H5Gcreate(file_id,partType,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
-      {
-        for (int gid=0; gid<dataName.size(); gid++) {
-          if (dataParticleType[gid] == type) {
+  // evaluate the predicate per candidate chunk and compact the matches
+  //
+  int maxItemSize= 1;
+  for (int k=0; k<gids.size(); k++) {
+    if (getItemSize(gids[k]) > maxItemSize) maxItemSize= getItemSize(gids[k]);
+  }
 
-            bool isNodeCentered= dataIsNodeCentered[gid]; // N/A
-            bool isBoolean1D= dataIsBoolean1D[gid];
-            bool isInteger1D= dataIsInteger1D[gid];
-            bool isFloat1D= dataIsFloat1D[gid];
-            bool isFloat3D= dataIsFloat3D[gid];
-            bool isGeometry3D= dataIsGeometry3D[gid];
-            char *name= (char*)dataName[gid].c_str();
-            void *ptr= dataPointer[gid];
+  vector<double> values(rows);
+  vector<unsigned char> mask(rows);
+  vector<int> index(rows);
+  vector<char> chunk(size_t(rows)*maxItemSize);
 
-            if (isBoolean1D) {
-              writeDataset(group_id,H5T_NATIVE_HBOOL,np,1,name,ptr);
-            } else if (isInteger1D) {
-              writeDataset(group_id,H5T_NATIVE_INT,np,1,name,ptr);
-            } else if (isFloat1D) {
-              writeDataset(group_id,H5T_NATIVE_FLOAT,np,1,name,ptr);
-            } else if (isFloat3D) {
-              writeDataset(group_id,H5T_NATIVE_FLOAT,np,3,name,ptr);
-            } else if (isGeometry3D) {
-              writeDataset(group_id,H5T_NATIVE_FLOAT,np,3,name,ptr);
-            } // endif
+  int nSelected= 0;
 
-          } // endif
-        } // endfor(gid)
-      }
-      H5Gclose(group_id);
+  for (int c=0; c<nChunks; c++) {
+    if (!candidate[c]) continue;
 
-    } // endif
-  } // endfor(type)
-}
+    const hsize_t row0= hsize_t(c)*rows;
+    const int n= int((row0+rows <= nRows) ? rows : nRows-row0);
 
+    unsigned char *m= mask.data();
+    for (int i=0; i<n; i++) m[i]= 1;
 
-void H5pio::loadH5Frame(void)
-{
-  if (!fileIsOpen) return;
+    for (int p=0; p<nPred; p++) {
+      readRows(predSets[p],H5T_NATIVE_DOUBLE,row0,n,values.data());
 
-  hid_t group_id= H5Gopen(file_id,"Header",H5P_DEFAULT);
-  {
-    int np[N_TYPES];
-    frameTime= 0.0f;
-    
-    readAttribute(group_id,H5T_NATIVE_INT,"NumPart_ThisFile",np);
-    readAttribute(group_id,H5T_NATIVE_FLOAT,"Time",&frameTime);
+      const double *v= values.data();
+      const double lo= where[p].lo;
+      const double hi= where[p].hi;
+      #pragma omp parallel for simd
+      for (int i=0; i<n; i++) m[i] &= (unsigned char)((v[i] >= lo) & (v[i] <= hi));
+    } // endfor(p)
 
-    for (int i=0; i<N_TYPES; i++) {
-      XcHandleError(bool(np[i] != nParticles[i]),XCUDA_ERROR,"H5pio::loadH5Frame",
-        "Inconsistent number of particles; bad checkpoint file?");
-    } // endfor
-  }
-  H5Gclose(group_id);
+    const int nSel= selectIndices(m,n,index.data());
+    if (nSel == 0) continue;
 
-  for (int type=0; type<N_TYPES; type++) {
-    const int np= nParticles[type];
-    if (np > 0) {
+    XcHandleError(nSelected+nSel>capacity,XCUDA_ERROR,"H5pio::loadH5FrameWhere",
+      "Registered arrays are too small for the selection");
 
-      char partType[16];
-      sprintf(partType,"PartType%d",type);
+    for (int k=0; k<gids.size(); k++) {
+      const int gid= gids[k];
+      const int itemSize= getItemSize(gid);
+      const hid_t memType= dataIsBoolean1D[gid] ? H5T_NATIVE_HBOOL :
+                           dataIsInteger1D[gid] ? H5T_NATIVE_INT : H5T_NATIVE_FLOAT;
 
-      hid_t group_id= H5Gopen(file_id,partType,H5P_DEFAULT);
-      {
+      readRows(fieldSets[k],memType,row0,n,chunk.data());
+      gatherRows(chunk.data(),itemSize,index.data(),nSel,
+                 (char*)dataPointer[gid] + size_t(nSelected)*itemSize);
+    } // endfor(k)
 
-        for (int gid=0; gid<dataName.size(); gid++) {
-          if (dataParticleType[gid] == type) {
+    nSelected += nSel;
+  } // endfor(c)
 
-            bool isNodeCentered= dataIsNodeCentered[gid]; // N/A
-            bool isBoolean1D= dataIsBoolean1D[gid];
-            bool isInteger1D= dataIsInteger1D[gid];
-            bool isFloat1D= dataIsFloat1D[gid];
-            bool isFloat3D= dataIsFloat3D[gid];
-            bool isGeometry3D= dataIsGeometry3D[gid];
-            char *name= (char*)dataName[gid].c_str();
-            void *ptr= dataPointer[gid];
+  for (int p=0; p<nPred; p++) H5Dclose(predSets[p]);
+  for (int k=0; k<fieldSets.size(); k++) H5Dclose(fieldSets[k]);
+  H5Gclose(group_id);
 
-            if (isBoolean1D) {
-              readDataset(group_id,H5T_NATIVE_HBOOL,name,ptr);
-            } else if (isInteger1D) {
-              readDataset(group_id,H5T_NATIVE_INT,name,ptr);
-            } else if (isFloat1D) {
-              readDataset(group_id,H5T_NATIVE_FLOAT,name,ptr);
-            } else if (isFloat3D) {
-              readDataset(group_id,H5T_NATIVE_FLOAT,name,ptr);
-            } else if (isGeometry3D) {
-              readDataset(group_id,H5T_NATIVE_FLOAT,name,ptr);
-            }
+  nParticles[type]= nSelected;
+  evaluateDerivedFields(type,dataPointer,nSelected);
 
-          } // endif
-        } // endfor(gid)
-      }
-      H5Gclose(group_id);
+  return nSelected;
+}
 
 
-    } // endif
-  } // endfor(type)
+// Reads rows [row0,row0+nRows) of a rank 1 or rank 2 dataset.
+//
+void H5pio::readRows(hid_t dataset_id, hid_t memType, hsize_t row0, hsize_t nRows, void* data)
+{
+  hsize_t dims[2]= {0,1};
+  hid_t filespace_id= H5Dget_space(dataset_id);
+  const int rank= H5Sget_simple_extent_dims(filespace_id,dims,nullptr);
+
+  hsize_t offset[2]= {row0,0};
+  hsize_t count[2]= {nRows,dims[1]};
+  H5Sselect_hyperslab(filespace_id,H5S_SELECT_SET,offset,nullptr,count,nullptr);
+
+  hid_t memspace_id= H5Screate_simple(rank,count,nullptr);
+  {
+    H5Dread(dataset_id,memType,memspace_id,filespace_id,H5P_DEFAULT,data);
+  }
+  H5Sclose(memspace_id);
+  H5Sclose(filespace_id);
 }
 
+
 void H5pio::writeDataset(hid_t group_id, hid_t type, int nItems, int dof, XcCString name, void* data)
 {
   if (data == nullptr) return;
@@ -382,10 +4491,8 @@ void H5pio::writeDataset(hid_t group_id, hid_t type, int nItems, int dof, XcCStr
   hsize_t dims[2]= {hsize_t(nItems),hsize_t(dof)};
   hid_t dataspace_id= H5Screate_simple(2,dims,nullptr);
   {
-    hsize_t cdims[2]= {hsize_t(nItems),hsize_t(dof)};
     hid_t plist_id= H5Pcreate(H5P_DATASET_CREATE);
-    H5Pset_chunk(plist_id,2,cdims);
-    H5Pset_deflate(plist_id,6);
+    setCompression(plist_id,group_id,name,hsize_t(nItems),hsize_t(dof));
     {
       hid_t dataset_id= H5Dcreate(group_id,name,type,dataspace_id,
                                   H5P_DEFAULT,plist_id,H5P_DEFAULT);
@@ -542,18 +4649,44 @@ void H5pio::saveXdmfFrame(const float time)
   fprintf(xdmfFile,"        <Time Value=\"%.4e\"/>\n",time);
   fprintf(xdmfFile,"\n");
 
+  if (xdmfLevel == 0 && usesWritePlan(false)) {
+    const char *fileName= basename(hdf5Name);
+    for (int k=0; k<writePlan.xdmfText.size(); k++) {
+      if (k > 0) fputs(fileName,xdmfFile);
+      fputs(writePlan.xdmfText[k].c_str(),xdmfFile);
+    } // endfor(k)
+  } else {
+    writeXdmfFields(xdmfFile,basename(hdf5Name),xdmfLevel);
+  } // endif
+
+  fprintf(xdmfFile,"\n");
+  fprintf(xdmfFile,"      </Grid>\n");
+  fprintf(xdmfFile,"\n");
+}
+
+
+// The fields of level of detail "level" in the frame file "fileName",
+// written to "fp".
+//
+void H5pio::writeXdmfFields(FILE *fp, XcCString fileName, const int level)
+{
   const int nGroups= dataName.size();
 
   if (nGroups > 0) {
     for (int pg=0; pg<nGroups; pg++) {
 
       const int type= dataParticleType[pg]; // [0,5]
-      const int np= nParticles[type];
+      const int np= (level > 0) ? lodCount[level*N_TYPES+type] : nParticles[type];
+      if (np == 0) continue; // e.g. nothing selected by exportFrame()
 
-      fprintf(xdmfFile,"        <Topology TopologyType=\"Polyvertex\" NumberOfElements=\"%d\" />\n",np);
+      fprintf(fp,"        <Topology TopologyType=\"Polyvertex\" NumberOfElements=\"%d\" />\n",np);
 
-      char partType[16];
-      sprintf(partType,"PartType%d",type);
+      char partType[32];
+      if (level > 0) {
+        sprintf(partType,"PartType%d/LOD_%d",type,level);
+      } else {
+        sprintf(partType,"PartType%d",type);
+      }
 
       bool isNodeCentered= dataIsNodeCentered[pg];
       bool isBoolean1D= dataIsBoolean1D[pg];
@@ -565,95 +4698,85 @@ void H5pio::saveXdmfFrame(const float time)
       void *ptr= dataPointer[pg];
 
       if (isBoolean1D) {
-        writeXdmfAttributeBoolean1D(np,partType,name,isNodeCentered);
+        writeXdmfAttributeBoolean1D(fp,fileName,np,partType,name,isNodeCentered);
       } else if (isInteger1D) {
-        writeXdmfAttributeInteger1D(np,partType,name,isNodeCentered);
+        writeXdmfAttributeInteger1D(fp,fileName,np,partType,name,isNodeCentered);
       } else if (isFloat1D) {
-        writeXdmfAttributeFloat1D(np,partType,name,isNodeCentered);
+        writeXdmfAttributeFloat1D(fp,fileName,np,partType,name,isNodeCentered);
       } else if (isFloat3D) {
-        writeXdmfAttributeFloat3D(np,partType,name,isNodeCentered);
+        writeXdmfAttributeFloat3D(fp,fileName,np,partType,name,isNodeCentered);
       } else if (isGeometry3D) {
-        writeXdmfGeometry3D(np,partType,name);
+        writeXdmfGeometry3D(fp,fileName,np,partType,name);
       } // endif
 
     } // endfor(pg)
   } // endif(nGroups)
-
-  fprintf(xdmfFile,"\n");
-  fprintf(xdmfFile,"      </Grid>\n");
-  fprintf(xdmfFile,"\n");
 }
 
-void H5pio::writeXdmfAttributeBoolean1D(int np, XcCString partType, XcCString name, const bool isNodeCentered)
+void H5pio::writeXdmfAttributeBoolean1D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name,
+                                        const bool isNodeCentered)
 {
-  if (!xdmfFileIsOpen) return;
-
   const char *mode= isNodeCentered ? "Node" : "Cell";
 
-  fprintf(xdmfFile,"\n");
-  fprintf(xdmfFile,"        <Attribute Name=\"%s\" AttributeType=\"Scalar\" Center=\"%s\">\n",name,mode);
-  fprintf(xdmfFile,"          <DataItem Dimensions=\"%d\" NumberType=\"Char\" Precision=\"1\" Format=\"HDF\" >\n",np);
-  fprintf(xdmfFile,"            %s:/%s/%s\n",basename(hdf5Name),partType,name);
-  fprintf(xdmfFile,"          </DataItem>\n");
-  fprintf(xdmfFile,"        </Attribute>\n");
+  fprintf(fp,"\n");
+  fprintf(fp,"        <Attribute Name=\"%s\" AttributeType=\"Scalar\" Center=\"%s\">\n",name,mode);
+  fprintf(fp,"          <DataItem Dimensions=\"%d\" NumberType=\"Char\" Precision=\"1\" Format=\"HDF\" >\n",np);
+  fprintf(fp,"            %s:/%s/%s\n",fileName,partType,name);
+  fprintf(fp,"          </DataItem>\n");
+  fprintf(fp,"        </Attribute>\n");
 }
 
 
-void H5pio::writeXdmfAttributeInteger1D(int np, XcCString partType, XcCString name, const bool isNodeCentered)
+void H5pio::writeXdmfAttributeInteger1D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name,
+                                        const bool isNodeCentered)
 {
-  if (!xdmfFileIsOpen) return;
-
   const char *mode= isNodeCentered ? "Node" : "Cell";
 
-  fprintf(xdmfFile,"\n");
-  fprintf(xdmfFile,"        <Attribute Name=\"%s\" AttributeType=\"Scalar\" Center=\"%s\">\n",name,mode);
-  fprintf(xdmfFile,"          <DataItem Dimensions=\"%d\" NumberType=\"Integer\" Precision=\"4\" Format=\"HDF\" >\n",np);
-  fprintf(xdmfFile,"            %s:/%s/%s\n",basename(hdf5Name),partType,name);
-  fprintf(xdmfFile,"          </DataItem>\n");
-  fprintf(xdmfFile,"        </Attribute>\n");
+  fprintf(fp,"\n");
+  fprintf(fp,"        <Attribute Name=\"%s\" AttributeType=\"Scalar\" Center=\"%s\">\n",name,mode);
+  fprintf(fp,"          <DataItem Dimensions=\"%d\" NumberType=\"Integer\" Precision=\"4\" Format=\"HDF\" >\n",np);
+  fprintf(fp,"            %s:/%s/%s\n",fileName,partType,name);
+  fprintf(fp,"          </DataItem>\n");
+  fprintf(fp,"        </Attribute>\n");
 }
 
 
-void H5pio::writeXdmfAttributeFloat1D(int np, XcCString partType, XcCString name, const bool isNodeCentered)
+void H5pio::writeXdmfAttributeFloat1D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name,
+                                      const bool isNodeCentered)
 {
-  if (!xdmfFileIsOpen) return;
-
   const char *mode= isNodeCentered ? "Node" : "Cell";
 
-  fprintf(xdmfFile,"\n");
-  fprintf(xdmfFile,"        <Attribute Name=\"%s\" AttributeType=\"Scalar\" Center=\"%s\">\n",name,mode);
-  fprintf(xdmfFile,"          <DataItem Dimensions=\"%d\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\" >\n",np);
-  fprintf(xdmfFile,"            %s:/%s/%s\n",basename(hdf5Name),partType,name);
-  fprintf(xdmfFile,"          </DataItem>\n");
-  fprintf(xdmfFile,"        </Attribute>\n");
+  fprintf(fp,"\n");
+  fprintf(fp,"        <Attribute Name=\"%s\" AttributeType=\"Scalar\" Center=\"%s\">\n",name,mode);
+  fprintf(fp,"          <DataItem Dimensions=\"%d\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\" >\n",np);
+  fprintf(fp,"            %s:/%s/%s\n",fileName,partType,name);
+  fprintf(fp,"          </DataItem>\n");
+  fprintf(fp,"        </Attribute>\n");
 }
 
 
-void H5pio::writeXdmfAttributeFloat3D(int np, XcCString partType, XcCString name, const bool isNodeCentered)
+void H5pio::writeXdmfAttributeFloat3D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name,
+                                      const bool isNodeCentered)
 {
-  if (!xdmfFileIsOpen) return;
-
   const char *mode= isNodeCentered ? "Node" : "Cell";
 
-  fprintf(xdmfFile,"\n");
-  fprintf(xdmfFile,"        <Attribute Name=\"%s\" AttributeType=\"Vector\" Center=\"%s\">\n",name,mode);
-  fprintf(xdmfFile,"          <DataItem Dimensions=\"%d 3\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\" >\n",np);
-  fprintf(xdmfFile,"            %s:/%s/%s\n",basename(hdf5Name),partType,name);
-  fprintf(xdmfFile,"          </DataItem>\n");
-  fprintf(xdmfFile,"        </Attribute>\n");
+  fprintf(fp,"\n");
+  fprintf(fp,"        <Attribute Name=\"%s\" AttributeType=\"Vector\" Center=\"%s\">\n",name,mode);
+  fprintf(fp,"          <DataItem Dimensions=\"%d 3\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\" >\n",np);
+  fprintf(fp,"            %s:/%s/%s\n",fileName,partType,name);
+  fprintf(fp,"          </DataItem>\n");
+  fprintf(fp,"        </Attribute>\n");
 }
 
 
-void H5pio::writeXdmfGeometry3D(int np, XcCString partType, XcCString name)
+void H5pio::writeXdmfGeometry3D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name)
 {
-  if (!xdmfFileIsOpen) return;
-
-  fprintf(xdmfFile,"\n");
-  fprintf(xdmfFile,"        <Geometry GeometryType=\"XYZ\">\n");
-  fprintf(xdmfFile,"          <DataItem Dimensions=\"%d 3\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\" >\n",np);
-  fprintf(xdmfFile,"            %s:/%s/%s\n",basename(hdf5Name),partType,name);
-  fprintf(xdmfFile,"          </DataItem>\n");
-  fprintf(xdmfFile,"        </Geometry>\n");
+  fprintf(fp,"\n");
+  fprintf(fp,"        <Geometry GeometryType=\"XYZ\">\n");
+  fprintf(fp,"          <DataItem Dimensions=\"%d 3\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\" >\n",np);
+  fprintf(fp,"            %s:/%s/%s\n",fileName,partType,name);
+  fprintf(fp,"          </DataItem>\n");
+  fprintf(fp,"        </Geometry>\n");
 }
 
 
@@ -13,6 +13,9 @@
 #include <hdf5.h>
 #include <string>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 /*!
 \verbatim
@@ -40,6 +43,25 @@
  *   The difference is that the locations are treated as a type
  *   of "mesh" object in HDF5.
  *
+ * registerDerived1DField()
+ *   Registers a float field computed from other registered fields
+ *   of the same type, either with one of the built-in kernels or
+ *   with a DerivedKernel over the named inputs (float fields).
+ *
+ *     Temperature  (gamma-1)*scale*InternalEnergy;  param {gamma,scale}
+ *     Speed        |Velocities|
+ *     Radius       |Coordinates - center|;          param {cx,cy,cz}
+ *     Pressure     (gamma-1)*Density*InternalEnergy; param {gamma}
+ *
+ *   Derived fields are never read from a file. With a buffer, the
+ *   field is evaluated into it after each load (after sorting by
+ *   ID, and in the prefetch thread when prefetching) and before
+ *   each save. Without one, saveH5Frame() evaluates it one dataset
+ *   chunk at a time into a chunk-sized buffer as it writes, so no
+ *   full-size array exists; such fields have no zone maps or
+ *   statistics. Either way it is listed in the XDMF file. Kernels
+ *   are called on cache-sized blocks of rows, in parallel.
+ *
  * openFiles()
  *   Opens all files needed to save a temporal sequence. This
  *   includes hdf5 and xdmf files. This function will replace
@@ -47,6 +69,13 @@
  *   suffix was not specified, as in "./data/myFiles", the
  *   suffixes will be added to the base name.
  *
+ *   If prefetchDepth > 0, a reader thread is started that keeps
+ *   the next prefetchDepth frames decoded in a buffer pool, so
+ *   that disk I/O overlaps with the caller's processing. The
+ *   pool holds prefetchDepth copies of the registered fields,
+ *   so all fields must be registered before openFiles() and
+ *   not changed until closeFiles().
+ *
  * closeFiles()
  *   Closes the files created by openFiles().
  *
@@ -54,21 +83,268 @@
  *   A frame header is written based on the current status of the
  *   particle manager.
  *
+ * saveCheckpoint()
+ *   Writes a restart checkpoint. If fileName already holds a
+ *   checkpoint with the same particle counts and datasets, it is
+ *   opened read-write and only the dataset chunks that changed are
+ *   overwritten in place, together with the header time, so a
+ *   checkpoint costs in proportion to what changed. Otherwise (or
+ *   with forceFull) the file is written in full, keeping its free
+ *   space so the chunks later rewritten in place do not grow it.
+ *   Returns the number of rows written.
+ *
+ *   What changed is found with setDirtyTracking():
+ *     MarkedRows   the row ranges given to markDirty() since the
+ *                  last checkpoint; unmarked fields are unchanged.
+ *                  A file other than that of the last checkpoint
+ *                  is written in full.
+ *     BlockHashes  chunks whose 64-bit hash differs from the one
+ *                  stored with the checkpoint in /ChunkHashes
+ *   Unbuffered derived fields are rewritten where their inputs
+ *   changed. Zone maps, statistics and levels of detail describe
+ *   the whole frame, so with any of them the file is rewritten.
+ *
+ * setIOBudget()
+ *   Keeps the time spent in saveFrame() under the given fraction of
+ *   the wall time since the call. Each saveFrame() compares the
+ *   measured cost of earlier frames with the time left in the
+ *   budget and takes the first mode that fits:
+ *
+ *     FullFrame         as set up (tuning, levels of detail, ...)
+ *     CheapFrame        deflate level at most 1 (with shuffle)
+ *     DownsampledFrame  every stride-th particle, cheaply compressed,
+ *                       masses rescaled to keep the total; written
+ *                       to "{baseName}_DS_{frameID}.hdf5" with a
+ *                       DownsampleStride attribute in the header
+ *     SkippedFrame      nothing is written
+ *
+ *   The full series thus only holds frames with the registered
+ *   counts. Frames saved with isCheckpoint are always written in
+ *   full; the time they take, like that of autotuning, is charged
+ *   to later frames. Every decision is
+ *   appended to the log file ("{baseName}.iolog" by default). A
+ *   fraction <= 0 turns the budget off.
+ *
  * loadFrame()
  *   The header is read for each frame, and the status flags are
- *   updated to reflect the frame's state.
+ *   updated to reflect the frame's state. When prefetching, the
+ *   next decoded frame is copied from the buffer pool instead.
+ *
+ * loadFrame(frameID), loadFrameAtTime()
+ *   Random access into the series through the frame catalog; the
+ *   next loadFrame() continues from the frame that was loaded.
+ *
+ * setSortByID()
+ *   When enabled, every frame that is loaded has all registered
+ *   fields of each type permuted into ascending "ParticleIDs"
+ *   order, so frames can be compared element by element.
+ *
+ * enableZoneMap()
+ *   saveH5Frame() stores the per-chunk min/max of the named fields
+ *   (of any type) in /ZoneMaps/PartType{type}/{name}, over the
+ *   field's own (possibly tuned) chunks.
+ *
+ * loadH5FrameWhere(), loadFrameWhere()
+ *   Loads only the particles of one type whose fields satisfy all
+ *   of the given ranges (lo <= x <= hi). Chunks whose zone maps
+ *   cannot match are not read. The matching rows of all the
+ *   registered fields of that type are compacted into the
+ *   registered arrays and nParticles[type] is set to their number.
+ *   On entry, nParticles[type] is the capacity of those arrays.
+ *
+ * setStatistics()
+ *   saveH5Frame() computes the minimum, maximum, mean and sum of
+ *   each component of every field (and optionally a histogram of
+ *   nBins bins over [minimum,maximum]) from the buffers it writes.
+ *   They are stored as attributes of each dataset, and also in the
+ *   header as "PartType{type}_{name}_{statistic}". NaN and infinite
+ *   values are left out of all of them.
+ *
+ * readStatistics()
+ *   Reads the statistics of one field for every frame of the
+ *   series, from attributes only.
+ *
+ * exportFrame()
+ *   Writes the particles that satisfy the ranges (or the per-type
+ *   masks) to a smaller snapshot plus its XDMF file. With ranges,
+ *   only the types that register every range field are exported.
+ *   See H5stream::exportSubset() for files larger than memory.
+ *
+ * appendH5Block(), endH5Stream()
+ *   Streamed writing of a frame that does not fit in memory: after
+ *   openH5File(), each call appends rows [0,nRows) of the fields
+ *   registered for one type (used as block buffers) to extendible
+ *   datasets. endH5Stream() writes the header with the totals.
+ *
+ * setLevelsOfDetail()
+ *   saveH5Frame() also writes nLevels decimated copies of each
+ *   type, /PartType{type}/LOD_{n}, holding about 1/factor^n of the
+ *   particles. The particles are put in Morton order of their
+ *   Coordinates and one random particle is kept from each run of
+ *   factor^n, so every level samples space evenly. "Masses" is
+ *   rescaled so that each level keeps the total mass. saveFrame()
+ *   writes one XDMF file per level, {frame}_LOD{n}.xdmf.
+ *
+ * loadH5FrameLevel(), loadFrameLevel()
+ *   Loads level n (>= 1) of every type into the registered arrays,
+ *   sets nParticles[] to the level's counts and returns their sum.
+ *   The arrays hold the count given to registerParticles(), so
+ *   levels may be loaded in any order; set nParticles[] back to
+ *   the registered counts before a full loadFrame().
+ *
+ * saveSubfile(), buildVirtualFrame()
+ *   Writers that each hold a piece of a frame (threads with their
+ *   own H5pio objects, or separate processes) write it with
+ *   saveSubfile() to {frame}_w{writer}.hdf5, with independent file
+ *   handles and no coordination. buildVirtualFrame() then writes
+ *   {frame}.hdf5, whose /PartType{type}/{name} datasets are HDF5
+ *   virtual datasets that concatenate the pieces in writer order,
+ *   plus its XDMF file for the registered fields. Nothing is
+ *   copied: loadFrame(), ParaView and h5py read the frame as one
+ *   snapshot. Only the per-particle datasets are stitched (not
+ *   levels of detail, zone maps or statistics). The subfiles are
+ *   referenced by file name, so they must stay next to the frame.
+ *   nParticles[] is set to the totals of the frame.
+ *
+ * saveFrameSubfiles()
+ *   saveFrame() through nWriters subfiles: the rows of each type
+ *   are split into nWriters contiguous pieces. Within one process
+ *   the HDF5 library serializes the writes, so the bandwidth gain
+ *   comes from writers in separate processes. Statistics, zone
+ *   maps and levels of detail are computed from the whole arrays
+ *   and written to the virtual frame, as saveFrame() would.
+ *
+ * openLiveFile(), appendLiveFrame(), loadLatestFrame()
+ *   Single-writer/multiple-reader (SWMR) file for watching a
+ *   running simulation. The writer creates the file, with one
+ *   extendible dataset /PartType{type}/{name} per registered field,
+ *   and each appendLiveFrame() appends the current particles as
+ *   new rows, flushes them, then appends the frame's time and row
+ *   counts to /Frames/Time and /Frames/Rows. Since a frame becomes
+ *   visible only after its rows, readers never see a partial one.
+ *   Fields cannot be added after openLiveFile().
+ *
+ *   Readers open the same file while it is being written (with
+ *   createFile false) and poll loadLatestFrame(): it refreshes the
+ *   frame index and, only if a frame was added since the last
+ *   call, reads the rows of the newest frame into the registered
+ *   arrays and returns its number (from 1); otherwise it returns 0
+ *   and reads nothing. Only the newest frame is read: polling after
+ *   frame 1, again before any append, then after frames 2 and 3
+ *   returns 1, 0 and 3. The arrays hold the count given to
+ *   registerParticles() and nParticles[] is set to the frame's
+ *   counts. Unlike the frame series, a live file has no header
+ *   and no XDMF file.
+ *
+ * prepareFrame()
+ *   Builds the layout of a frame once, after the fields are
+ *   registered: the dataspace, dataset-creation property list
+ *   (chunks and filters) and memory type of each field, the
+ *   dataspaces of the header attributes, and the XDMF text of the
+ *   frame with the place of its file name left open. saveFrame()
+ *   and the other frame writers then only create the datasets and
+ *   write them. The plan is rebuilt when the particle counts, the
+ *   chunk size or the compression tuning change, and is not used
+ *   for frames the I/O budget makes cheap or downsamples.
+ *
+ * setIOProfile()
+ *   File-creation and file-access settings for every frame file
+ *   the object creates or opens:
+ *
+ *     DefaultProfile  the HDF5 defaults
+ *     Lustre          1 MiB alignment (a stripe), 1 MiB sieve
+ *                     buffer, 32 MiB metadata cache, paged file
+ *                     space with 1 MiB pages and a 16 MiB page
+ *                     buffer, latest file format
+ *     NVMe            4 KiB alignment (a page), 256 KiB sieve
+ *                     buffer, 8 MiB metadata cache, 64 KiB pages
+ *                     and a 4 MiB page buffer, latest format
+ *
+ *   The profile is given to the constructor, H5pio(profile), or
+ *   set with setIOProfile(). The default constructor uses
+ *   environmentIOProfile(), the profile named by the environment
+ *   variable H5PIO_PROFILE ("default", "lustre" or "nvme"; unset
+ *   is DefaultProfile, other names are an error), so a series can
+ *   be tuned without recompiling. getIOProfile(profile) gives the
+ *   settings of a named profile to adjust before setting them, and
+ *   getIOProfile() the object's. Every frame file the object
+ *   opens, including the catalog's headers and the subfiles, is
+ *   opened with the profile. Files written with paged space or
+ *   the latest format need HDF5 1.10 or later to read; files
+ *   written without paged space are read without the page buffer.
+ *
+ * setAutotune(), autotune()
+ *   Chooses the deflate level (0: none), byte shuffle and chunk
+ *   size of each field, per particle type. A sample of up to four
+ *   chunks from the middle of the field is written with each
+ *   candidate to an in-memory HDF5 file, and the stored size and
+ *   write time on this machine are measured. The goal picks among
+ *   the candidates:
+ *
+ *     MaxThroughput  least time to compress and store the sample
+ *                    at bytesPerSecond
+ *     MinSize        smallest sample, the fastest if within 1%
+ *     Balanced       least product of size and that time, so
+ *                    halving the size is worth twice the time
+ *
+ *   Chunk sizes are chunkRows, chunkRows/2 and chunkRows/4, so the
+ *   setChunkRows() memory bound still holds. With setAutotune(true)
+ *   the first saveFrame() reads "{baseName}.tune", tunes the fields
+ *   it does not list and rewrites it, so later frames and runs
+ *   reuse the choices. autotune() tunes the registered fields now,
+ *   and autotune(snapshot) tunes the datasets of an existing
+ *   snapshot offline and writes the .tune file of its series.
+ *   Untuned fields keep deflate 6, no shuffle and chunkRows.
+ *
+ * saveFrameImage(), loadFrameImage(), writeFrameImage()
+ *   Frames without the filesystem, for in-situ consumers in the
+ *   same process. saveFrameImage() builds the frame with the HDF5
+ *   core driver (in memory, no backing store) and returns the
+ *   file image, byte for byte the .hdf5 file that saveH5Frame()
+ *   would write. loadFrameImage() reads an image as loadH5Frame()
+ *   reads a file; the image is borrowed, not copied, and only has
+ *   to stay valid during the call. writeFrameImage() stores an
+ *   image as an .hdf5 file in one sequential write.
+ *
+ * saveRawFrame(), loadRawFrame(), setRawDataPath()
+ *   Uncompressed frames at device bandwidth. saveRawFrame() lays
+ *   out the file through HDF5 (header, groups, and each field as a
+ *   contiguous dataset allocated early, never filled, aligned to
+ *   4 KiB), takes the datasets' offsets from H5Dget_offset() and
+ *   closes it; the registered buffers are then streamed into place
+ *   with O_DIRECT writes of up to 1 MiB, eight in flight, submitted
+ *   through io_uring (or pwritev() where it is not available). The
+ *   ends of a dataset that do not fill a 4 KiB block go through the
+ *   page cache. Buffers aligned to 4 KiB are written from directly;
+ *   the others are copied block by block into aligned staging
+ *   buffers. The result is an ordinary .hdf5 file, as saveH5Frame()
+ *   would write it without compression. loadRawFrame() reads any
+ *   frame file the same way, through HDF5 for the datasets that are
+ *   compressed or chunked. With setRawDataPath(true), saveFrame()
+ *   writes the frames of the series with saveRawFrame(). The HDF5
+ *   mutex is held only while the file is laid out.
+ *
+ * buildFrameCatalog()
+ *   Lists each frame's file name, time and particle counts. The
+ *   catalog is cached as "{baseName}.catalog" next to the series,
+ *   with the modification time (ns) and size of each frame file,
+ *   and is rebuilt when any frame changed, or frames were added or
+ *   removed at the end of the series (or when forced).
  *
  *********************************************************************
 \endverbatim
  */
 class H5pio {
 public:
-  H5pio(void);
+  H5pio(void); // with environmentIOProfile()
  ~H5pio(void);
 
   static void  initH5Library(void) { H5open();  }
   static void closeH5Library(void) { H5close(); }
 
+  // serializes HDF5 calls between the caller and reader threads
+  static std::mutex h5Mutex;
+
   static const bool CENTER_BY_NODE= true;
   static const bool CENTER_BY_CELL= false;
 
@@ -86,17 +362,132 @@ public:
   void registerFloat3DField   (const bool isNodeCentered, string name, XcFloat3 *ptr=nullptr);
   void registerGeometry3DField(const bool isNodeCentered, string name, XcFloat3 *ptr=nullptr);
 
+  // *** derived fields ********************************************
+  //
+  // out[i] for i in [0,n), from in[k][i*dof_k ...] of the inputs
+  //
+  typedef void (*DerivedKernel)(const int n, const float *const in[], float *out, const float *param);
+
+  enum DERIVED_FIELDS {Temperature, Speed, Radius, Pressure};
+
+  void registerDerived1DField(const bool isNodeCentered, string name, const vector<string> &inputs,
+                              DerivedKernel kernel, const vector<float> &param=vector<float>(),
+                              float *ptr=nullptr);
+  void registerDerived1DField(const bool isNodeCentered, string name, const DERIVED_FIELDS kind,
+                              const vector<float> &param=vector<float>(), float *ptr=nullptr);
+
+  void evaluateDerivedFields(const int type); // refreshes the buffered ones
+
   int getNumberOfParticles(const int type);
+  int getItemSize(const int gid); // bytes per particle of field gid
+  int findField(const int type, XcCString name); // gid, or -1
+
+  // *** parallel kernels ********************************************
+  //
+  // selectIndices() writes the positions of the nonzero entries of
+  // mask[0:n] to index[] (in order) using a blocked prefix sum, and
+  // returns their number. index[] must hold n entries.
+  //
+  // sortPermutation() is a parallel, stable LSD radix sort: on return
+  // keys[perm[0:n]] is ascending. gatherField() applies a permutation
+  // in place, data[i]= data[perm[i]], for items of itemSize bytes.
+  //
+  static int getNumberOfThreads(void);
+  static int selectIndices(const unsigned char *mask, const int n, int *index);
+  static void sortPermutation(const unsigned *keys, const int n, int *perm);
+  static void sortPermutation(const int *keys, const int n, int *perm);
+  static void gatherField(void *data, const int itemSize, const int *perm, const int n);
+  static void gatherRows(const void *src, const int itemSize, const int *index, const int n, void *dst);
+
+  void setSortByID(const bool flag) { sortByID= flag; }
+
+  // rows per dataset chunk; bounds the memory needed to read any
+  // part of a dataset (see H5stream)
+  //
+  void setChunkRows(const int rows) { chunkRows= rows; }
 
   // *** consolidated file I/O ***************************************
   //
   // Combines HDF5/XDF5 files, with temporal support.
   //
-  void  openFiles(XcCString fileName);
+  void  openFiles(XcCString fileName, const int prefetchDepth=0);
   void closeFiles(void);
 
-  void saveFrame(const float time);
+  void saveFrame(const float time, const bool isCheckpoint=false);
   void loadFrame(void);
+  void loadFrame(const int frameID); // frameID is in [1,nFrames]
+  void loadFrameAtTime(const float time);
+
+  struct FrameInfo {
+    int frameID;
+    float time;
+    int nParticles[N_TYPES];
+    string fileName;
+  };
+
+  void buildFrameCatalog(const bool forceRebuild=false);
+  int  getNumberOfFrames(void);
+  const FrameInfo &getFrameInfo(const int frameID);
+
+  // *** prepared write plan *****************************************
+  //
+  void prepareFrame(void);
+
+  // *** I/O profiles ************************************************
+  //
+  enum IO_PROFILES {DefaultProfile, Lustre, NVMe};
+
+  explicit H5pio(const IO_PROFILES profile);
+
+  struct IOProfile {
+    hsize_t alignment;          // 0: none
+    hsize_t alignThreshold;     // objects at least this large are aligned
+     size_t sieveBytes;         // 0: default
+     size_t metadataCacheBytes; // initial size; 0: default
+    hsize_t pageBytes;          // paged file space; 0: not paged
+     size_t pageBufferBytes;    // with paged file space; 0: none
+       bool latestFormat;
+  };
+
+  static IOProfile getIOProfile(const IO_PROFILES profile);
+  static IO_PROFILES environmentIOProfile(void);
+  const IOProfile &getIOProfile(void) { return ioProfile; }
+  void setIOProfile(const IO_PROFILES profile) { setIOProfile(getIOProfile(profile)); }
+  void setIOProfile(const IOProfile &profile);
+
+  // *** incremental checkpoints ************************************
+  //
+  enum DIRTY_TRACKING {MarkedRows, BlockHashes};
+
+  void setDirtyTracking(const DIRTY_TRACKING mode) { dirtyTracking= mode; }
+  void markDirty(const int type, XcCString name, const int row0, const int nRows);
+  void markAllDirty(void);
+  long saveCheckpoint(XcCString fileName, const float time, const bool forceFull=false);
+
+  // *** I/O budget **************************************************
+  //
+  enum BUDGET_MODE {FullFrame, CheapFrame, DownsampledFrame, SkippedFrame};
+
+  void setIOBudget(const float fraction, const int stride=8, XcCString logFile="");
+  double getIOFraction(void);
+  BUDGET_MODE getBudgetMode(void) { return budgetMode; } // of the last saveFrame()
+
+  // *** compression autotuning *************************************
+  //
+  enum TUNE_GOAL {MaxThroughput, MinSize, Balanced};
+
+  struct Compression {
+    int level;     // deflate level; 0: none
+    bool shuffle;
+    int chunkRows;
+  };
+
+  void setAutotune(const bool enable, const TUNE_GOAL goal=Balanced, const double bytesPerSecond=500.0e6);
+  void autotune(void);
+  void autotune(XcCString snapshotFile);
+  bool readTuning(XcCString fileName);
+  void writeTuning(XcCString fileName);
+  Compression getCompression(const int type, XcCString name);
 
   // *** HDF5 file I/O ***********************************************
   //
@@ -105,6 +496,73 @@ public:
   void saveH5Frame(const float time);
   void loadH5Frame(void);
 
+  // *** zone maps and filtered loads ********************************
+  //
+  struct Range { string name; double lo; double hi; };
+
+  void enableZoneMap(XcCString name);
+
+   int loadH5FrameWhere(const int type, const vector<Range> &where);
+   int loadFrameWhere(const int frameID, const int type, const vector<Range> &where);
+
+  // *** subset export and streamed writing **************************
+  //
+  void exportFrame(XcCString fileName, const vector<Range> &where);
+  void exportFrame(XcCString fileName, const unsigned char *masks[N_TYPES]);
+
+  void appendH5Block(const int type, const int nRows);
+  void endH5Stream(const float time);
+
+  // *** summary statistics ******************************************
+  //
+  struct Statistics {
+    int frameID;
+    float time;
+    int dof;
+    double minimum[3];
+    double maximum[3];
+    double mean[3];
+    double sum[3];
+    vector<long long> histogram; // [dof][nBins], empty if not saved
+  };
+
+  void setStatistics(const bool flag, const int nBins=0);
+  void readStatistics(const int type, XcCString name, vector<Statistics> &series);
+
+  // *** levels of detail *******************************************
+  //
+  void setLevelsOfDetail(const int nLevels, const int factor=8);
+
+  // capacity: registeredParticles[]; sets nParticles[] to the level's counts
+  //
+   int loadH5FrameLevel(const int level);
+   int loadFrameLevel(const int frameID, const int level);
+
+  // *** subfiles stitched by virtual datasets **********************
+  //
+  void saveSubfile(const int frameID, const int writer, const float time);
+  void buildVirtualFrame(const int frameID, const int nWriters, const float time);
+  void saveFrameSubfiles(const float time, const int nWriters);
+
+  // *** SWMR live files ********************************************
+  //
+  void  openLiveFile(XcCString fileName, const bool createFile);
+  void closeLiveFile(void);
+  void appendLiveFrame(const float time);
+   int loadLatestFrame(void); // newest frame's number if new since the last call, else 0
+
+  // *** in-memory file images **************************************
+  //
+  void saveFrameImage(const float time, vector<char> &image);
+  void loadFrameImage(const void *image, const size_t size);
+  void writeFrameImage(XcCString fileName, const vector<char> &image);
+
+  // *** raw data path **********************************************
+  //
+  void setRawDataPath(const bool flag) { rawDataPath= flag; }
+  void saveRawFrame(XcCString fileName, const float time);
+  void loadRawFrame(XcCString fileName);
+
   // *** XDMF file I/O ***********************************************
   //
   void  openXdmfFile(XcCString fileName="");
@@ -116,6 +574,7 @@ public:
 //
 public: // particle data
   int nParticles[N_TYPES];
+  int registeredParticles[N_TYPES]; // rows of the registered arrays
   int theParticleType;
 
   vector<int>    dataParticleType;
@@ -127,14 +586,132 @@ public: // particle data
   vector<bool>   dataIsGeometry3D;
   vector<string> dataName;
   vector<void*>  dataPointer;
+  vector<int>    dataDerived; // index into derivedFields, or -1
 
   float frameTime;
   bool endOfFile;
+  bool sortByID;
+
+private: // derived fields
+  struct DerivedField {
+    vector<string> inputs;
+    DerivedKernel kernel;
+    vector<float> param;
+  };
+
+  vector<DerivedField> derivedFields;
+
+  void evaluateDerived(const int gid, const vector<void*> &ptrs, const long row0, const int n, float *out);
+  void evaluateDerivedFields(const int type, const vector<void*> &ptrs, const int n);
+  void writeDerivedDataset(hid_t group_id, const int gid, const int np);
+
+  static void derivedTemperature(const int n, const float *const in[], float *out, const float *param);
+  static void derivedSpeed(const int n, const float *const in[], float *out, const float *param);
+  static void derivedRadius(const int n, const float *const in[], float *out, const float *param);
+  static void derivedPressure(const int n, const float *const in[], float *out, const float *param);
+
+private: // incremental checkpoints
+  struct RowRange { long row0; long nRows; };
+
+  DIRTY_TRACKING dirtyTracking;
+  vector<vector<RowRange>> dirtyRows;                 // by gid, since the last checkpoint
+  vector<vector<unsigned long long>> checkpointHashes; // by gid, of each chunk
+  string checkpointName;                               // file the hashes describe
+
+  long writeCheckpointInPlace(const float time);
+  void findDirtyChunks(const int gid, hid_t dataset_id, const hsize_t cRows, vector<char> &dirty);
+  void readChunkHashes(const int gid, const hsize_t nChunks);
+  void writeChunkHashes(void);
+  static void hashChunks(const void *data, const int itemSize, const long np, const hsize_t cRows,
+                         vector<unsigned long long> &hash);
+
+private: // I/O budget
+       float ioBudget; // fraction of wall time; <= 0: off
+         int budgetStride;
+      string budgetLogName;
+      double budgetStart;         // wall seconds
+      double budgetSpent;         // seconds in saveFrame()
+      double budgetCost[SkippedFrame]; // estimated seconds per mode; < 0: unknown
+ BUDGET_MODE budgetMode;
+         int frameStride;         // DownsampleStride of the frame being written
+         int downsampledFrameID;  // of the "_DS" series
+        bool cheapCompression;
+
+  static double wallSeconds(void);
+  BUDGET_MODE chooseBudgetMode(const bool isCheckpoint);
+  void writeSeriesFrame(const float time);
+  void writeFrameFiles(XcCString fileName, const float time);
+  void saveLevelsXdmf(XcCString fileName, const float time);
+  void writeFrameSummaries(XcCString fileName);
+  void writeDownsampledFrame(const float time);
+  void logBudget(const float time, const bool isCheckpoint, const double estimate, const double cost);
+
+private: // prepared write plan
+  struct WritePlan {
+    bool isValid;
+    int nParticles[N_TYPES];
+    int chunkRows;
+    vector<hid_t> dataspace; // by gid; -1: not planned
+    vector<hid_t> dcpl;
+    vector<hid_t> memType;
+    hid_t scalarSpace;       // header attributes
+    hid_t typesSpace;
+    vector<string> xdmfText; // the fields' XDMF, split where the file name goes
+  };
+
+  WritePlan writePlan;
+       bool writePlanIsWanted;
+
+  bool usesWritePlan(const bool rebuild);
+  void buildWritePlan(void);
+  void releaseWritePlan(void);
+  void writeXdmfFields(FILE *fp, XcCString fileName, const int level);
+
+private: // raw data path
+  struct RawExtent {
+    char *data;    // registered buffer, or a derived field's values
+    size_t bytes;
+    off_t offset;  // of the dataset in the file
+  };
+
+  bool rawDataPath;
+
+  void layoutRawFrame(XcCString fileName, const float time, vector<RawExtent> &extents,
+                      vector< vector<float> > &derived);
+  void transferRaw(XcCString fileName, const vector<RawExtent> &extents, const bool isWrite);
+
+private: // compression autotuning
+  struct TunedField {
+    string key; // "PartType{t}/{name}"
+    Compression compression;
+    float ratio;
+    float bytesPerSecond;
+  };
+
+  vector<TunedField> tuning;
+              bool autotuneOnSave;
+         TUNE_GOAL tuneGoal;
+            double tuneBandwidth;
+
+  void autotuneFrame(const bool retune);
+  TunedField tuneField(XcCString key, hid_t memType, const int dof, const void *sample, const hsize_t rows);
+  void setTuning(const TunedField &field);
+  void setCompression(hid_t plist_id, hid_t group_id, XcCString name, const hsize_t rows, const hsize_t dof);
+  void setCompression(hid_t plist_id, const int type, XcCString name, const hsize_t rows, const hsize_t dof);
 
 private: // frame data
     int multiTemporalFrameID;
    char theBaseName[XCUDA_PATH_LENGTH];
 
+  vector<FrameInfo> frameCatalog; // sorted by frameID
+               bool frameCatalogIsValid;
+
+  void loadFrameFile(const int frameID);
+  void frameFileName(const int frameID, XcString fileName);
+  void subfileName(const int frameID, const int writer, XcString fileName);
+  bool readFrameCatalog(XcCString catalogName);
+  void writeFrameCatalog(XcCString catalogName);
+
 private: // utilities
   bool isDot(const char c);
   bool isDelimiter(const char c);
@@ -147,13 +724,82 @@ private: // HDF5 support
    char hdf5Name[XCUDA_PATH_LENGTH];
    bool fileIsOpen;
   hid_t file_id;
+    int chunkRows;
+
+  void openH5File(XcCString fileName, const bool createFile, hid_t fcpl_id, hid_t fapl_id);
+
+  IOProfile ioProfile;
+      hid_t fcplProfile; // property lists of ioProfile
+      hid_t faplProfile;
+      hid_t faplUnpaged; // faplProfile without the page buffer
+  hid_t openProfiled(XcCString fileName, const unsigned flags, hid_t fapl_id);
 
   void writeDataset(hid_t group_id, hid_t type, int nItems, int dof, XcCString name, void* data);
   void  readDataset(hid_t group_id, hid_t type, XcCString name, void* data);
 
+  void readH5Frame(hid_t fid, const vector<void*> &ptrs, float *time);
+  void sortFieldsByID(const vector<void*> &ptrs);
+
+  void readRows(hid_t dataset_id, hid_t memType, hsize_t row0, hsize_t nRows, void* data);
+  hid_t createExtendibleDataset(hid_t group_id, hid_t type, const hsize_t dof, XcCString name);
+  void appendRows(hid_t dataset_id, hid_t memType, const hsize_t row0, const hsize_t nRows,
+                  const hsize_t dof, const void* data);
+  void writeH5Header(void);
+
+  long streamRows[N_TYPES]; // rows appended by appendH5Block()
+
+  hid_t memTypeOf(const int gid);
+  void registerFieldLike(H5pio &target, const int gid, void *ptr);
+  void selectRanges(const int type, const vector<Range> &where, unsigned char *mask);
+
+  bool saveStatistics;
+   int statisticsBins;
+  void writeStatistics(const int type, const int gid, const int np, hid_t group_id);
+
+   int lodLevels;
+   int lodFactor;
+  vector<int> lodCount; // [level][type] rows written by writeLevelsOfDetail()
+  void writeLevelsOfDetail(const int type, const int np, hid_t group_id);
+
+  vector<string> zoneMapNames;
+  bool isZoneMapField(const int gid);
+  void writeZoneMap(const int type, const int gid, const int np);
+
   void writeAttribute(hid_t group_id, hid_t type, XcCString name, void* data, int nDims=1);
   void  readAttribute(hid_t group_id, hid_t type, XcCString name, void* data);
 
+private: // SWMR live files
+   bool liveIsOpen;
+   bool liveIsWriter;
+  hid_t liveFile_id;
+  hid_t liveTime_id;           // /Frames/Time [nFrames]
+  hid_t liveRows_id;           // /Frames/Rows [nFrames][N_TYPES], rows of each type after the frame
+  vector<hid_t> liveDataset;   // per gid, or -1
+   long liveRows[N_TYPES];     // rows written (writer)
+    int liveFrames;            // frames appended (writer) or loaded (reader)
+
+private: // prefetch support
+  struct PrefetchSlot {
+    int frameID;
+    float time;
+    bool isEnd;
+    vector< vector<char> > buffers; // one per registered field
+  };
+
+   int prefetchDepth;
+   int prefetchReady;      // # of decoded slots waiting for loadFrame()
+  long prefetchConsumed;   // # of slots handed to loadFrame()
+  bool prefetchStop;
+  vector<PrefetchSlot> prefetchPool;
+
+  std::thread prefetchThread;
+  std::mutex prefetchMutex;
+  std::condition_variable prefetchSignal;
+
+  void startPrefetch(const int firstFrameID);
+  void  stopPrefetch(void);
+  void prefetchReader(const int firstFrameID);
+
 private: // XDMF support
   char  xdmfFileName[XCUDA_PATH_LENGTH];
   bool  xdmfFileIsOpen;
@@ -161,12 +807,17 @@ private: // XDMF support
   FILE *xdmfFile;
 
   bool  writeXdmfTerminator;
+   int  xdmfLevel; // level of detail described by saveXdmfFrame()
 
-  void writeXdmfAttributeBoolean1D(int np, XcCString partType, XcCString name, const bool isNodeCentered);
-  void writeXdmfAttributeInteger1D(int np, XcCString partType, XcCString name, const bool isNodeCentered);
-  void writeXdmfAttributeFloat1D(int np, XcCString partType, XcCString name, const bool isNodeCentered);
-  void writeXdmfAttributeFloat3D(int np, XcCString partType, XcCString name, const bool isNodeCentered);
-  void writeXdmfGeometry3D(int np, XcCString partType, XcCString name);
+  void writeXdmfAttributeBoolean1D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name,
+                                   const bool isNodeCentered);
+  void writeXdmfAttributeInteger1D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name,
+                                   const bool isNodeCentered);
+  void writeXdmfAttributeFloat1D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name,
+                                 const bool isNodeCentered);
+  void writeXdmfAttributeFloat3D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name,
+                                 const bool isNodeCentered);
+  void writeXdmfGeometry3D(FILE *fp, XcCString fileName, int np, XcCString partType, XcCString name);
 
 private: // support for switching between XDMF files
   struct {FILE *fp; bool isOpen; int frameID;} saveXdmfState;
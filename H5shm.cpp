@@ -0,0 +1,314 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#include "H5shm.h"
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <errno.h>
+#include <chrono>
+#include <algorithm>
+
+static const unsigned RING_MAGIC= 0x48357368; // "H5sh"
+static const size_t RING_ALIGN= 4096;
+static const size_t FIELD_ALIGN= 64;
+static const size_t COPY_BLOCK= size_t(1) << 20; // bytes per thread in publish()
+static const int LIVENESS_POLLS= 1024;           // waits between checks that the consumer lives
+
+static inline size_t alignUp(const size_t n, const size_t a) { return (n + a-1)/a*a; }
+
+
+H5shm::H5shm(void)
+{
+  shmName[0]= '\0';
+  isOwner= false;
+  mapBytes= 0;
+  ring= nullptr;
+
+  next= 0;
+  held= ~0ULL;
+  nDropped= 0;
+}
+
+H5shm::~H5shm(void)
+{
+  close();
+}
+
+
+H5shm::SlotHeader *H5shm::slot(const unsigned long long s)
+{
+  char *base= (char*)ring + alignUp(sizeof(RingHeader),RING_ALIGN);
+  return (SlotHeader*)(base + (s % ring->nSlots)*ring->slotBytes);
+}
+
+char *H5shm::slotData(const unsigned long long s, const int f)
+{
+  return (char*)slot(s) + ring->fieldOffset[f];
+}
+
+
+void H5shm::create(XcCString name, H5pio &frame, const int nSlots, const POLICY policy)
+{
+  XcHandleError(nSlots<1,XCUDA_ERROR,"H5shm::create","nSlots < 1");
+  close();
+
+  // schema, and the place of each field in a slot
+  //
+  RingHeader schema;
+  schema.nFields= 0;
+  size_t bytes= alignUp(sizeof(SlotHeader),FIELD_ALIGN);
+  fieldGid.clear();
+
+  for (int gid=0; gid<frame.dataName.size(); gid++) {
+    if (frame.dataPointer[gid] == nullptr) continue; // unbuffered derived field
+
+    XcHandleError(schema.nFields==MAX_FIELDS,XCUDA_ERROR,"H5shm::create","Too many fields");
+    XcHandleError(frame.dataName[gid].size()>=NAME_LENGTH,XCUDA_ERROR,"H5shm::create",
+      "Field name is too long");
+
+    FieldSchema &f= schema.field[schema.nFields];
+    memset(f.name,0,NAME_LENGTH);
+    strcpy(f.name,frame.dataName[gid].c_str());
+    f.type= frame.dataParticleType[gid];
+    f.kind= frame.dataIsBoolean1D[gid] ? Boolean1D : frame.dataIsInteger1D[gid] ? Integer1D :
+            frame.dataIsFloat1D[gid] ? Float1D : frame.dataIsFloat3D[gid] ? Float3D : Geometry3D;
+    f.itemSize= frame.getItemSize(gid);
+    f.isNodeCentered= frame.dataIsNodeCentered[gid];
+
+    schema.fieldOffset[schema.nFields]= bytes;
+    bytes= alignUp(bytes + size_t(frame.nParticles[f.type])*f.itemSize,FIELD_ALIGN);
+
+    fieldGid.push_back(gid);
+    schema.nFields++;
+  } // endfor(gid)
+
+  const size_t slotBytes= alignUp(bytes,RING_ALIGN);
+  mapBytes= alignUp(sizeof(RingHeader),RING_ALIGN) + size_t(nSlots)*slotBytes;
+
+  snprintf(shmName,XCUDA_PATH_LENGTH,"%s%s",(name[0] == '/') ? "" : "/",name);
+  shm_unlink(shmName);
+  int fd= shm_open(shmName,O_CREAT|O_EXCL|O_RDWR,0600);
+  XcHandleError(fd<0,XCUDA_ERROR,"H5shm::create","Unable to create the shared-memory object");
+  XcHandleError(ftruncate(fd,mapBytes)!=0,XCUDA_ERROR,"H5shm::create","Unable to size the shared memory");
+
+  void *map= mmap(nullptr,mapBytes,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  ::close(fd);
+  XcHandleError(map==MAP_FAILED,XCUDA_ERROR,"H5shm::create","Unable to map the shared memory");
+
+  ring= new(map) RingHeader;
+  ring->nSlots= nSlots;
+  ring->policy= policy;
+  ring->nFields= schema.nFields;
+  ring->slotBytes= slotBytes;
+  for (int f=0; f<schema.nFields; f++) {
+    ring->fieldOffset[f]= schema.fieldOffset[f];
+    ring->field[f]= schema.field[f];
+  } // endfor(f)
+  for (int t=0; t<H5pio::N_TYPES; t++) ring->capacity[t]= frame.nParticles[t];
+
+  ring->published.store(0);
+  ring->released.store(0);
+  ring->attached.store(0);
+
+  for (int s=0; s<nSlots; s++) new(slot(s)) SlotHeader{{0ULL},0.0f,{0,0,0,0,0,0}};
+
+  std::atomic_thread_fence(std::memory_order_release);
+  ring->magic= RING_MAGIC;
+
+  isOwner= true;
+  next= 0;
+}
+
+
+void H5shm::publish(H5pio &frame)
+{
+  XcHandleError(ring==nullptr||!isOwner,XCUDA_ERROR,"H5shm::publish","Ring was not created");
+
+  for (int t=0; t<H5pio::N_TYPES; t++) {
+    XcHandleError(frame.nParticles[t]>ring->capacity[t],XCUDA_ERROR,"H5shm::publish",
+      "More particles than the ring was created for");
+  } // endfor(t)
+
+  // backpressure: the slot of frame next-nSlots must have been released;
+  // a consumer that died without detaching is detached here, so the
+  // producer then overwrites its frames as with DropOldest
+  //
+  if (ring->policy == Block) {
+    for (int polls=1; ; polls++) {
+      int consumer= ring->attached.load(std::memory_order_acquire);
+      if (consumer == 0 ||
+          next - ring->released.load(std::memory_order_acquire) < (unsigned long long)ring->nSlots) break;
+
+      if (polls % LIVENESS_POLLS == 0 && kill(pid_t(consumer),0) != 0 && errno == ESRCH) {
+        ring->attached.compare_exchange_strong(consumer,0);
+        break;
+      } // endif
+      usleep(50);
+    } // endfor(polls)
+  } // endif
+
+  SlotHeader *s= slot(next);
+  s->sequence.store(2*next+1,std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  s->time= frame.frameTime;
+  for (int t=0; t<H5pio::N_TYPES; t++) s->nParticles[t]= frame.nParticles[t];
+
+  for (int f=0; f<ring->nFields; f++) {
+    const FieldSchema &field= ring->field[f];
+    const size_t nBytes= size_t(frame.nParticles[field.type])*field.itemSize;
+    const char *src= (const char*)frame.dataPointer[fieldGid[f]];
+    char *dst= slotData(next,f);
+
+    const long nBlocks= long((nBytes + COPY_BLOCK-1)/COPY_BLOCK);
+    #pragma omp parallel for if(nBlocks > 1)
+    for (long b=0; b<nBlocks; b++) {
+      const size_t offset= size_t(b)*COPY_BLOCK;
+      memcpy(dst+offset,src+offset,std::min(COPY_BLOCK,nBytes-offset));
+    } // endfor(b)
+  } // endfor(f)
+
+  s->sequence.store(2*next+2,std::memory_order_release);
+  next++;
+  ring->published.store(next,std::memory_order_release);
+}
+
+
+void H5shm::attach(XcCString name)
+{
+  close();
+
+  snprintf(shmName,XCUDA_PATH_LENGTH,"%s%s",(name[0] == '/') ? "" : "/",name);
+  int fd= shm_open(shmName,O_RDWR,0600);
+  XcHandleError(fd<0,XCUDA_ERROR,"H5shm::attach","Shared-memory object not found");
+
+  struct stat st;
+  fstat(fd,&st);
+  mapBytes= size_t(st.st_size);
+
+  void *map= mmap(nullptr,mapBytes,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  ::close(fd);
+  XcHandleError(map==MAP_FAILED,XCUDA_ERROR,"H5shm::attach","Unable to map the shared memory");
+
+  ring= (RingHeader*)map;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  XcHandleError(mapBytes<sizeof(RingHeader)||ring->magic!=RING_MAGIC,XCUDA_ERROR,"H5shm::attach",
+    "Not an H5shm ring");
+
+  isOwner= false;
+  held= ~0ULL;
+  nDropped= 0;
+
+  // start with the oldest frame that will not be overwritten
+  //
+  next= ring->released.load(std::memory_order_acquire);
+  ring->attached.store(int(getpid()),std::memory_order_release);
+}
+
+
+long H5shm::acquire(H5pio &frame, const int timeoutMs)
+{
+  XcHandleError(ring==nullptr||isOwner,XCUDA_ERROR,"H5shm::acquire","Ring is not attached");
+  XcHandleError(held!=~0ULL,XCUDA_ERROR,"H5shm::acquire","Release the previous frame first");
+
+  const unsigned long long nSlots= ring->nSlots;
+  const auto start= std::chrono::steady_clock::now();
+
+  for (;;) {
+    const unsigned long long published= ring->published.load(std::memory_order_acquire);
+
+    if (next < published) {
+      // the producer may be writing frame published, in the slot of
+      // published-nSlots; with Block that happens only to frames
+      // published before the consumer attached
+      //
+      const unsigned long long lag= (ring->policy == DropOldest) ? nSlots : nSlots+1;
+      if (published - next >= lag) {
+        const unsigned long long oldest= published - nSlots + 1;
+        nDropped += long(oldest - next);
+        next= oldest;
+      } // endif
+
+      SlotHeader *s= slot(next);
+      if (s->sequence.load(std::memory_order_acquire) == 2*next+2) break;
+
+      nDropped++; // overwritten meanwhile
+      next++;
+      continue;
+    } // endif
+
+    if (timeoutMs >= 0) {
+      const auto waited= std::chrono::steady_clock::now() - start;
+      if (std::chrono::duration_cast<std::chrono::milliseconds>(waited).count() >= timeoutMs) return 0;
+    } // endif
+    usleep(50);
+  } // endfor
+
+  // register the slot's fields (zero copy)
+  //
+  SlotHeader *s= slot(next);
+  frame.resetFields();
+
+  for (int t=0; t<H5pio::N_TYPES; t++) {
+    if (s->nParticles[t] == 0) continue;
+    frame.registerParticles(s->nParticles[t],t);
+
+    for (int f=0; f<ring->nFields; f++) {
+      const FieldSchema &field= ring->field[f];
+      if (field.type != t) continue;
+
+      void *ptr= slotData(next,f);
+      switch (field.kind) {
+        case Boolean1D:  frame.registerBoolean1DField(field.isNodeCentered,field.name,(bool*)ptr); break;
+        case Integer1D:  frame.registerInteger1DField(field.isNodeCentered,field.name,(int*)ptr); break;
+        case Float1D:    frame.registerFloat1DField(field.isNodeCentered,field.name,(float*)ptr); break;
+        case Float3D:    frame.registerFloat3DField(field.isNodeCentered,field.name,(XcFloat3*)ptr); break;
+        case Geometry3D: frame.registerGeometry3DField(field.isNodeCentered,field.name,(XcFloat3*)ptr); break;
+      } // endswitch
+    } // endfor(f)
+  } // endfor(t)
+
+  frame.frameTime= s->time;
+  frame.endOfFile= false;
+
+  held= next;
+  next++;
+  return long(held+1);
+}
+
+
+bool H5shm::release(void)
+{
+  if (ring == nullptr || held == ~0ULL) return false;
+
+  const bool isIntact= (slot(held)->sequence.load(std::memory_order_acquire) == 2*held+2);
+
+  ring->released.store(held+1,std::memory_order_release);
+  held= ~0ULL;
+
+  return isIntact;
+}
+
+
+void H5shm::close(void)
+{
+  if (ring == nullptr) return;
+
+  if (!isOwner) {
+    if (held != ~0ULL) release();
+    ring->attached.store(0,std::memory_order_release);
+  } // endif
+
+  munmap(ring,mapBytes);
+  ring= nullptr;
+
+  if (isOwner) shm_unlink(shmName);
+  isOwner= false;
+}
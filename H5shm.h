@@ -0,0 +1,130 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#ifndef GIZMO_HEADER_H5shm
+#define GIZMO_HEADER_H5shm
+
+#include "H5pio.h"
+#include <atomic>
+
+/*!
+\verbatim
+ *********************************************************************
+ *
+ * Shared-memory ring buffer of frames, from a simulation to a
+ * consumer process on the same node
+ *
+ * create()
+ *   Producer side: creates the POSIX shared-memory object /{name}
+ *   with nSlots frame slots, and records the schema of the fields
+ *   registered with the frame (type, name, kind, centering).
+ *   Each slot holds as many particles of each type as the frame
+ *   has now (its capacity). Unbuffered derived fields are left
+ *   out; buffered ones are published as Float1D fields.
+ *
+ * publish()
+ *   Copies the header (nParticles, frameTime) and the registered
+ *   fields into the next slot, then advances the publish counter.
+ *   When every slot holds a frame the consumer has not released:
+ *     Block:      waits for the consumer (backpressure), as long
+ *                 as one is attached; a consumer process that
+ *                 exited without close() is found (its pid is
+ *                 polled every 1024 waits) and detached;
+ *     DropOldest: overwrites the oldest frame.
+ *
+ * attach()
+ *   Consumer side: maps the ring. One consumer at a time.
+ *
+ * acquire()
+ *   Waits up to timeoutMs (forever if < 0) for the next frame and
+ *   registers its fields with the given H5pio, pointing into the
+ *   slot (zero copy): the frame can be used as if loaded, until
+ *   release(). Returns the frame's sequence number (from 1), or 0
+ *   on timeout. With DropOldest, frames overwritten before they
+ *   were acquired are skipped and counted by getNumberOfDropped().
+ *
+ * release()
+ *   Returns the slot to the producer. Returns false if, with
+ *   DropOldest, the producer overwrote the frame while it was held
+ *   (its data must then be discarded).
+ *
+ *   The counters are lock-free: each slot carries a sequence word
+ *   that is odd while it is written, and the published/released
+ *   counters are atomics in the shared segment.
+ *
+ *********************************************************************
+\endverbatim
+ */
+class H5shm {
+public:
+  H5shm(void);
+ ~H5shm(void);
+
+  enum POLICY {Block, DropOldest};
+
+  void create(XcCString name, H5pio &frame, const int nSlots, const POLICY policy=Block);
+  void publish(H5pio &frame);
+
+  void attach(XcCString name);
+  long acquire(H5pio &frame, const int timeoutMs=-1);
+  bool release(void);
+
+  void close(void);
+
+  long getNumberOfDropped(void) { return nDropped; }
+
+private:
+  static const int MAX_FIELDS= 64;
+  static const int NAME_LENGTH= 64;
+
+  enum KIND {Boolean1D, Integer1D, Float1D, Float3D, Geometry3D};
+
+  struct FieldSchema {
+    char name[NAME_LENGTH];
+    int type;
+    int kind;
+    int itemSize;
+    int isNodeCentered;
+  };
+
+  struct RingHeader {
+    unsigned magic;
+    int nSlots;
+    int policy;
+    int nFields;
+    size_t slotBytes;
+    size_t fieldOffset[MAX_FIELDS]; // within a slot
+    int capacity[H5pio::N_TYPES];
+    FieldSchema field[MAX_FIELDS];
+
+    alignas(64) std::atomic<unsigned long long> published; // frames written
+    alignas(64) std::atomic<unsigned long long> released;  // frames the consumer is done with
+    alignas(64) std::atomic<int> attached;                  // pid of the consumer; 0: none
+  };
+
+  struct SlotHeader {
+    std::atomic<unsigned long long> sequence; // 2s+1 while frame s is written, 2s+2 after
+    float time;
+    int nParticles[H5pio::N_TYPES];
+  };
+
+  char shmName[XCUDA_PATH_LENGTH];
+  bool isOwner;
+  size_t mapBytes;
+  RingHeader *ring;
+
+  vector<int> fieldGid;     // producer: gid of each schema field
+  unsigned long long next;  // producer: next frame; consumer: next frame to acquire
+  unsigned long long held;  // consumer: frame being held, or ~0
+  long nDropped;
+
+  SlotHeader *slot(const unsigned long long s);
+  char *slotData(const unsigned long long s, const int f);
+};
+
+// GIZMO_HEADER_H5shm
+#endif
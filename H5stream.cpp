@@ -0,0 +1,385 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#include "H5stream.h"
+#include <algorithm>
+
+H5stream::H5stream(void)
+{
+  file_id= 0;
+  group_id= 0;
+  streamIsOpen= false;
+
+  memoryBudget= size_t(256) << 20;
+  rowsPerBlock= 0;
+
+  nRows= 0;
+  blockStart= 0;
+  blockSize= 0;
+  nextStart= 0;
+  front= 0;
+}
+
+H5stream::~H5stream(void)
+{
+  close();
+}
+
+
+void H5stream::open(XcCString fileName, const int type)
+{
+  close();
+
+  char partType[16];
+  sprintf(partType,"PartType%d",type);
+
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  file_id= H5Fopen(fileName,H5F_ACC_RDONLY,H5P_DEFAULT);
+  XcHandleError(bool(file_id<0),XCUDA_ERROR,"H5stream::open",
+    "Unable to open an HDF5 file (check name and/or path)");
+
+  group_id= H5Gopen(file_id,partType,H5P_DEFAULT);
+  XcHandleError(bool(group_id<0),XCUDA_ERROR,"H5stream::open",
+    "Particle type not found in file");
+
+  streamIsOpen= true;
+  nRows= 0;
+  blockStart= 0;
+  blockSize= 0;
+  nextStart= 0;
+  rowsPerBlock= 0;
+}
+
+
+void H5stream::close(void)
+{
+  if (!streamIsOpen) return;
+
+  if (pending.valid()) pending.wait();
+
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  for (int k=0; k<fields.size(); k++) H5Dclose(fields[k].dataset_id);
+  vector<StreamField>().swap(fields);
+
+  H5Gclose(group_id);
+  H5Fclose(file_id);
+  streamIsOpen= false;
+}
+
+
+void H5stream::addField(XcCString name)
+{
+  XcHandleError(!streamIsOpen,XCUDA_ERROR,"H5stream::addField","Stream is not open");
+  XcHandleError(rowsPerBlock>0,XCUDA_ERROR,"H5stream::addField","Fields must be added before next()");
+
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  StreamField field;
+  field.name= string(name);
+  field.dataset_id= H5Dopen(group_id,name,H5P_DEFAULT);
+  XcHandleError(bool(field.dataset_id<0),XCUDA_ERROR,"H5stream::addField",
+    "Field not found in file");
+
+  hsize_t dims[2]= {0,1};
+  hid_t dataspace_id= H5Dget_space(field.dataset_id);
+  field.rank= H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+  H5Sclose(dataspace_id);
+
+  XcHandleError(field.rank<1||field.rank>2,XCUDA_ERROR,"H5stream::addField",
+    "Only datasets of rank 1 or 2 can be streamed");
+  field.dof= int(dims[1]);
+
+  hid_t type_id= H5Dget_type(field.dataset_id);
+  if (H5Tget_class(type_id) == H5T_FLOAT) {
+    field.memType= H5T_NATIVE_FLOAT;
+    field.itemSize= field.dof*sizeof(float);
+  } else if (H5Tget_size(type_id) == 1) {
+    field.memType= H5T_NATIVE_HBOOL;
+    field.itemSize= field.dof*sizeof(bool);
+  } else {
+    field.memType= H5T_NATIVE_INT;
+    field.itemSize= field.dof*sizeof(int);
+  }
+  H5Tclose(type_id);
+
+  hid_t plist_id= H5Dget_create_plist(field.dataset_id);
+  field.chunkRows= 0;
+  if (H5Pget_layout(plist_id) == H5D_CHUNKED) {
+    hsize_t cdims[2]= {0,1};
+    H5Pget_chunk(plist_id,2,cdims);
+    field.chunkRows= cdims[0];
+  }
+  H5Pclose(plist_id);
+
+  if (fields.size() == 0) nRows= long(dims[0]);
+  XcHandleError(bool(long(dims[0]) != nRows),XCUDA_ERROR,"H5stream::addField",
+    "Fields of a particle type must have the same number of rows");
+
+  fields.push_back(field);
+}
+
+
+// A block is a whole number of the largest chunk, and the two
+// buffers fit the memory budget unless a single chunk does not.
+//
+int H5stream::getRowsPerBlock(void)
+{
+  if (rowsPerBlock > 0) return rowsPerBlock;
+
+  size_t bytesPerRow= 0;
+  hsize_t align= 1;
+  for (int k=0; k<fields.size(); k++) {
+    bytesPerRow += fields[k].itemSize;
+    if (fields[k].chunkRows > align) align= fields[k].chunkRows;
+  } // endfor(k)
+
+  long maxRows= long(memoryBudget/(2*(bytesPerRow>0 ? bytesPerRow : 1)));
+  long rows= (maxRows/long(align))*long(align);
+  if (rows < long(align)) rows= long(align);
+  if (rows > nRows) rows= nRows;
+  if (rows > 0x40000000) rows= 0x40000000;
+
+  rowsPerBlock= (rows > 0) ? int(rows) : 1;
+  return rowsPerBlock;
+}
+
+
+void H5stream::allocateBuffers(void)
+{
+  const size_t rows= getRowsPerBlock();
+
+  for (int k=0; k<fields.size(); k++) {
+    fields[k].buffer[0].resize(rows*fields[k].itemSize);
+    fields[k].buffer[1].resize(rows*fields[k].itemSize);
+  } // endfor(k)
+}
+
+
+bool H5stream::next(void)
+{
+  if (!streamIsOpen || fields.size() == 0) return false;
+
+  if (fields[0].buffer[0].size() == 0) { // first call
+    allocateBuffers();
+    const int rows= (nRows < rowsPerBlock) ? int(nRows) : rowsPerBlock;
+    if (rows > 0) {
+      pending= std::async(std::launch::async,&H5stream::readBlock,this,0L,rows,1-front);
+    }
+  } // endif
+
+  if (!pending.valid()) return false; // end of stream
+  pending.get();
+
+  // the block read in the background becomes the current block
+  //
+  front= 1-front;
+  blockStart= nextStart;
+  blockSize= (nRows-blockStart < rowsPerBlock) ? int(nRows-blockStart) : rowsPerBlock;
+  nextStart= blockStart + blockSize;
+
+  if (nextStart < nRows) {
+    const int rows= (nRows-nextStart < rowsPerBlock) ? int(nRows-nextStart) : rowsPerBlock;
+    pending= std::async(std::launch::async,&H5stream::readBlock,this,nextStart,rows,1-front);
+  } // endif
+
+  return true;
+}
+
+
+void H5stream::readBlock(const long start, const int rows, const int buffer)
+{
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  for (int k=0; k<fields.size(); k++) {
+    StreamField &field= fields[k];
+
+    hsize_t offset[2]= {hsize_t(start),0};
+    hsize_t count[2]= {hsize_t(rows),hsize_t(field.dof)};
+
+    hid_t filespace_id= H5Dget_space(field.dataset_id);
+    H5Sselect_hyperslab(filespace_id,H5S_SELECT_SET,offset,nullptr,count,nullptr);
+    hid_t memspace_id= H5Screate_simple(field.rank,count,nullptr);
+    {
+      H5Dread(field.dataset_id,field.memType,memspace_id,filespace_id,H5P_DEFAULT,
+              field.buffer[buffer].data());
+    }
+    H5Sclose(memspace_id);
+    H5Sclose(filespace_id);
+  } // endfor(k)
+}
+
+
+void *H5stream::getField(XcCString name)
+{
+  for (int k=0; k<fields.size(); k++) {
+    if (fields[k].name == name) return fields[k].buffer[front].data();
+  } // endfor(k)
+
+  XcHandleError(true,XCUDA_ERROR,"H5stream::getField","Field was not added to the stream");
+  return nullptr;
+}
+
+
+// ***** subset export *****
+//
+static herr_t listDataset(hid_t group_id, const char *name, const H5L_info_t *info, void *data)
+{
+  H5O_info_t oinfo;
+  H5Oget_info_by_name(group_id,name,&oinfo,H5P_DEFAULT);
+  if (oinfo.type == H5O_TYPE_DATASET) ((vector<string>*)data)->push_back(string(name));
+  return 0;
+}
+
+
+void H5stream::exportSubset(XcCString inFile, XcCString outFile,
+                            const vector<H5pio::Range> &where, const size_t memoryBudget)
+{
+  // datasets per type, and the frame time
+  //
+  vector<string> names[H5pio::N_TYPES];
+  float time= 0.0f;
+  {
+    std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+    hid_t file_id= H5Fopen(inFile,H5F_ACC_RDONLY,H5P_DEFAULT);
+    XcHandleError(bool(file_id<0),XCUDA_ERROR,"H5stream::exportSubset",
+      "Unable to open an HDF5 file (check name and/or path)");
+
+    hid_t header_id= H5Gopen(file_id,"Header",H5P_DEFAULT);
+    hid_t attribute_id= H5Aopen(header_id,"Time",H5P_DEFAULT);
+    H5Aread(attribute_id,H5T_NATIVE_FLOAT,&time);
+    H5Aclose(attribute_id);
+    H5Gclose(header_id);
+
+    for (int type=0; type<H5pio::N_TYPES; type++) {
+      char partType[16];
+      sprintf(partType,"PartType%d",type);
+      if (!H5Lexists(file_id,partType,H5P_DEFAULT)) continue;
+
+      hid_t group_id= H5Gopen(file_id,partType,H5P_DEFAULT);
+      H5Literate(group_id,H5_INDEX_NAME,H5_ITER_INC,nullptr,listDataset,&names[type]);
+      H5Gclose(group_id);
+
+      for (int p=0; p<where.size(); p++) {
+        if (std::find(names[type].begin(),names[type].end(),where[p].name) == names[type].end()) {
+          names[type].clear();
+          break;
+        }
+      } // endfor(p)
+    } // endfor(type)
+
+    H5Fclose(file_id);
+  }
+
+  // stream each type through the predicate into the output file
+  //
+  H5pio out;
+  vector< vector<char> > blocks;
+  vector<H5stream*> streams(H5pio::N_TYPES,nullptr);
+
+  for (int type=0; type<H5pio::N_TYPES; type++) {
+    if (names[type].size() == 0) continue;
+
+    H5stream *in= new H5stream;
+    in->setMemoryBudget(memoryBudget/2); // the other half holds the compacted rows
+    in->open(inFile,type);
+    for (int k=0; k<names[type].size(); k++) in->addField(names[type][k].c_str());
+    streams[type]= in;
+
+    const int rows= in->getRowsPerBlock();
+    out.registerParticles(rows,type);
+
+    for (int k=0; k<in->fields.size(); k++) {
+      const StreamField &field= in->fields[k];
+      blocks.push_back(vector<char>(size_t(rows)*field.itemSize));
+      void *ptr= blocks.back().data();
+
+      if (field.memType == H5T_NATIVE_HBOOL) {
+        out.registerBoolean1DField(H5pio::CENTER_BY_NODE,field.name,(bool*)ptr);
+      } else if (field.memType == H5T_NATIVE_INT) {
+        out.registerInteger1DField(H5pio::CENTER_BY_NODE,field.name,(int*)ptr);
+      } else if (field.dof == 3 && field.name == "Coordinates") {
+        out.registerGeometry3DField(H5pio::CENTER_BY_NODE,field.name,(XcFloat3*)ptr);
+      } else if (field.dof == 3) {
+        out.registerFloat3DField(H5pio::CENTER_BY_NODE,field.name,(XcFloat3*)ptr);
+      } else {
+        out.registerFloat1DField(H5pio::CENTER_BY_NODE,field.name,(float*)ptr);
+      }
+    } // endfor(k)
+  } // endfor(type)
+
+  {
+    std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+    out.openH5File(outFile,true);
+  }
+
+  vector<unsigned char> mask;
+  vector<int> index;
+
+  for (int type=0; type<H5pio::N_TYPES; type++) {
+    H5stream *in= streams[type];
+    if (in == nullptr) continue;
+
+    mask.resize(in->getRowsPerBlock());
+    index.resize(in->getRowsPerBlock());
+
+    while (in->next()) {
+      const int n= in->getBlockSize();
+      unsigned char *m= mask.data();
+
+      #pragma omp parallel for simd
+      for (int i=0; i<n; i++) m[i]= 1;
+
+      for (int p=0; p<where.size(); p++) {
+        const StreamField *field= nullptr;
+        for (int k=0; k<in->fields.size(); k++) {
+          if (in->fields[k].name == where[p].name) field= &in->fields[k];
+        }
+        XcHandleError(field->dof!=1 || field->memType==H5T_NATIVE_HBOOL,XCUDA_ERROR,
+          "H5stream::exportSubset","Range fields must be float or integer scalars");
+
+        const double lo= where[p].lo;
+        const double hi= where[p].hi;
+        if (field->memType == H5T_NATIVE_FLOAT) {
+          const float *v= (const float*)field->buffer[in->front].data();
+          #pragma omp parallel for simd
+          for (int i=0; i<n; i++) m[i] &= (unsigned char)((v[i] >= lo) & (v[i] <= hi));
+        } else {
+          const int *v= (const int*)field->buffer[in->front].data();
+          #pragma omp parallel for simd
+          for (int i=0; i<n; i++) m[i] &= (unsigned char)((v[i] >= lo) & (v[i] <= hi));
+        }
+      } // endfor(p)
+
+      const int nSel= H5pio::selectIndices(m,n,index.data());
+      if (nSel == 0) continue;
+
+      for (int k=0; k<in->fields.size(); k++) {
+        const StreamField &field= in->fields[k];
+        const int gid= out.findField(type,field.name.c_str());
+        H5pio::gatherRows(field.buffer[in->front].data(),field.itemSize,index.data(),nSel,
+                          out.dataPointer[gid]);
+      } // endfor(k)
+
+      std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+      out.appendH5Block(type,nSel);
+    } // endwhile
+
+    delete in;
+    streams[type]= nullptr;
+  } // endfor(type)
+
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  out.endH5Stream(time);
+  out.openXdmfFile();
+  out.saveXdmfFrame(time);
+  out.closeXdmfFile();
+  out.closeH5File();
+}
@@ -0,0 +1,112 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Copyright (C) 2026 University of Rochester. All rights reserved.
+//
+#ifndef GIZMO_HEADER_H5stream
+#define GIZMO_HEADER_H5stream
+
+#include "H5pio.h"
+#include <future>
+
+/*!
+\verbatim
+ *********************************************************************
+ *
+ * Streaming reader for snapshots larger than memory
+ *
+ * open()
+ *   Opens a snapshot for reading one particle type.
+ *
+ * addField()
+ *   Adds a dataset of /PartType{type} to the fields that are read
+ *   together for each block. The memory type follows the file:
+ *   booleans, integers, floats, or triplets of floats.
+ *
+ * setMemoryBudget()
+ *   Total bytes for the two block buffers. Blocks are a whole
+ *   number of dataset chunks, so no chunk is decompressed twice.
+ *
+ * next()
+ *   Advances to the next block of rows and returns false at the
+ *   end. While the caller processes block N, block N+1 is read
+ *   by a background thread (double buffering).
+ *
+ * get{type}()
+ *   Pointer to the current block of a field; rows
+ *   [getBlockStart(), getBlockStart()+getBlockSize()).
+ *
+ * exportSubset()
+ *   Streams every type of a snapshot and writes the particles
+ *   that satisfy all of the ranges to a new snapshot plus XDMF,
+ *   within the memory budget. Types that lack one of the range
+ *   fields are left out, as in H5pio::exportFrame().
+ *
+ *********************************************************************
+\endverbatim
+ */
+class H5stream {
+public:
+  H5stream(void);
+ ~H5stream(void);
+
+  void  open(XcCString fileName, const int type);
+  void close(void);
+
+  void addField(XcCString name);
+  void setMemoryBudget(const size_t bytes) { memoryBudget= bytes; }
+
+  bool next(void);
+
+  static void exportSubset(XcCString inFile, XcCString outFile,
+                           const vector<H5pio::Range> &where,
+                           const size_t memoryBudget=size_t(256)<<20);
+
+  long getNumberOfRows(void) { return nRows; }
+  long getBlockStart(void)   { return blockStart; }
+   int getBlockSize(void)    { return blockSize; }
+   int getRowsPerBlock(void);
+
+  void     *getField(XcCString name);
+  bool     *getBoolean(XcCString name) { return (bool*)getField(name); }
+  int      *getInteger(XcCString name) { return (int*)getField(name); }
+  float    *getFloat(XcCString name)   { return (float*)getField(name); }
+  XcFloat3 *getFloat3(XcCString name)  { return (XcFloat3*)getField(name); }
+
+private:
+  struct StreamField {
+    string name;
+    hid_t dataset_id;
+    hid_t memType;
+    int rank;           // 1 or 2 (rows x dof)
+    int dof;
+    int itemSize;       // bytes per row
+    hsize_t chunkRows;  // 0 if contiguous
+    vector<char> buffer[2];
+  };
+
+  vector<StreamField> fields;
+
+  hid_t file_id;
+  hid_t group_id;
+   bool streamIsOpen;
+
+  size_t memoryBudget;
+     int rowsPerBlock;
+
+  long nRows;
+  long blockStart;
+   int blockSize;
+  long nextStart;
+   int front;
+
+  std::future<void> pending;
+
+  void allocateBuffers(void);
+  void readBlock(const long start, const int rows, const int buffer);
+};
+
+// GIZMO_HEADER_H5stream
+#endif
@@ -0,0 +1,329 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Builds per-particle tracks from a series written by H5pio::saveFrame().
+//
+// % buildTracks --series=./data/H5pio --fields=Coordinates,Velocities
+//
+// The frame-major series is transposed into /Tracks/{field}, with
+// dimensions [nTracks][nFrames][dof] and chunks of {block,nFrames,dof},
+// so one particle's history is a single small read. Tracks are the
+// particles of the first frame, in ascending ParticleIDs order.
+// Particles missing from a frame are stored as NaN. By default the
+// block is chosen so its chunks hold about 1 MB together.
+//
+// Memory is bounded by --memory: the tracks are processed in groups
+// of whole blocks, each group reading the series once and writing
+// one hyperslab of whole chunks. The budget covers the group's track
+// buffers, the frame buffers and the prefetch pool.
+//
+#include "H5pio.h"
+#include <algorithm>
+
+struct TrackField {
+  string name;
+  int dof;
+  vector<float> frameData; // one frame, as loaded
+  vector<float> trackData; // [nTracksPerGroup][nFrames][dof]
+  hid_t dataset_id;
+};
+
+static const size_t CHUNK_BYTES= size_t(1) << 20; // target chunk size with --block=0
+
+
+int fieldDof(XcCString fileName, const int type, XcCString name)
+{
+  char path[XCUDA_PATH_LENGTH];
+  snprintf(path,XCUDA_PATH_LENGTH,"PartType%d/%s",type,name);
+
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  hid_t file_id= H5Fopen(fileName,H5F_ACC_RDONLY,H5P_DEFAULT);
+  XcHandleError(file_id<0,XCUDA_ERROR,"buildTracks","Unable to open the first frame");
+
+  hid_t dataset_id= H5Dopen(file_id,path,H5P_DEFAULT);
+  XcHandleError(dataset_id<0,XCUDA_ERROR,"buildTracks","Field not found in the first frame");
+
+  hsize_t dims[2]= {0,1};
+  hid_t dataspace_id= H5Dget_space(dataset_id);
+  H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+  H5Sclose(dataspace_id);
+  H5Dclose(dataset_id);
+  H5Fclose(file_id);
+
+  return int(dims[1]);
+}
+
+
+int main(int argc, char *argv[])
+{
+  int jobStatus= 0;
+
+  int type= 0;
+  int blockSize= 0;
+  int memoryMB= 1024;
+  int prefetch= 2;
+  XcString seriesName= XcString("./data/H5pio");
+  XcString tracksFile= XcString("./data/tracks.hdf5");
+  XcString fieldList= XcString("Coordinates");
+
+  XcParameters args;
+  {
+    args.parseCmdLineArguments(argc,argv,
+    "  [--series= ./data/H5pio] [--tracks= ./data/tracks.hdf5] [--fields=Coordinates]\n"
+    "  [--type=0] [--block=0 (auto)] [--memory=1024 (MB)] [--prefetch=2]");
+
+    args.get_string("series",&seriesName);
+    args.get_string("tracks",&tracksFile);
+    args.get_string("fields",&fieldList);
+    args.get_int("type",&type, 0);
+    args.get_int("block",&blockSize, 0);
+    args.get_int("memory",&memoryMB, 1);
+    args.get_int("prefetch",&prefetch, 0);
+
+    args.checkCmdLineArguments();
+  }
+
+  H5pio::initH5Library();
+
+  // frame catalog (per-frame particle counts)
+  //
+  H5pio catalog;
+  catalog.openFiles(seriesName);
+  const int nFrames= catalog.getNumberOfFrames();
+  XcHandleError(nFrames==0,XCUDA_ERROR,"buildTracks","No frames found");
+
+  int maxCount= 0;
+  bool countsAreConstant= true;
+  for (int f=1; f<=nFrames; f++) {
+    const H5pio::FrameInfo &info= catalog.getFrameInfo(f);
+    maxCount= std::max(maxCount,info.nParticles[type]);
+    for (int t=0; t<H5pio::N_TYPES; t++) {
+      countsAreConstant= countsAreConstant && (info.nParticles[t] == catalog.getFrameInfo(1).nParticles[t]);
+    }
+  } // endfor(f)
+
+  // fields to track
+  //
+  char firstFrame[XCUDA_PATH_LENGTH];
+  snprintf(firstFrame,XCUDA_PATH_LENGTH,"%s_%04d.hdf5",seriesName,1);
+
+  vector<TrackField> fields;
+  {
+    string list(fieldList);
+    size_t start= 0;
+    while (start <= list.size()) {
+      size_t end= list.find(',',start);
+      if (end == string::npos) end= list.size();
+      if (end > start) {
+        TrackField field;
+        field.name= list.substr(start,end-start);
+        field.dof= fieldDof(firstFrame,type,field.name.c_str());
+        field.frameData.resize(size_t(maxCount)*field.dof);
+        fields.push_back(field);
+      }
+      start= end+1;
+    } // endwhile
+  }
+
+  const int nTracks= catalog.getFrameInfo(1).nParticles[type];
+  XcHandleError(nTracks==0,XCUDA_ERROR,"buildTracks","No particles of this type in the first frame");
+
+  // block, and tracks per group, from the memory budget: a frame
+  // is held by the registered buffers (with ParticleIDs and the slot
+  // of each particle) and by each slot of the prefetch pool
+  //
+  size_t bytesPerTrack= 0;
+  size_t bytesPerParticle= 2*sizeof(int);
+  for (int k=0; k<fields.size(); k++) {
+    bytesPerTrack += size_t(nFrames)*fields[k].dof*sizeof(float);
+    bytesPerParticle += fields[k].dof*sizeof(float);
+  } // endfor(k)
+
+  const int nPrefetch= countsAreConstant ? prefetch : 0;
+  const size_t frameBytes= size_t(maxCount)*(bytesPerParticle + size_t(nPrefetch)*(bytesPerParticle-sizeof(int)))
+                         + size_t(nTracks)*sizeof(int);
+
+  const int block= (blockSize > 0) ? std::min(blockSize,nTracks) :
+                   int(std::max(size_t(1),std::min(size_t(nTracks),CHUNK_BYTES/bytesPerTrack)));
+
+  const size_t budget= size_t(memoryMB) << 20;
+  const size_t trackBudget= (budget > frameBytes) ? budget - frameBytes : 0;
+  const long nBlocks= std::max(1L,long(trackBudget/(size_t(block)*bytesPerTrack)));
+  const int nTracksPerGroup= int(std::min(long(nTracks),nBlocks*block));
+  const int nGroups= (nTracks + nTracksPerGroup-1)/nTracksPerGroup;
+
+  if (trackBudget < size_t(block)*bytesPerTrack) {
+    printf("Warning: --memory=%d MB is below the %.1f MB needed for one block of tracks\n",memoryMB,
+           double(frameBytes + size_t(block)*bytesPerTrack)/double(1 << 20));
+  } // endif
+
+  for (int k=0; k<fields.size(); k++) {
+    fields[k].trackData.resize(size_t(nTracksPerGroup)*nFrames*fields[k].dof);
+  }
+
+  printf("\n");
+  printf("Building %d tracks over %d frames (%d tracks per group, %d groups)\n",
+         nTracks,nFrames,nTracksPerGroup,nGroups);
+  printf("{\n");
+
+  // register the frame buffers
+  //
+  vector<int> pid(maxCount);
+
+  H5pio pi;
+  pi.registerParticles(maxCount,type);
+  pi.registerInteger1DField(H5pio::CENTER_BY_NODE,"ParticleIDs",pid.data());
+  for (int k=0; k<fields.size(); k++) {
+    if (fields[k].dof == 3) {
+      pi.registerFloat3DField(H5pio::CENTER_BY_NODE,fields[k].name,(XcFloat3*)fields[k].frameData.data());
+    } else {
+      pi.registerFloat1DField(H5pio::CENTER_BY_NODE,fields[k].name,fields[k].frameData.data());
+    }
+  } // endfor(k)
+
+  // output file; the prefetch thread reads frames while the tracks
+  // are written, so every HDF5 call below holds the library mutex
+  //
+  hid_t file_id, group_id;
+  {
+    std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+    file_id= H5Fcreate(tracksFile,H5F_ACC_TRUNC,H5P_DEFAULT,H5P_DEFAULT);
+    XcHandleError(file_id<0,XCUDA_ERROR,"buildTracks","Unable to create the tracks file");
+    group_id= H5Gcreate(file_id,"Tracks",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+
+    for (int k=0; k<fields.size(); k++) {
+      hsize_t dims[3]= {hsize_t(nTracks),hsize_t(nFrames),hsize_t(fields[k].dof)};
+      hsize_t cdims[3]= {hsize_t(block),hsize_t(nFrames),hsize_t(fields[k].dof)};
+
+      hid_t dataspace_id= H5Screate_simple(3,dims,nullptr);
+      hid_t plist_id= H5Pcreate(H5P_DATASET_CREATE);
+      H5Pset_chunk(plist_id,3,cdims);
+      H5Pset_deflate(plist_id,6);
+      fields[k].dataset_id= H5Dcreate(group_id,fields[k].name.c_str(),H5T_NATIVE_FLOAT,dataspace_id,
+                                      H5P_DEFAULT,plist_id,H5P_DEFAULT);
+      H5Pclose(plist_id);
+      H5Sclose(dataspace_id);
+    } // endfor(k)
+  }
+
+  vector<int> trackIDs(nTracks);
+  vector<float> times(nFrames,0.0f);
+  vector<int> slot(maxCount);
+
+  for (int t0=0; t0<nTracks; t0+=nTracksPerGroup) {
+    const int nt= std::min(nTracksPerGroup,nTracks-t0);
+
+    for (int k=0; k<fields.size(); k++) {
+      float *data= fields[k].trackData.data();
+      const size_t n= fields[k].trackData.size();
+      #pragma omp parallel for
+      for (size_t i=0; i<n; i++) data[i]= NAN;
+    } // endfor(k)
+
+    for (int t=0; t<H5pio::N_TYPES; t++) pi.nParticles[t]= catalog.getFrameInfo(1).nParticles[t];
+    pi.openFiles(seriesName,nPrefetch);
+
+    for (int f=1; f<=nFrames; f++) {
+      const H5pio::FrameInfo &info= catalog.getFrameInfo(f);
+      for (int t=0; t<H5pio::N_TYPES; t++) pi.nParticles[t]= info.nParticles[t];
+
+      pi.loadFrame();
+      times[f-1]= pi.frameTime;
+
+      const int np= info.nParticles[type];
+
+      if (f == 1 && t0 == 0) {
+        vector<int> perm(np);
+        H5pio::sortPermutation(pid.data(),np,perm.data());
+        #pragma omp parallel for
+        for (int i=0; i<np; i++) trackIDs[i]= pid[perm[i]];
+      } // endif
+
+      // match by ID to the tracks of this group, then pack into
+      // [track][frame][dof]
+      //
+      #pragma omp parallel for
+      for (int i=0; i<np; i++) {
+        const int *p= std::lower_bound(trackIDs.data()+t0,trackIDs.data()+t0+nt,pid[i]);
+        slot[i]= (p != trackIDs.data()+t0+nt && *p == pid[i]) ? int(p-trackIDs.data()) - t0 : -1;
+      } // endfor(i)
+
+      for (int k=0; k<fields.size(); k++) {
+        const int dof= fields[k].dof;
+        const float *src= fields[k].frameData.data();
+        float *dst= fields[k].trackData.data();
+
+        #pragma omp parallel for
+        for (int i=0; i<np; i++) {
+          const int t= slot[i];
+          if (t >= 0) {
+            for (int d=0; d<dof; d++) dst[(size_t(t)*nFrames + f-1)*dof + d]= src[size_t(i)*dof + d];
+          }
+        } // endfor(i)
+      } // endfor(k)
+    } // endfor(f)
+
+    pi.closeFiles();
+
+    // one hyperslab per field, covering whole chunks
+    //
+    std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+    for (int k=0; k<fields.size(); k++) {
+      const hsize_t dof= fields[k].dof;
+
+      hsize_t count[3]= {hsize_t(nt),hsize_t(nFrames),dof};
+      hid_t memspace_id= H5Screate_simple(3,count,nullptr);
+
+      hsize_t fstart[3]= {hsize_t(t0),0,0};
+      hid_t filespace_id= H5Dget_space(fields[k].dataset_id);
+      H5Sselect_hyperslab(filespace_id,H5S_SELECT_SET,fstart,nullptr,count,nullptr);
+
+      H5Dwrite(fields[k].dataset_id,H5T_NATIVE_FLOAT,memspace_id,filespace_id,H5P_DEFAULT,
+               fields[k].trackData.data());
+
+      H5Sclose(filespace_id);
+      H5Sclose(memspace_id);
+    } // endfor(k)
+
+    printf("   Packed tracks %d to %d from %d frames\n",t0,t0+nt-1,nFrames);
+  } // endfor(t0)
+
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  for (int k=0; k<fields.size(); k++) H5Dclose(fields[k].dataset_id);
+
+  // track IDs and frame times
+  //
+  {
+    hsize_t dims= nTracks;
+    hid_t dataspace_id= H5Screate_simple(1,&dims,nullptr);
+    hid_t dataset_id= H5Dcreate(group_id,"ParticleIDs",H5T_NATIVE_INT,dataspace_id,
+                                H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    H5Dwrite(dataset_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,trackIDs.data());
+    H5Dclose(dataset_id);
+    H5Sclose(dataspace_id);
+  }
+  {
+    hsize_t dims= nFrames;
+    hid_t dataspace_id= H5Screate_simple(1,&dims,nullptr);
+    hid_t dataset_id= H5Dcreate(group_id,"Time",H5T_NATIVE_FLOAT,dataspace_id,
+                                H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    H5Dwrite(dataset_id,H5T_NATIVE_FLOAT,H5S_ALL,H5S_ALL,H5P_DEFAULT,times.data());
+    H5Dclose(dataset_id);
+    H5Sclose(dataspace_id);
+  }
+
+  H5Gclose(group_id);
+  H5Fclose(file_id);
+
+  printf("}\n");
+  printf("Saved %d tracks to %s\n",nTracks,tracksFile);
+
+  H5pio::closeH5Library();
+
+  return jobStatus;
+}
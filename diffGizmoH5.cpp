@@ -0,0 +1,503 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Compares two snapshots, or two series written by H5pio::saveFrame(),
+// dataset by dataset.
+//
+// % diffGizmoH5 --first=./run1/H5pio_0001.hdf5 --second=./run2/H5pio_0001.hdf5 --rtol=1e-6
+// % diffGizmoH5 --first=./run1/H5pio --second=./run2/H5pio --series --byID
+//
+// Values a (first) and b (second) match when |a-b| <= atol + rtol*|b| (two NaNs match).
+// For each dataset of each PartType the report gives the maximum
+// absolute and relative errors, the RMS error, the number of
+// mismatched values and the first --show offenders. Datasets present
+// in one file only, or with different shapes or types, and differing
+// Header counts are reported as failures. The exit status is 1 if
+// anything failed, 0 otherwise.
+//
+// Datasets are streamed with H5stream, a block of both files being
+// read in the background while the previous one is compared, so
+// memory is bounded by --memory and the comparison keeps up with the
+// disk. With --byID, rows are matched by ParticleIDs instead of by
+// position; each dataset of that type is then held in memory, one
+// at a time, for both files.
+//
+#include "H5stream.h"
+#include <math.h>
+#include <algorithm>
+#include <unistd.h>
+
+struct Tolerance {
+  double atol;
+  double rtol;
+  int maxShow;
+};
+
+struct Offender {
+  long row;      // or ParticleID with --byID
+  int component;
+  double a;
+  double b;
+};
+
+struct FieldStats {
+  long nValues;
+  long nMismatches;
+  double maxAbs;
+  double maxRel;
+  double sumSq;
+  vector<Offender> offenders;
+};
+
+
+// Compares n values; row0 is the row of a[0] (dof values per row), or
+// rowID gives the row label of each row.
+//
+template<class T>
+void compareValues(const T *a, const T *b, const long n, const long row0, const int dof,
+                   const int *rowID, const Tolerance &tol, FieldStats &s)
+{
+  const double atol= tol.atol;
+  const double rtol= tol.rtol;
+
+  double maxAbs= 0.0;
+  double maxRel= 0.0;
+  double sumSq= 0.0;
+  long nBad= 0;
+
+  #pragma omp parallel for simd reduction(max:maxAbs,maxRel) reduction(+:sumSq,nBad)
+  for (long i=0; i<n; i++) {
+    const double x= double(a[i]);
+    const double y= double(b[i]);
+    const bool same= (x == y) || (x != x && y != y);
+    const double d0= fabs(x-y);
+    const double d= same ? 0.0 : ((d0 == d0) ? d0 : HUGE_VAL); // one NaN: infinitely far
+    const double r= (d > 0.0) ? d/fabs(y) : 0.0;
+    maxAbs= std::max(maxAbs,d);
+    maxRel= std::max(maxRel,r);
+    sumSq += d*d;
+    nBad += (d > atol + rtol*fabs(y)) ? 1 : 0;
+  } // endfor(i)
+
+  s.nValues += n;
+  s.nMismatches += nBad;
+  s.maxAbs= std::max(s.maxAbs,maxAbs);
+  s.maxRel= std::max(s.maxRel,maxRel);
+  s.sumSq += sumSq;
+
+  // the first offenders: rescan serially, only when there are some
+  //
+  for (long i=0; i<n && nBad > 0 && s.offenders.size() < tol.maxShow; i++) {
+    const double x= double(a[i]);
+    const double y= double(b[i]);
+    const bool same= (x == y) || (x != x && y != y);
+    const double d= fabs(x-y);
+    if (same || d <= atol + rtol*fabs(y)) continue;
+
+    Offender o;
+    o.row= (rowID != nullptr) ? long(rowID[i/dof]) : row0 + i/dof;
+    o.component= int(i % dof);
+    o.a= x;
+    o.b= y;
+    s.offenders.push_back(o);
+  } // endfor(i)
+}
+
+
+void compareBuffers(const void *a, const void *b, const long nValues, const long row0, const int dof,
+                    const hid_t memType, const int *rowID, const Tolerance &tol, FieldStats &s)
+{
+  if (memType == H5T_NATIVE_FLOAT) {
+    compareValues((const float*)a,(const float*)b,nValues,row0,dof,rowID,tol,s);
+  } else if (memType == H5T_NATIVE_INT) {
+    compareValues((const int*)a,(const int*)b,nValues,row0,dof,rowID,tol,s);
+  } else {
+    compareValues((const unsigned char*)a,(const unsigned char*)b,nValues,row0,dof,rowID,tol,s);
+  }
+}
+
+
+struct DatasetInfo {
+  string name;
+  long rows;
+  int dof;
+  hid_t memType;  // as H5stream reads it
+  int valueSize;
+};
+
+
+static herr_t listDataset(hid_t group_id, const char *name, const H5L_info_t *info, void *data)
+{
+  H5O_info_t oinfo;
+  H5Oget_info_by_name(group_id,name,&oinfo,H5P_DEFAULT);
+  if (oinfo.type == H5O_TYPE_DATASET) ((vector<string>*)data)->push_back(string(name));
+  return 0;
+}
+
+
+// Header counts, time and the datasets of each type
+//
+void scanFile(XcCString fileName, int nParticles[], float *time, vector<DatasetInfo> datasets[])
+{
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  hid_t file_id= H5Fopen(fileName,H5F_ACC_RDONLY,H5P_DEFAULT);
+  XcHandleError(bool(file_id<0),XCUDA_ERROR,"diffGizmoH5",
+    "Unable to open an HDF5 file (check name and/or path)");
+
+  hid_t header_id= H5Gopen(file_id,"Header",H5P_DEFAULT);
+  {
+    hid_t attribute_id= H5Aopen(header_id,"NumPart_ThisFile",H5P_DEFAULT);
+    H5Aread(attribute_id,H5T_NATIVE_INT,nParticles);
+    H5Aclose(attribute_id);
+
+    attribute_id= H5Aopen(header_id,"Time",H5P_DEFAULT);
+    H5Aread(attribute_id,H5T_NATIVE_FLOAT,time);
+    H5Aclose(attribute_id);
+  }
+  H5Gclose(header_id);
+
+  for (int type=0; type<H5pio::N_TYPES; type++) {
+    datasets[type].clear();
+
+    char partType[16];
+    sprintf(partType,"PartType%d",type);
+    if (H5Lexists(file_id,partType,H5P_DEFAULT) <= 0) continue;
+
+    vector<string> names;
+    hid_t group_id= H5Gopen(file_id,partType,H5P_DEFAULT);
+    H5Literate(group_id,H5_INDEX_NAME,H5_ITER_INC,nullptr,listDataset,&names);
+
+    for (int k=0; k<names.size(); k++) {
+      DatasetInfo d;
+      d.name= names[k];
+
+      hid_t dataset_id= H5Dopen(group_id,names[k].c_str(),H5P_DEFAULT);
+      hsize_t dims[2]= {0,1};
+      hid_t dataspace_id= H5Dget_space(dataset_id);
+      const int rank= H5Sget_simple_extent_dims(dataspace_id,dims,nullptr);
+      H5Sclose(dataspace_id);
+
+      hid_t type_id= H5Dget_type(dataset_id);
+      if (H5Tget_class(type_id) == H5T_FLOAT) {
+        d.memType= H5T_NATIVE_FLOAT;
+        d.valueSize= sizeof(float);
+      } else if (H5Tget_size(type_id) == 1) {
+        d.memType= H5T_NATIVE_HBOOL;
+        d.valueSize= 1;
+      } else {
+        d.memType= H5T_NATIVE_INT;
+        d.valueSize= sizeof(int);
+      }
+      H5Tclose(type_id);
+      H5Dclose(dataset_id);
+
+      if (rank < 1 || rank > 2) continue; // not particle data
+      d.rows= long(dims[0]);
+      d.dof= int(dims[1]);
+      datasets[type].push_back(d);
+    } // endfor(k)
+
+    H5Gclose(group_id);
+  } // endfor(type)
+
+  H5Fclose(file_id);
+}
+
+
+// Whole dataset, for matching by ID
+//
+void readDataset(XcCString fileName, const int type, const DatasetInfo &d, vector<char> &data)
+{
+  char path[XCUDA_PATH_LENGTH];
+  snprintf(path,XCUDA_PATH_LENGTH,"PartType%d/%s",type,d.name.c_str());
+
+  data.resize(size_t(d.rows)*d.dof*d.valueSize);
+
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  hid_t file_id= H5Fopen(fileName,H5F_ACC_RDONLY,H5P_DEFAULT);
+  hid_t dataset_id= H5Dopen(file_id,path,H5P_DEFAULT);
+  XcHandleError(bool(dataset_id<0),XCUDA_ERROR,"diffGizmoH5","Unable to read a dataset");
+
+  if (d.rows > 0) H5Dread(dataset_id,d.memType,H5S_ALL,H5S_ALL,H5P_DEFAULT,data.data());
+
+  H5Dclose(dataset_id);
+  H5Fclose(file_id);
+}
+
+
+// Streams one dataset of both files and compares the overlapping
+// rows of the current blocks. The blocks of a and b need not line
+// up, since the chunking of the two files may differ.
+//
+void streamDataset(XcCString fileA, XcCString fileB, const int type, const DatasetInfo &d,
+                   const long nRows, const size_t memoryBudget, const Tolerance &tol, FieldStats &s)
+{
+  if (nRows == 0) return;
+
+  H5stream sa, sb;
+  sa.open(fileA,type);
+  sb.open(fileB,type);
+  sa.addField(d.name.c_str());
+  sb.addField(d.name.c_str());
+  sa.setMemoryBudget(memoryBudget/2);
+  sb.setMemoryBudget(memoryBudget/2);
+
+  const size_t rowBytes= size_t(d.dof)*d.valueSize;
+
+  bool moreA= sa.next();
+  bool moreB= sb.next();
+  long row= 0;
+
+  while (moreA && moreB && row < nRows) {
+    const long endA= sa.getBlockStart() + sa.getBlockSize();
+    const long endB= sb.getBlockStart() + sb.getBlockSize();
+    const long end= std::min(std::min(endA,endB),nRows);
+
+    const char *a= (const char*)sa.getField(d.name.c_str()) + (row-sa.getBlockStart())*rowBytes;
+    const char *b= (const char*)sb.getField(d.name.c_str()) + (row-sb.getBlockStart())*rowBytes;
+    compareBuffers(a,b,(end-row)*d.dof,row,d.dof,d.memType,nullptr,tol,s);
+
+    row= end;
+    if (row == endA) moreA= sa.next();
+    if (row == endB) moreB= sb.next();
+  } // endwhile
+
+  sa.close();
+  sb.close();
+}
+
+
+const DatasetInfo *findDataset(const vector<DatasetInfo> &datasets, const string &name)
+{
+  for (int k=0; k<datasets.size(); k++) {
+    if (datasets[k].name == name) return &datasets[k];
+  } // endfor(k)
+  return nullptr;
+}
+
+
+// Compares one pair of snapshots and returns true if they match
+//
+bool compareFiles(XcCString fileA, XcCString fileB, const bool byID,
+                  const size_t memoryBudget, const Tolerance &tol)
+{
+  int npA[H5pio::N_TYPES], npB[H5pio::N_TYPES];
+  float timeA, timeB;
+  vector<DatasetInfo> dsA[H5pio::N_TYPES], dsB[H5pio::N_TYPES];
+
+  scanFile(fileA,npA,&timeA,dsA);
+  scanFile(fileB,npB,&timeB,dsB);
+
+  bool ok= true;
+
+  printf("   a: %s\n",fileA);
+  printf("   b: %s\n",fileB);
+
+  if (fabs(double(timeA)-double(timeB)) > tol.atol + tol.rtol*fabs(double(timeB))) {
+    printf("   Header/Time: %g vs %g  FAILED\n",timeA,timeB);
+    ok= false;
+  } // endif
+
+  for (int type=0; type<H5pio::N_TYPES; type++) {
+    if (npA[type] != npB[type]) {
+      printf("   Header/NumPart_ThisFile[%d]: %d vs %d  FAILED\n",type,npA[type],npB[type]);
+      ok= false;
+    } // endif
+
+    // datasets of one file only
+    //
+    for (int k=0; k<dsA[type].size(); k++) {
+      if (findDataset(dsB[type],dsA[type][k].name) == nullptr) {
+        printf("   PartType%d/%s: only in a  FAILED\n",type,dsA[type][k].name.c_str());
+        ok= false;
+      }
+    } // endfor(k)
+    for (int k=0; k<dsB[type].size(); k++) {
+      if (findDataset(dsA[type],dsB[type][k].name) == nullptr) {
+        printf("   PartType%d/%s: only in b  FAILED\n",type,dsB[type][k].name.c_str());
+        ok= false;
+      }
+    } // endfor(k)
+
+    // rows of a and b in ascending ParticleIDs order
+    //
+    vector<int> permA, permB, sortedID;
+    bool matchByID= false;
+    long idRows= -1;
+
+    if (byID) {
+      const DatasetInfo *idA= findDataset(dsA[type],"ParticleIDs");
+      const DatasetInfo *idB= findDataset(dsB[type],"ParticleIDs");
+
+      if (idA != nullptr && idB != nullptr && idA->rows == idB->rows && idA->dof == 1 &&
+          idA->memType == H5T_NATIVE_INT && idB->memType == H5T_NATIVE_INT) {
+        vector<char> rawA, rawB;
+        readDataset(fileA,type,*idA,rawA);
+        readDataset(fileB,type,*idB,rawB);
+        const int *idsA= (const int*)rawA.data();
+        const int *idsB= (const int*)rawB.data();
+        const int n= int(idA->rows);
+
+        permA.resize(n);
+        permB.resize(n);
+        H5pio::sortPermutation(idsA,n,permA.data());
+        H5pio::sortPermutation(idsB,n,permB.data());
+
+        sortedID.resize(n);
+        long nDiffer= 0;
+        #pragma omp parallel for reduction(+:nDiffer)
+        for (int i=0; i<n; i++) {
+          sortedID[i]= idsA[permA[i]];
+          nDiffer += (idsA[permA[i]] != idsB[permB[i]]) ? 1 : 0;
+        } // endfor(i)
+
+        if (nDiffer > 0) {
+          printf("   PartType%d/ParticleIDs: %ld IDs differ, matching by row  FAILED\n",type,nDiffer);
+          ok= false;
+        } else {
+          matchByID= true;
+          idRows= n;
+        }
+      } else if (idA != nullptr || idB != nullptr) {
+        printf("   PartType%d/ParticleIDs: not comparable, matching by row  FAILED\n",type);
+        ok= false;
+      }
+    } // endif
+
+    for (int k=0; k<dsA[type].size(); k++) {
+      const DatasetInfo &a= dsA[type][k];
+      const DatasetInfo *b= findDataset(dsB[type],a.name);
+      if (b == nullptr) continue;
+
+      if (a.dof != b->dof || a.memType != b->memType) {
+        printf("   PartType%d/%s: different shape or type  FAILED\n",type,a.name.c_str());
+        ok= false;
+        continue;
+      } // endif
+
+      FieldStats s;
+      s.nValues= 0;
+      s.nMismatches= 0;
+      s.maxAbs= 0.0;
+      s.maxRel= 0.0;
+      s.sumSq= 0.0;
+
+      if (matchByID && a.rows == idRows && b->rows == idRows) {
+        vector<char> rawA, rawB, sortedA(size_t(a.rows)*a.dof*a.valueSize), sortedB(sortedA.size());
+        readDataset(fileA,type,a,rawA);
+        H5pio::gatherRows(rawA.data(),a.dof*a.valueSize,permA.data(),int(a.rows),sortedA.data());
+        vector<char>().swap(rawA);
+        readDataset(fileB,type,*b,rawB);
+        H5pio::gatherRows(rawB.data(),b->dof*b->valueSize,permB.data(),int(b->rows),sortedB.data());
+        vector<char>().swap(rawB);
+
+        compareBuffers(sortedA.data(),sortedB.data(),a.rows*a.dof,0,a.dof,a.memType,
+                       sortedID.data(),tol,s);
+      } else {
+        streamDataset(fileA,fileB,type,a,std::min(a.rows,b->rows),memoryBudget,tol,s);
+      }
+
+      const bool fieldOk= (s.nMismatches == 0 && a.rows == b->rows);
+      ok= ok && fieldOk;
+
+      printf("   PartType%d/%s: rows %ld",type,a.name.c_str(),a.rows);
+      if (a.rows != b->rows) printf(" vs %ld",b->rows);
+      printf("  max abs %.3e  max rel %.3e  rms %.3e  mismatches %ld  %s\n",
+        s.maxAbs,s.maxRel,(s.nValues > 0) ? sqrt(s.sumSq/s.nValues) : 0.0,s.nMismatches,
+        fieldOk ? "ok" : "FAILED");
+
+      for (int j=0; j<s.offenders.size(); j++) {
+        const Offender &o= s.offenders[j];
+        printf("      %s %ld [%d]: %.9g vs %.9g\n",matchByID ? "id" : "row",o.row,o.component,o.a,o.b);
+      } // endfor(j)
+    } // endfor(k)
+  } // endfor(type)
+
+  return ok;
+}
+
+
+int main(int argc, char *argv[])
+{
+  int jobStatus= 0;
+
+  float atol= 0.0f;
+  float rtol= 0.0f;
+  int maxShow= 5;
+  int memoryMB= 256;
+  bool isSeries= false;
+  bool byID= false;
+  XcString nameA= XcString("./data/a_0001.hdf5");
+  XcString nameB= XcString("./data/b_0001.hdf5");
+
+  XcParameters args;
+  {
+    args.parseCmdLineArguments(argc,argv,
+    "  --first= ./run1/H5pio_0001.hdf5 --second= ./run2/H5pio_0001.hdf5 [--series] [--byID]\n"
+    "  [--atol=0] [--rtol=0] [--show=5] [--memory=256 (MB)]");
+
+    args.get_string("first",&nameA);
+    args.get_string("second",&nameB);
+    args.get_float("atol",&atol, 0.0f);
+    args.get_float("rtol",&rtol, 0.0f);
+    args.get_int("show",&maxShow, 0);
+    args.get_int("memory",&memoryMB, 1);
+    args.getCmdLineFlag("series",&isSeries);
+    args.getCmdLineFlag("byID",&byID);
+
+    args.checkCmdLineArguments();
+  }
+
+  Tolerance tol;
+  tol.atol= atol;
+  tol.rtol= rtol;
+  tol.maxShow= maxShow;
+
+  const size_t memoryBudget= size_t(memoryMB) << 20;
+
+  H5pio::initH5Library();
+
+  printf("\n");
+  printf("Comparing with atol %g and rtol %g%s\n",atol,rtol,byID ? ", matching by ParticleIDs" : "");
+  printf("{\n");
+
+  bool ok= true;
+
+  if (isSeries) {
+    int f= 1;
+    for (;; f++) {
+      char fileA[XCUDA_PATH_LENGTH], fileB[XCUDA_PATH_LENGTH];
+      snprintf(fileA,XCUDA_PATH_LENGTH,"%s_%04d.hdf5",nameA,f);
+      snprintf(fileB,XCUDA_PATH_LENGTH,"%s_%04d.hdf5",nameB,f);
+
+      const bool hasA= (access(fileA,R_OK) == 0);
+      const bool hasB= (access(fileB,R_OK) == 0);
+      if (!hasA || !hasB) {
+        if (hasA != hasB) {
+          printf("   Frame %d: only in %s  FAILED\n",f,hasA ? "a" : "b");
+          ok= false;
+        }
+        break;
+      } // endif
+
+      printf("   Frame %d\n",f);
+      ok= compareFiles(fileA,fileB,byID,memoryBudget,tol) && ok;
+    } // endfor(f)
+
+    XcHandleError(f==1,XCUDA_ERROR,"diffGizmoH5","No frames found");
+  } else {
+    ok= compareFiles(nameA,nameB,byID,memoryBudget,tol);
+  }
+
+  printf("}\n");
+  printf("%s\n",ok ? "Passed" : "Failed");
+
+  H5pio::closeH5Library();
+
+  jobStatus= ok ? 0 : 1;
+  return jobStatus;
+}
@@ -0,0 +1,143 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Deposits a series written by H5pio::saveFrame() onto uniform grids.
+//
+// % gridGizmoH5 --series=./data/disk_2d --fields=Density,InternalEnergy --nx=512 --ny=512
+//
+// Each frame becomes {output}_%04d.hdf5 with /Grid/{field}, plus an
+// XDMF 3DCoRectMesh that ParaView loads as a volume (--nz=1 for 2D).
+// The box defaults to the bounding box of the first frame.
+//
+#include "H5grid.h"
+#include <algorithm>
+
+int main(int argc, char *argv[])
+{
+  int jobStatus= 0;
+
+  int type= 0;
+  int nx= 256;
+  int ny= 256;
+  int nz= 1;
+  float xmin= 0.0f, xmax= 0.0f;
+  float ymin= 0.0f, ymax= 0.0f;
+  float zmin= 0.0f, zmax= 0.0f;
+  XcString seriesName= XcString("./data/H5pio");
+  XcString outputName= XcString("./data/grid");
+  XcString fieldList= XcString("Density");
+
+  XcParameters args;
+  {
+    args.parseCmdLineArguments(argc,argv,
+    "  [--series= ./data/H5pio] [--output= ./data/grid] [--fields=Density] [--type=0]\n"
+    "  [--nx=256] [--ny=256] [--nz=1] [--xmin= --xmax= --ymin= --ymax= --zmin= --zmax=]");
+
+    args.get_string("series",&seriesName);
+    args.get_string("output",&outputName);
+    args.get_string("fields",&fieldList);
+    args.get_int("type",&type, 0);
+    args.get_int("nx",&nx, 1);
+    args.get_int("ny",&ny, 1);
+    args.get_int("nz",&nz, 1);
+    args.get_float("xmin",&xmin, 0.0f);
+    args.get_float("xmax",&xmax, 0.0f);
+    args.get_float("ymin",&ymin, 0.0f);
+    args.get_float("ymax",&ymax, 0.0f);
+    args.get_float("zmin",&zmin, 0.0f);
+    args.get_float("zmax",&zmax, 0.0f);
+
+    args.checkCmdLineArguments();
+  }
+
+  H5pio::initH5Library();
+
+  H5pio catalog;
+  catalog.openFiles(seriesName);
+  const int nFrames= catalog.getNumberOfFrames();
+  XcHandleError(nFrames==0,XCUDA_ERROR,"gridGizmoH5","No frames found");
+
+  int maxCount= 0;
+  for (int f=1; f<=nFrames; f++) {
+    maxCount= std::max(maxCount,catalog.getFrameInfo(f).nParticles[type]);
+  } // endfor(f)
+
+  // fields to grid; Density comes from the masses
+  //
+  vector<string> names;
+  {
+    string list(fieldList);
+    size_t start= 0;
+    while (start <= list.size()) {
+      size_t end= list.find(',',start);
+      if (end == string::npos) end= list.size();
+      if (end > start) names.push_back(list.substr(start,end-start));
+      start= end+1;
+    } // endwhile
+  }
+
+  vector<XcFloat3> loc(maxCount);
+  vector<float> mass(maxCount);
+  vector<float> sph(maxCount);
+  vector< vector<float> > data(names.size());
+
+  H5pio pi;
+  pi.registerParticles(maxCount,type);
+  pi.registerGeometry3DField(H5pio::CENTER_BY_NODE,"Coordinates",loc.data());
+  pi.registerFloat1DField(H5pio::CENTER_BY_NODE,"Masses",mass.data());
+  pi.registerFloat1DField(H5pio::CENTER_BY_NODE,"SmoothingLength",sph.data());
+  for (int k=0; k<names.size(); k++) {
+    if (names[k] == "Density" || pi.findField(type,names[k].c_str()) >= 0) continue;
+    data[k].resize(maxCount);
+    pi.registerFloat1DField(H5pio::CENTER_BY_NODE,names[k],data[k].data());
+  } // endfor(k)
+
+  pi.openFiles(seriesName);
+
+  printf("\n");
+  printf("Gridding %d frames onto %d x %d x %d cells\n",nFrames,nx,ny,nz);
+  printf("{\n");
+
+  H5grid grid;
+
+  for (int f=1; f<=nFrames; f++) {
+    const H5pio::FrameInfo &info= catalog.getFrameInfo(f);
+    for (int t=0; t<H5pio::N_TYPES; t++) pi.nParticles[t]= info.nParticles[t];
+
+    pi.loadFrame();
+    const int np= pi.nParticles[type];
+
+    if (f == 1) {
+      if (xmax <= xmin || ymax <= ymin || (nz > 1 && zmax <= zmin)) {
+        XcFloat3 lo= loc[0], hi= loc[0];
+        for (int i=1; i<np; i++) {
+          lo.x= std::min(lo.x,loc[i].x); hi.x= std::max(hi.x,loc[i].x);
+          lo.y= std::min(lo.y,loc[i].y); hi.y= std::max(hi.y,loc[i].y);
+          lo.z= std::min(lo.z,loc[i].z); hi.z= std::max(hi.z,loc[i].z);
+        } // endfor(i)
+        xmin= lo.x; xmax= hi.x;
+        ymin= lo.y; ymax= hi.y;
+        zmin= lo.z; zmax= hi.z;
+      } // endif
+      grid.setGrid(XcFloat3(xmin,ymin,zmin),XcFloat3(xmax,ymax,zmax),nx,ny,nz);
+    } // endif
+
+    grid.deposit(pi,type,names);
+
+    char fileName[XCUDA_PATH_LENGTH];
+    snprintf(fileName,XCUDA_PATH_LENGTH,"%s_%04d",outputName,f);
+    grid.saveGrid(fileName,pi.frameTime);
+
+    printf("   Saved %s at time %.3f (%d particles)\n",fileName,pi.frameTime,np);
+  } // endfor(f)
+
+  pi.closeFiles();
+
+  printf("}\n");
+
+  H5pio::closeH5Library();
+
+  return jobStatus;
+}
@@ -0,0 +1,84 @@
+//
+// Authors: John G. Shaw
+// Revised: Oct. 18 2026
+// Version: 1.0.0
+//
+// Generates gas initial conditions with H5ics.
+//
+// % makeICs --geometry=sphere --n1d=1000 --file=./data/noh_ics
+//
+// Writes {file}.hdf5 and {file}.xdmf. The particles are streamed to
+// disk in blocks, so the size of the ICs is not limited by memory.
+//
+#include "H5ics.h"
+
+int main(int argc, char *argv[])
+{
+  int jobStatus= 0;
+
+  int n1d= 128;
+  int neighbors= 32;
+  int blockSize= 1 << 20;
+  int seed= 1;
+  float diameter= 1.0f;
+  float density= 1.0f;
+  float speed= 1.0f;
+  float energy= 0.0f;
+  float jitter= 0.5f;
+  XcString geometry= XcString("disk");
+  XcString placement= XcString("lattice");
+  XcString fileName= XcString("./data/ics");
+
+  XcParameters args;
+  {
+    args.parseCmdLineArguments(argc,argv,
+    "  [--geometry=disk|sphere|box] [--placement=lattice|glass] [--n1d=128] [--size=1.0]\n"
+    "  [--density=1.0] [--speed=1.0] [--energy=0.0] [--neighbors=32] [--jitter=0.5]\n"
+    "  [--seed=1] [--block=1048576] [--file= ./data/ics]");
+
+    args.get_string("geometry",&geometry);
+    args.get_string("placement",&placement);
+    args.get_string("file",&fileName);
+    args.get_int("n1d",&n1d, 2);
+    args.get_int("neighbors",&neighbors, 1);
+    args.get_int("block",&blockSize, 1);
+    args.get_int("seed",&seed, 0);
+    args.get_float("size",&diameter, 0.0f);
+    args.get_float("density",&density, 0.0f);
+    args.get_float("speed",&speed, 0.0f);
+    args.get_float("energy",&energy, 0.0f);
+    args.get_float("jitter",&jitter, 0.0f);
+
+    args.checkCmdLineArguments();
+  }
+
+  H5pio::initH5Library();
+
+  H5ics ics;
+  {
+    const string g(geometry);
+    XcHandleError(g!="disk" && g!="sphere" && g!="box",XCUDA_ERROR,"makeICs","Unknown geometry");
+    ics.setGeometry((g == "disk") ? H5ics::Disk2D : (g == "sphere") ? H5ics::Sphere : H5ics::Box,diameter);
+
+    const string p(placement);
+    XcHandleError(p!="lattice" && p!="glass",XCUDA_ERROR,"makeICs","Unknown placement");
+    ics.setPlacement((p == "glass") ? H5ics::Glass : H5ics::Lattice,n1d,unsigned(seed),jitter);
+
+    ics.setDensity(density);
+    ics.setInflowSpeed(speed);
+    ics.setInternalEnergy(energy);
+    ics.setNeighbors(neighbors);
+    ics.setBlockSize(blockSize);
+  }
+
+  printf("\n");
+  printf("Generating %s ICs on a %d^%d %s\n",geometry,n1d,(string(geometry) == "disk") ? 2 : 3,placement);
+
+  const long nParticles= ics.generate(fileName);
+
+  printf("Saved %ld particles to %s\n",nParticles,fileName);
+
+  H5pio::closeH5Library();
+
+  return jobStatus;
+}
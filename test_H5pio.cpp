@@ -3,7 +3,18 @@
 // Revised: Dec. 31 2022
 // Version: 1.0.0
 //
-#include "H5pio.h"
+#include "H5kdtree.h"
+#include "H5interp.h"
+#include "H5shm.h"
+#include "H5stream.h"
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <random>
+#include <thread>
 
 void initParticles(H5pio &pm, const float time, const float dt)
 {
@@ -49,6 +60,95 @@ bool isClose(int x, int y)
   return bool(abs(x-y) == 0);
 }
 
+// NumPart_ThisFile[type] from the header of fileName
+//
+int fileParticles(XcCString fileName, const int type)
+{
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  int np[H5pio::N_TYPES]= {0};
+  hid_t file_id= H5Fopen(fileName,H5F_ACC_RDONLY,H5P_DEFAULT);
+  if (file_id < 0) return -1;
+
+  hid_t group_id= H5Gopen(file_id,"Header",H5P_DEFAULT);
+  hid_t attribute_id= H5Aopen(group_id,"NumPart_ThisFile",H5P_DEFAULT);
+  H5Aread(attribute_id,H5T_NATIVE_INT,np);
+  H5Aclose(attribute_id);
+  H5Gclose(group_id);
+  H5Fclose(file_id);
+
+  return np[type];
+}
+
+// The values of every dataset and attribute in fileName, keyed by
+// path, with the chunk dimensions and filters of each dataset
+//
+typedef std::map<std::string,std::vector<char>> FrameContents;
+
+FrameContents frameContents(XcCString fileName)
+{
+  std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+  FrameContents contents;
+  hid_t file_id= H5Fopen(fileName,H5F_ACC_RDONLY,H5P_DEFAULT);
+  if (file_id < 0) return contents;
+
+  std::vector<std::string> paths(1,".");
+  H5Ovisit(file_id,H5_INDEX_NAME,H5_ITER_INC,
+    [](hid_t, const char *name, const H5O_info_t *, void *data) -> herr_t {
+      if (strcmp(name,".") != 0) ((std::vector<std::string>*)data)->push_back(name);
+      return 0;
+    },&paths);
+
+  for (const std::string &path : paths) {
+    hid_t object_id= H5Oopen(file_id,path.c_str(),H5P_DEFAULT);
+
+    const int nAttributes= H5Aget_num_attrs(object_id);
+    for (int a=0; a<nAttributes; a++) {
+      hid_t attribute_id= H5Aopen_by_idx(object_id,".",H5_INDEX_NAME,H5_ITER_INC,a,H5P_DEFAULT,H5P_DEFAULT);
+      char name[256];
+      H5Aget_name(attribute_id,sizeof(name),name);
+      hid_t type_id= H5Aget_type(attribute_id);
+      std::vector<char> &value= contents[path + "@" + name];
+      value.resize(H5Aget_storage_size(attribute_id));
+      H5Aread(attribute_id,type_id,value.data());
+      H5Tclose(type_id);
+      H5Aclose(attribute_id);
+    } // endfor(a)
+
+    if (H5Iget_type(object_id) == H5I_DATASET) {
+      hid_t type_id= H5Dget_type(object_id);
+      hid_t dataspace_id= H5Dget_space(object_id);
+      std::vector<char> &value= contents[path];
+      value.resize(H5Sget_simple_extent_npoints(dataspace_id)*H5Tget_size(type_id));
+      H5Dread(object_id,type_id,H5S_ALL,H5S_ALL,H5P_DEFAULT,value.data());
+
+      hid_t dcpl_id= H5Dget_create_plist(object_id);
+      std::vector<char> &layout= contents[path + "#layout"];
+      hsize_t chunk[H5S_MAX_RANK]= {0};
+      if (H5Pget_layout(dcpl_id) == H5D_CHUNKED) H5Pget_chunk(dcpl_id,H5S_MAX_RANK,chunk);
+      layout.assign((char*)chunk,(char*)(chunk + H5S_MAX_RANK));
+      const int nFilters= H5Pget_nfilters(dcpl_id);
+      for (int k=0; k<nFilters; k++) {
+        unsigned flags, values[8];
+        size_t nValues= 8;
+        H5Z_filter_t filter= H5Pget_filter2(dcpl_id,k,&flags,&nValues,values,0,nullptr,nullptr);
+        layout.insert(layout.end(),(char*)&filter,(char*)(&filter + 1));
+        layout.insert(layout.end(),(char*)values,(char*)(values + std::min(nValues,size_t(8))));
+      } // endfor(k)
+
+      H5Pclose(dcpl_id);
+      H5Sclose(dataspace_id);
+      H5Tclose(type_id);
+    } // endif
+
+    H5Oclose(object_id);
+  } // endfor(path)
+
+  H5Fclose(file_id);
+  return contents;
+}
+
 bool checkParticles(H5pio &po, H5pio &pi)
 {
   const unsigned np= pi.getNumberOfParticles(0);
@@ -90,16 +190,18 @@ int main(int argc, char *argv[])
   int jobStatus= 0;
 
   int np= 10;
-  int nFrames= 1;
+  int nFrames= 4;
+  int prefetch= 0;
   XcString saveFile= XcString("./data/H5pio");
 
   XcParameters args;
   {
     args.parseCmdLineArguments(argc,argv,
-    "  [--particles= 10] [--frames=1] [--saveFile= ./data/H5pio]");
+    "  [--particles= 10] [--frames=4] [--prefetch=0] [--saveFile= ./data/H5pio]");
 
     args.get_int("p*articles",&np, 1);
-    args.get_int("frame*s",&nFrames, 1);
+    args.get_int("frame*s",&nFrames, 4);
+    args.get_int("pre*fetch",&prefetch, 0);
     args.get_string("save*File",&saveFile);
 
     args.checkCmdLineArguments();
@@ -174,18 +276,18 @@ int main(int argc, char *argv[])
 
     // do not change the order!
     pi.registerParticles(nParticles,H5pio::Gas);
-    pi.registerFloat1DField(isNodeCentered,"InternalEnergy",energy);
-    pi.registerFloat1DField(isNodeCentered,"Masses",mass);
-    pi.registerInteger1DField(isNodeCentered,"ParticleIDs",pid);
-    pi.registerFloat3DField(isNodeCentered,"Velocities",vel);
-    pi.registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+    pi.registerFloat1DField(isNodeCentered,"InternalEnergy",energy_in);
+    pi.registerFloat1DField(isNodeCentered,"Masses",mass_in);
+    pi.registerInteger1DField(isNodeCentered,"ParticleIDs",pid_in);
+    pi.registerFloat3DField(isNodeCentered,"Velocities",vel_in);
+    pi.registerGeometry3DField(isNodeCentered,"Coordinates",loc_in);
 
     pi.registerParticles(nParticles/2,H5pio::Buldge);
-    pi.registerFloat1DField(isNodeCentered,"Masses",mass);
-    pi.registerFloat3DField(isNodeCentered,"Velocities",vel);
-    pi.registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+    pi.registerFloat1DField(isNodeCentered,"Masses",mass_in);
+    pi.registerFloat3DField(isNodeCentered,"Velocities",vel_in);
+    pi.registerGeometry3DField(isNodeCentered,"Coordinates",loc_in);
 
-    pi.openFiles(saveFile);
+    pi.openFiles(saveFile,prefetch);
     {
       do {
         pi.loadFrame();
@@ -194,13 +296,1481 @@ int main(int argc, char *argv[])
           bool status= checkParticles(po,pi);
           printf("  Loaded %d particles at time %.3f: %s\n",
             pi.getNumberOfParticles(0),pi.frameTime,status?"passed":"failed");
-          if (!status) status= 1; // failed
+          if (!status) jobStatus= 1;
         }
       } while (!pi.endOfFile);
+
+      // random access: last frame by index, then the middle by time
+      //
+      const int nLoaded= pi.getNumberOfFrames();
+      if (nLoaded > 1) {
+        pi.loadFrame(nLoaded);
+        initParticles(po,pi.frameTime,dt);
+        const bool lastOk= isClose(pi.frameTime,1.0f) && checkParticles(po,pi);
+        printf("  Seeked to frame %d at time %.3f: %s\n",nLoaded,pi.frameTime,lastOk?"passed":"failed");
+        if (!lastOk) jobStatus= 1;
+
+        pi.loadFrameAtTime(0.5f);
+        const float tMid= pi.getFrameInfo((nFrames+1)/2).time;
+        initParticles(po,pi.frameTime,dt);
+        const bool midOk= isClose(pi.frameTime,tMid) && checkParticles(po,pi);
+        printf("  Seeked to time %.3f: %s\n",pi.frameTime,midOk?"passed":"failed");
+        if (!midOk) jobStatus= 1;
+      } // endif
     }
     pi.closeFiles();
 
   printf("}\n");
+
+
+  char rawFile[XCUDA_PATH_LENGTH];
+  snprintf(rawFile,XCUDA_PATH_LENGTH,"%s_raw",saveFile);
+
+  printf("\n");
+  printf("Raw data path through: %s\n",rawFile);
+  printf("{\n");
+
+    H5pio pr;
+
+    // do not change the order!
+    pr.registerParticles(nParticles,H5pio::Gas);
+    pr.registerFloat1DField(isNodeCentered,"InternalEnergy",energy_in);
+    pr.registerFloat1DField(isNodeCentered,"Masses",mass_in);
+    pr.registerInteger1DField(isNodeCentered,"ParticleIDs",pid_in);
+    pr.registerFloat3DField(isNodeCentered,"Velocities",vel_in);
+    pr.registerGeometry3DField(isNodeCentered,"Coordinates",loc_in);
+
+    pr.registerParticles(nParticles/2,H5pio::Buldge);
+    pr.registerFloat1DField(isNodeCentered,"Masses",mass_in);
+    pr.registerFloat3DField(isNodeCentered,"Velocities",vel_in);
+    pr.registerGeometry3DField(isNodeCentered,"Coordinates",loc_in);
+
+    initParticles(po,0.5f,dt);
+    po.saveRawFrame(rawFile,0.5f);
+    pr.loadRawFrame(rawFile);
+    {
+      const bool status= isClose(pr.frameTime,0.5f) && checkParticles(po,pr);
+      printf("  Loaded %d raw particles at time %.3f: %s\n",
+        pr.getNumberOfParticles(0),pr.frameTime,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+    // the raw file is plain HDF5: reopen it and read every dataset
+    {
+      char rawName[XCUDA_PATH_LENGTH];
+      snprintf(rawName,XCUDA_PATH_LENGTH,"%s.hdf5",rawFile);
+
+      std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+      hid_t file_id= H5Fopen(rawName,H5F_ACC_RDONLY,H5P_DEFAULT);
+      bool status= (file_id >= 0);
+
+      for (int gid=0; gid<po.dataName.size() && status; gid++) {
+        const int type= po.dataParticleType[gid];
+        const size_t bytes= size_t(po.getNumberOfParticles(type))*po.getItemSize(gid);
+        char path[XCUDA_PATH_LENGTH];
+        snprintf(path,XCUDA_PATH_LENGTH,"PartType%d/%s",type,po.dataName[gid].c_str());
+
+        hid_t dataset_id= H5Dopen(file_id,path,H5P_DEFAULT);
+        status= (dataset_id >= 0);
+        if (!status) break;
+
+        hid_t type_id= H5Dget_type(dataset_id);
+        hid_t native_id= H5Tget_native_type(type_id,H5T_DIR_ASCEND);
+        hid_t dataspace_id= H5Dget_space(dataset_id);
+        std::vector<char> data(size_t(H5Sget_simple_extent_npoints(dataspace_id))*H5Tget_size(native_id));
+
+        status= H5Dread(dataset_id,native_id,H5S_ALL,H5S_ALL,H5P_DEFAULT,data.data()) >= 0 &&
+                data.size() == bytes && memcmp(data.data(),po.dataPointer[gid],bytes) == 0;
+
+        H5Sclose(dataspace_id);
+        H5Tclose(native_id);
+        H5Tclose(type_id);
+        H5Dclose(dataset_id);
+      } // endfor(gid)
+      if (file_id >= 0) H5Fclose(file_id);
+
+      printf("  Reopened %s and read every dataset: %s\n",rawName,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Shared-memory ring to a consumer process\n");
+  printf("{\n");
+
+    char ringName[64];
+    snprintf(ringName,64,"H5pio_test_%d",int(getpid()));
+
+    const int nRingFrames= 3;
+    H5shm producer;
+    producer.create(ringName,po,nRingFrames+1,H5shm::Block);
+
+    fflush(stdout);
+    const pid_t child= fork();
+    if (child == 0) {
+      // consumer: checks each frame, then exits without close(), as
+      // if it crashed while attached
+      //
+      H5shm consumer;
+      consumer.attach(ringName);
+
+      H5pio pc;
+      bool ok= true;
+      for (int f=1; f<=nRingFrames; f++) {
+        ok= ok && (consumer.acquire(pc,10000) == f);
+        if (ok) {
+          initParticles(po,pc.frameTime,dt);
+          ok= checkParticles(po,pc) && consumer.release();
+        } // endif
+      } // endfor(f)
+      _exit(ok ? 0 : 1);
+    } // endif
+
+    for (int f=0; f<nRingFrames; f++) {
+      po.frameTime= 0.25f*f;
+      initParticles(po,po.frameTime,dt);
+      producer.publish(po);
+    } // endfor(f)
+
+    int childStatus= 1;
+    waitpid(child,&childStatus,0);
+    {
+      const bool status= WIFEXITED(childStatus) && WEXITSTATUS(childStatus) == 0;
+      printf("  Consumer acquired %d frames: %s\n",nRingFrames,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+    // the ring is full and the consumer is gone: publish() must not block
+    //
+    for (int f=0; f<2*nRingFrames; f++) producer.publish(po);
+    printf("  Published past a dead consumer: passed\n");
+    producer.close();
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("k-d tree over the gas particles\n");
+  printf("{\n");
+
+    H5kdtree tree;
+    tree.build(po,H5pio::Gas);
+
+    const int k= std::min(8,int(nParticles));
+    const int nq= std::min(200,int(nParticles)); // brute force is checked for these
+    {
+      vector<int> index(size_t(nq)*k);
+      vector<float> dist2(size_t(nq)*k);
+      tree.findNearest(loc,nq,k,index.data(),dist2.data());
+
+      vector<float> radius(nq);
+      for (int q=0; q<nq; q++) radius[q]= sqrtf(dist2[size_t(q)*k+k-1]);
+
+      vector<long> offset;
+      vector<int> within;
+      tree.findWithinRadius(loc,nq,radius.data(),offset,within);
+
+      // the k-th distance, and the count within the radius (up to
+      // rounding at the boundary), by brute force
+      //
+      bool status= true;
+      vector<float> d2(nParticles);
+      for (int q=0; q<nq; q++) {
+        const float r2= radius[q]*radius[q];
+        int nInside= 0, nNear= 0;
+        for (int j=0; j<nParticles; j++) {
+          const XcFloat3 d= loc[j] - loc[q];
+          d2[j]= d.x*d.x + d.y*d.y + d.z*d.z;
+          if (d2[j] < r2*(1.0f-1.0e-4f)) nInside++;
+          if (d2[j] <= r2*(1.0f+1.0e-4f)) nNear++;
+        } // endfor(j)
+        std::nth_element(d2.begin(),d2.begin()+(k-1),d2.end());
+
+        const long nFound= offset[q+1] - offset[q];
+        status= status && isClose(dist2[size_t(q)*k+k-1],d2[k-1]) && nFound >= nInside && nFound <= nNear;
+      } // endfor(q)
+
+      printf("  Nearest %d and within radius for %d particles: %s\n",k,nq,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // derived fields go to the gas, though the buldge was registered last
+      //
+      tree.computeSmoothingLength(po,H5pio::Gas,k);
+      const int gh= po.findField(H5pio::Gas,"SmoothingLength");
+      status= (gh >= 0);
+      for (int q=0; status && q<nq; q++) status= isClose(((float*)po.dataPointer[gh])[q],radius[q]);
+
+      if (status) tree.computeDensity(po,H5pio::Gas);
+      status= status && po.findField(H5pio::Gas,"Density") >= 0 && po.findField(H5pio::Buldge,"Density") < 0;
+
+      printf("  Smoothing length and density of the gas: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // a type without particles gets no derived fields
+      //
+      H5kdtree empty;
+      empty.build(nullptr,0);
+      empty.computeSmoothingLength(po,H5pio::Disk,k);
+      empty.computeDensity(po,H5pio::Disk);
+      status= po.findField(H5pio::Disk,"SmoothingLength") < 0 && po.findField(H5pio::Disk,"Density") < 0;
+
+      printf("  Derived fields of a type without particles: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+  printf("\n");
+  printf("Time interpolation by ParticleIDs\n");
+  printf("{\n");
+
+    {
+      // f0 holds the IDs 0..n-1 in order, f1 the IDs n..1; with q= id/n,
+      // the masses go from q to 2q+1 and the particles move as
+      // x= q + t*t, which the Hermite spline reproduces exactly
+      //
+      const int n= nParticles;
+      vector<int> id0(n), id1(n), idOut(n+1);
+      vector<float> m0(n), m1(n), mOut(n+1), speed(n+1);
+      vector<XcFloat3> x0(n), x1(n), v0(n), v1(n), xOut(n+1), vOut(n+1);
+
+      for (int i=0; i<n; i++) {
+        const float q0= float(i)/float(n);
+        const float q1= float(n-i)/float(n);
+        id0[i]= i;
+        id1[i]= n-i;
+        m0[i]= q0;
+        m1[i]= 2.0f*q1 + 1.0f;
+        x0[i]= XcFloat3(q0,0,0);
+        x1[i]= XcFloat3(q1+1.0f,0,0);
+        v0[i]= XcFloat3(0,0,0);
+        v1[i]= XcFloat3(2,0,0);
+      } // endfor(i)
+
+      H5pio f0, f1, fo;
+      f0.registerParticles(n,H5pio::Gas);
+      f0.registerFloat1DField(isNodeCentered,"Masses",m0.data());
+      f0.registerInteger1DField(isNodeCentered,"ParticleIDs",id0.data());
+      f0.registerFloat3DField(isNodeCentered,"Velocities",v0.data());
+      f0.registerGeometry3DField(isNodeCentered,"Coordinates",x0.data());
+      f0.frameTime= 0.0f;
+
+      f1.registerParticles(n,H5pio::Gas);
+      f1.registerFloat1DField(isNodeCentered,"Masses",m1.data());
+      f1.registerInteger1DField(isNodeCentered,"ParticleIDs",id1.data());
+      f1.registerFloat3DField(isNodeCentered,"Velocities",v1.data());
+      f1.registerGeometry3DField(isNodeCentered,"Coordinates",x1.data());
+      f1.frameTime= 1.0f;
+
+      // derived fields of the output, buffered and not
+      fo.registerParticles(n+1,H5pio::Gas);
+      fo.registerFloat1DField(isNodeCentered,"Masses",mOut.data());
+      fo.registerInteger1DField(isNodeCentered,"ParticleIDs",idOut.data());
+      fo.registerFloat3DField(isNodeCentered,"Velocities",vOut.data());
+      fo.registerGeometry3DField(isNodeCentered,"Coordinates",xOut.data());
+      fo.registerDerived1DField(isNodeCentered,"Speed",H5pio::Speed,vector<float>(),speed.data());
+      fo.registerDerived1DField(isNodeCentered,"Radius",H5pio::Radius);
+
+      const float t= 0.25f;
+      H5interp interp;
+
+      // the expected values at time t, by ID
+      //
+      auto check= [&](const bool hermite) {
+        bool ok= true;
+        for (int k=0; k<fo.nParticles[H5pio::Gas]; k++) {
+          const int id= idOut[k];
+          const float q= float(id)/float(n);
+          if (id == 0) {                // only in f0
+            ok= ok && isClose(mOut[k],m0[0]) && isClose(xOut[k],x0[0]);
+          } else if (id == n) {         // only in f1
+            ok= ok && isClose(mOut[k],m1[0]) && isClose(xOut[k],x1[0]);
+          } else {
+            const float x= hermite ? q + t*t : q + t;
+            ok= ok && id > 0 && id < n &&
+                isClose(mOut[k],q + t*(q+1.0f)) &&
+                isClose(xOut[k],XcFloat3(x,0,0)) &&
+                isClose(vOut[k],XcFloat3(2*t,0,0)) && isClose(speed[k],2*t);
+          } // endif
+        } // endfor(k)
+        return ok;
+      };
+
+      interp.setMissingPolicy(H5interp::Drop);
+      interp.interpolate(f0,f1,t,fo);
+      bool status= fo.nParticles[H5pio::Gas] == n-1 && isClose(fo.frameTime,t) && check(false);
+      printf("  Linear, missing particles dropped: %d particles: %s\n",
+        fo.nParticles[H5pio::Gas],status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      fo.nParticles[H5pio::Gas]= n+1;
+      interp.setMissingPolicy(H5interp::Hold);
+      interp.interpolate(f0,f1,t,fo);
+      status= fo.nParticles[H5pio::Gas] == n+1 && check(false);
+      printf("  Linear, missing particles held: %d particles: %s\n",
+        fo.nParticles[H5pio::Gas],status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      fo.nParticles[H5pio::Gas]= n+1;
+      interp.setMissingPolicy(H5interp::Drop);
+      interp.setHermite(true);
+      interp.interpolate(f0,f1,t,fo);
+      status= fo.nParticles[H5pio::Gas] == n-1 && check(true);
+      printf("  Hermite geometry: %d particles: %s\n",fo.nParticles[H5pio::Gas],status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // the unbuffered derived field is evaluated as the output is saved
+      //
+      char interpFile[XCUDA_PATH_LENGTH];
+      snprintf(interpFile,XCUDA_PATH_LENGTH,"%s_interp",saveFile);
+      status= fo.saveCheckpoint(interpFile,fo.frameTime,true) > 0 || n == 1;
+      printf("  Saved the interpolated frame: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Loading sorted by ParticleIDs\n");
+  printf("{\n");
+
+    {
+      // the IDs are shuffled, and every field is a function of the ID
+      //
+      const int n= nParticles;
+      vector<int> id(n), idIn(n);
+      vector<float> m(n), mIn(n);
+      vector<XcFloat3> x(n), xIn(n);
+
+      for (int i=0; i<n; i++) id[i]= 3*i + 1;
+      std::shuffle(id.begin(),id.end(),std::mt19937(n));
+      for (int i=0; i<n; i++) {
+        m[i]= 0.5f*id[i];
+        x[i]= XcFloat3(id[i],-id[i],2*id[i]);
+      } // endfor(i)
+
+      char sortFile[XCUDA_PATH_LENGTH];
+      snprintf(sortFile,XCUDA_PATH_LENGTH,"%s_sorted",saveFile);
+
+      H5pio ps;
+      ps.registerParticles(n,H5pio::Gas);
+      ps.registerFloat1DField(isNodeCentered,"Masses",m.data());
+      ps.registerInteger1DField(isNodeCentered,"ParticleIDs",id.data());
+      ps.registerGeometry3DField(isNodeCentered,"Coordinates",x.data());
+      ps.openFiles(sortFile);
+      ps.saveFrame(0.0f);
+      ps.saveFrame(1.0f);
+      ps.closeFiles();
+
+      for (int depth=0; depth<=1; depth++) {
+        H5pio pl;
+        pl.registerParticles(n,H5pio::Gas);
+        pl.registerFloat1DField(isNodeCentered,"Masses",mIn.data());
+        pl.registerInteger1DField(isNodeCentered,"ParticleIDs",idIn.data());
+        pl.registerGeometry3DField(isNodeCentered,"Coordinates",xIn.data());
+        pl.setSortByID(true);
+
+        bool status= true;
+        pl.openFiles(sortFile,depth);
+        for (int f=0; f<2; f++) {
+          pl.loadFrame();
+          for (int i=0; i<n; i++) {
+            status= status && idIn[i] == 3*i + 1 && isClose(mIn[i],0.5f*idIn[i]) &&
+                    isClose(xIn[i],XcFloat3(idIn[i],-idIn[i],2*idIn[i]));
+          } // endfor(i)
+        } // endfor(f)
+        pl.closeFiles();
+
+        printf("  Loaded %d shuffled particles%s: %s\n",n,depth?" with prefetch":"",status?"passed":"failed");
+        if (!status) jobStatus= 1;
+      } // endfor(depth)
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Zone maps and filtered loads\n");
+  printf("{\n");
+
+    {
+      const int n= nParticles;
+      vector<float> u(n), m(n), uIn(n), mIn(n);
+      vector<XcFloat3> x(n), xIn(n);
+      for (int i=0; i<n; i++) {
+        u[i]= 2.0f*i;
+        m[i]= float(i);
+        x[i]= XcFloat3(i,0,-i);
+      } // endfor(i)
+
+      // all the ranges must hold
+      const vector<H5pio::Range> where= {{"Masses",0.25*n,0.5*n},{"InternalEnergy",0.0,0.8*n}};
+      vector<int> expected;
+      for (int i=0; i<n; i++) {
+        if (m[i] >= 0.25*n && m[i] <= 0.5*n && u[i] <= 0.8*n) expected.push_back(i);
+      } // endfor(i)
+
+      // with zone maps over several chunks, and without (all chunks read)
+      //
+      for (int withMaps=1; withMaps>=0; withMaps--) {
+        char zoneFile[XCUDA_PATH_LENGTH];
+        snprintf(zoneFile,XCUDA_PATH_LENGTH,"%s_%s",saveFile,withMaps ? "zones" : "nozones");
+
+        H5pio pz;
+        pz.registerParticles(n,H5pio::Gas);
+        pz.registerFloat1DField(isNodeCentered,"InternalEnergy",u.data());
+        pz.registerFloat1DField(isNodeCentered,"Masses",m.data());
+        pz.registerGeometry3DField(isNodeCentered,"Coordinates",x.data());
+        pz.setChunkRows(std::max(1,n/8));
+        if (withMaps) {
+          pz.enableZoneMap("Masses");
+          pz.enableZoneMap("InternalEnergy");
+        } // endif
+        pz.openFiles(zoneFile);
+        pz.saveFrame(0.5f);
+        pz.closeFiles();
+
+        H5pio pw;
+        pw.registerParticles(n,H5pio::Gas);
+        pw.registerFloat1DField(isNodeCentered,"InternalEnergy",uIn.data());
+        pw.registerFloat1DField(isNodeCentered,"Masses",mIn.data());
+        pw.registerGeometry3DField(isNodeCentered,"Coordinates",xIn.data());
+        pw.openFiles(zoneFile);
+        const int nSelected= pw.loadFrameWhere(1,H5pio::Gas,where);
+        pw.closeFiles();
+
+        bool status= (nSelected == expected.size() && pw.nParticles[H5pio::Gas] == nSelected) &&
+                     isClose(pw.frameTime,0.5f);
+        for (int k=0; status && k<nSelected; k++) {
+          const int i= expected[k];
+          status= isClose(mIn[k],m[i]) && isClose(uIn[k],u[i]) && isClose(xIn[k],x[i]);
+        } // endfor(k)
+
+        printf("  Selected %d of %d particles %s zone maps: %s\n",nSelected,n,withMaps ? "with" : "without",
+          status?"passed":"failed");
+        if (!status) jobStatus= 1;
+      } // endfor(withMaps)
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Summary statistics\n");
+  printf("{\n");
+
+    {
+      // frame f holds f*i, except a NaN and an infinity, which are left out
+      //
+      const int n= nParticles;
+      const int nBins= 4;
+      const int nBad= (n >= 3) ? 2 : 0;
+      vector<float> u(n);
+      vector<XcFloat3> x(n);
+
+      char statsFile[XCUDA_PATH_LENGTH];
+      snprintf(statsFile,XCUDA_PATH_LENGTH,"%s_stats",saveFile);
+
+      H5pio pt;
+      pt.registerParticles(n,H5pio::Gas);
+      pt.registerFloat1DField(isNodeCentered,"InternalEnergy",u.data());
+      pt.registerGeometry3DField(isNodeCentered,"Coordinates",x.data());
+      pt.setStatistics(true,nBins);
+
+      pt.openFiles(statsFile);
+      for (int f=1; f<=2; f++) {
+        for (int i=0; i<n; i++) {
+          u[i]= float(f*i);
+          x[i]= XcFloat3(f*i,-f*i,1);
+        } // endfor(i)
+        if (nBad > 0) {
+          u[0]= NAN;
+          u[1]= INFINITY;
+        } // endif
+        pt.saveFrame(float(f));
+      } // endfor(f)
+      pt.closeFiles();
+
+      vector<H5pio::Statistics> su, sx;
+      pt.openFiles(statsFile);
+      pt.readStatistics(H5pio::Gas,"InternalEnergy",su);
+      pt.readStatistics(H5pio::Gas,"Coordinates",sx);
+      pt.closeFiles();
+
+      bool status= (su.size() == 2 && sx.size() == 2);
+      for (int k=0; status && k<2; k++) {
+        const int f= k+1;
+        double sum= 0.0;
+        for (int i=nBad; i<n; i++) sum += double(f*i);
+        long long counted= 0;
+        for (int b=0; b<su[k].histogram.size(); b++) counted += su[k].histogram[b];
+
+        status= su[k].frameID == f && isClose(su[k].time,float(f)) && su[k].dof == 1 &&
+                su[k].minimum[0] == f*nBad && su[k].maximum[0] == f*(n-1) &&
+                fabs(su[k].sum[0] - sum) <= 1.0e-6*sum && fabs(su[k].mean[0] - sum/(n-nBad)) <= 1.0e-6*sum &&
+                su[k].histogram.size() == nBins && counted == n-nBad;
+
+        status= status && sx[k].dof == 3 && sx[k].histogram.size() == 3*nBins &&
+                sx[k].minimum[0] == 0 && sx[k].maximum[0] == f*(n-1) &&
+                sx[k].minimum[1] == -f*(n-1) && sx[k].maximum[1] == 0 &&
+                sx[k].mean[2] == 1 && sx[k].sum[2] == n;
+      } // endfor(k)
+
+      printf("  Read the statistics of %d frames: %s\n",int(su.size()),status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Streamed writing and subset export\n");
+  printf("{\n");
+
+    {
+      // nBlocks blocks of at most nb rows, row i holding Masses i
+      //
+      const int n= nParticles;
+      const int nb= std::max(1,n/3);
+      vector<float> mb(nb), m(n);
+      vector<int> idb(nb), id(n);
+      vector<XcFloat3> xb(nb), x(n);
+
+      char streamFile[XCUDA_PATH_LENGTH], exportFile[XCUDA_PATH_LENGTH], subsetFile[XCUDA_PATH_LENGTH];
+      snprintf(streamFile,XCUDA_PATH_LENGTH,"%s_stream.hdf5",saveFile);
+      snprintf(exportFile,XCUDA_PATH_LENGTH,"%s_export.hdf5",saveFile);
+      snprintf(subsetFile,XCUDA_PATH_LENGTH,"%s_subset.hdf5",saveFile);
+
+      H5pio ps;
+      ps.registerParticles(nb,H5pio::Gas);
+      ps.registerFloat1DField(isNodeCentered,"Masses",mb.data());
+      ps.registerInteger1DField(isNodeCentered,"ParticleIDs",idb.data());
+      ps.registerGeometry3DField(isNodeCentered,"Coordinates",xb.data());
+      {
+        std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+        ps.openH5File(streamFile,true);
+        for (int i0=0; i0<n; i0+=nb) {
+          const int rows= std::min(nb,n-i0);
+          for (int i=0; i<rows; i++) {
+            mb[i]= float(i0+i);
+            idb[i]= i0+i;
+            xb[i]= XcFloat3(i0+i,1,2);
+          } // endfor(i)
+          ps.appendH5Block(H5pio::Gas,rows);
+        } // endfor(i0)
+        ps.endH5Stream(1.5f);
+        ps.closeH5File();
+      }
+
+      H5pio pr;
+      pr.registerParticles(n,H5pio::Gas);
+      pr.registerFloat1DField(isNodeCentered,"Masses",m.data());
+      pr.registerInteger1DField(isNodeCentered,"ParticleIDs",id.data());
+      pr.registerGeometry3DField(isNodeCentered,"Coordinates",x.data());
+
+      bool status= (fileParticles(streamFile,H5pio::Gas) == n);
+      if (status) {
+        std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+        pr.openH5File(streamFile,false);
+        pr.loadH5Frame();
+        pr.closeH5File();
+      }
+      for (int i=0; status && i<n; i++) {
+        status= m[i] == i && id[i] == i && isClose(x[i],XcFloat3(i,1,2));
+      } // endfor(i)
+
+      printf("  Streamed %d rows in blocks of %d: %s\n",n,nb,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // Masses in [lo,hi] keeps rows lo..hi, in memory and streamed
+      //
+      const int lo= n/4;
+      const int hi= n/2;
+      const int nSel= hi-lo+1;
+      const vector<H5pio::Range> where= { {"Masses",float(lo),float(hi)} };
+
+      pr.exportFrame(exportFile,where);
+      H5stream::exportSubset(streamFile,subsetFile,where,size_t(nb)*64);
+
+      XcCString outFile[2]= {exportFile,subsetFile};
+      XcCString outName[2]= {"exportFrame()","H5stream::exportSubset()"};
+
+      for (int k=0; k<2; k++) {
+        status= (fileParticles(outFile[k],H5pio::Gas) == nSel);
+        if (status) {
+          std::fill(m.begin(),m.end(),-1.0f);
+          pr.nParticles[H5pio::Gas]= nSel;
+
+          std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+          pr.openH5File(outFile[k],false);
+          pr.loadH5Frame();
+          pr.closeH5File();
+        }
+        for (int i=0; status && i<nSel; i++) {
+          status= m[i] == lo+i && id[i] == lo+i && isClose(x[i],XcFloat3(lo+i,1,2));
+        } // endfor(i)
+
+        printf("  Exported %d of %d rows with %s: %s\n",nSel,n,outName[k],status?"passed":"failed");
+        if (!status) jobStatus= 1;
+      } // endfor(k)
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Derived fields\n");
+  printf("{\n");
+
+    {
+      // with u= x= (i%1000)/8 every derived value is exact: Temperature
+      // 3u (buffered), Radius x and a custom 2u+1 (both unbuffered)
+      //
+      const int n= nParticles;
+      vector<float> u(n), temperature(n), uIn(n), tIn(n), rIn(n), cIn(n);
+      vector<XcFloat3> x(n), xIn(n);
+      for (int i=0; i<n; i++) {
+        u[i]= float(i%1000)/8.0f;
+        x[i]= XcFloat3(u[i],3,4);
+      } // endfor(i)
+
+      const H5pio::DerivedKernel affine= [](const int nRows, const float *const in[], float *out, const float *param) {
+        for (int i=0; i<nRows; i++) out[i]= param[0]*in[0][i] + param[1];
+      };
+
+      char derivedFile[XCUDA_PATH_LENGTH];
+      snprintf(derivedFile,XCUDA_PATH_LENGTH,"%s_derived",saveFile);
+
+      H5pio pd;
+      pd.registerParticles(n,H5pio::Gas);
+      pd.registerFloat1DField(isNodeCentered,"InternalEnergy",u.data());
+      pd.registerGeometry3DField(isNodeCentered,"Coordinates",x.data());
+      pd.registerDerived1DField(isNodeCentered,"Temperature",H5pio::Temperature,{2.0f,3.0f},temperature.data());
+      pd.registerDerived1DField(isNodeCentered,"Radius",H5pio::Radius,{0.0f,3.0f,4.0f});
+      pd.registerDerived1DField(isNodeCentered,"Affine",{"InternalEnergy"},affine,{2.0f,1.0f});
+      pd.setChunkRows(std::max(1,n/4)); // several chunks of the unbuffered fields
+
+      pd.openFiles(derivedFile);
+      pd.saveFrame(0.0f);
+      pd.closeFiles();
+
+      bool status= true;
+      for (int i=0; status && i<n; i++) status= (temperature[i] == 3.0f*u[i]);
+
+      printf("  Buffered field evaluated on save: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // the saved datasets, read as plain fields
+      //
+      H5pio pr;
+      pr.registerParticles(n,H5pio::Gas);
+      pr.registerFloat1DField(isNodeCentered,"InternalEnergy",uIn.data());
+      pr.registerGeometry3DField(isNodeCentered,"Coordinates",xIn.data());
+      pr.registerFloat1DField(isNodeCentered,"Temperature",tIn.data());
+      pr.registerFloat1DField(isNodeCentered,"Radius",rIn.data());
+      pr.registerFloat1DField(isNodeCentered,"Affine",cIn.data());
+      pr.openFiles(derivedFile);
+      pr.loadFrame(1);
+      pr.closeFiles();
+
+      status= true;
+      for (int i=0; status && i<n; i++) {
+        status= tIn[i] == 3.0f*u[i] && rIn[i] == u[i] && cIn[i] == 2.0f*u[i] + 1.0f;
+      } // endfor(i)
+
+      printf("  Buffered and unbuffered fields read back: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // a derived field is evaluated after a load, not read
+      //
+      H5pio pe;
+      pe.registerParticles(n,H5pio::Gas);
+      pe.registerFloat1DField(isNodeCentered,"InternalEnergy",uIn.data());
+      pe.registerDerived1DField(isNodeCentered,"Temperature",H5pio::Temperature,{2.0f,5.0f},tIn.data());
+      pe.openFiles(derivedFile);
+      pe.loadFrame(1);
+      pe.closeFiles();
+
+      status= true;
+      for (int i=0; status && i<n; i++) status= (tIn[i] == 5.0f*u[i]);
+
+      printf("  Buffered field evaluated on load: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Levels of detail\n");
+  printf("{\n");
+
+    {
+      // each level keeps ceil(n/4^level) particles, and the total mass
+      //
+      const int n= nParticles;
+      const int factor= 4;
+      vector<float> m(n);
+      vector<int> id(n);
+      vector<XcFloat3> x(n);
+
+      double totalMass= 0.0;
+      for (int i=0; i<n; i++) {
+        m[i]= float(1 + i%3);
+        id[i]= i;
+        x[i]= XcFloat3(i%17,i%13,i);
+        totalMass += m[i];
+      } // endfor(i)
+
+      char lodFile[XCUDA_PATH_LENGTH];
+      snprintf(lodFile,XCUDA_PATH_LENGTH,"%s_lod",saveFile);
+
+      H5pio pl;
+      pl.registerParticles(n,H5pio::Gas);
+      pl.registerFloat1DField(isNodeCentered,"Masses",m.data());
+      pl.registerInteger1DField(isNodeCentered,"ParticleIDs",id.data());
+      pl.registerGeometry3DField(isNodeCentered,"Coordinates",x.data());
+      pl.setLevelsOfDetail(2,factor);
+      pl.openFiles(lodFile);
+      pl.saveFrame(0.0f);
+      pl.closeFiles();
+
+      // coarse, then fine without resetting nParticles[], then a
+      // level that was not written
+      //
+      const int levels[3]= {2,1,3};
+      pl.openFiles(lodFile);
+      for (int k=0; k<3; k++) {
+        const int level= levels[k];
+        long stride= 1;
+        for (int l=0; l<level; l++) stride *= factor;
+        const int expected= (level <= 2 && stride <= n) ? int((n + stride - 1)/stride) : 0;
+
+        const int nLoaded= pl.loadFrameLevel(1,level);
+        const int nl= pl.nParticles[H5pio::Gas];
+
+        double mass= 0.0;
+        vector<bool> seen(n,false);
+        bool status= (nLoaded == expected && nl == expected);
+        for (int i=0; status && i<nl; i++) {
+          const int j= id[i];
+          status= j >= 0 && j < n && !seen[j] && isClose(x[i],XcFloat3(j%17,j%13,j));
+          if (status) seen[j]= true;
+          mass += m[i];
+        } // endfor(i)
+        if (expected > 0) status= status && fabs(mass - totalMass) <= 1.0e-5*totalMass;
+
+        printf("  Level %d holds %d of %d particles: %s\n",level,nl,n,status?"passed":"failed");
+        if (!status) jobStatus= 1;
+      } // endfor(k)
+
+      // the full frame, once nParticles[] is back to the registered count
+      //
+      pl.nParticles[H5pio::Gas]= pl.registeredParticles[H5pio::Gas];
+      pl.loadFrame(1);
+      pl.closeFiles();
+
+      bool status= true;
+      for (int i=0; status && i<n; i++) status= (id[i] == i && m[i] == float(1 + i%3));
+
+      printf("  Full frame after the levels: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Subfiles stitched by virtual datasets\n");
+  printf("{\n");
+
+    {
+      // frame f holds Masses f*i, written through 3 subfiles with
+      // statistics, a zone map and one level of detail
+      //
+      const int n= nParticles;
+      const int nWriters= 3;
+      vector<float> m(n), mIn(n);
+      vector<int> id(n), idIn(n);
+      vector<XcFloat3> x(n), xIn(n);
+
+      char subFile[XCUDA_PATH_LENGTH];
+      snprintf(subFile,XCUDA_PATH_LENGTH,"%s_sub",saveFile);
+
+      H5pio pw;
+      pw.registerParticles(n,H5pio::Gas);
+      pw.registerFloat1DField(isNodeCentered,"Masses",m.data());
+      pw.registerInteger1DField(isNodeCentered,"ParticleIDs",id.data());
+      pw.registerGeometry3DField(isNodeCentered,"Coordinates",x.data());
+      pw.setStatistics(true,4);
+      pw.enableZoneMap("Masses");
+      pw.setLevelsOfDetail(1,2);
+      pw.setChunkRows(std::max(1,n/8));
+
+      pw.openFiles(subFile);
+      for (int f=1; f<=2; f++) {
+        for (int i=0; i<n; i++) {
+          m[i]= float(f*i);
+          id[i]= i;
+          x[i]= XcFloat3(i,f,0);
+        } // endfor(i)
+        pw.saveFrameSubfiles(float(f),nWriters);
+      } // endfor(f)
+      pw.closeFiles();
+
+      H5pio pr;
+      pr.registerParticles(n,H5pio::Gas);
+      pr.registerFloat1DField(isNodeCentered,"Masses",mIn.data());
+      pr.registerInteger1DField(isNodeCentered,"ParticleIDs",idIn.data());
+      pr.registerGeometry3DField(isNodeCentered,"Coordinates",xIn.data());
+      pr.openFiles(subFile);
+
+      pr.loadFrame(2);
+      bool status= true;
+      for (int i=0; status && i<n; i++) status= mIn[i] == 2*i && idIn[i] == i && isClose(xIn[i],XcFloat3(i,2,0));
+
+      printf("  Frame read through %d subfiles: %s\n",nWriters,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      vector<H5pio::Statistics> sm;
+      pr.readStatistics(H5pio::Gas,"Masses",sm);
+      status= (sm.size() == 2);
+      for (int k=0; status && k<2; k++) {
+        status= sm[k].maximum[0] == (k+1)*(n-1) && sm[k].histogram.size() == 4;
+      } // endfor(k)
+
+      printf("  Statistics of %d subfiled frames: %s\n",int(sm.size()),status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      const int hi= n/3;
+      const int nSelected= pr.loadFrameWhere(1,H5pio::Gas,{ {"Masses",0.0,double(hi)} });
+      status= (nSelected == hi+1);
+      for (int i=0; status && i<nSelected; i++) status= (mIn[i] == i && idIn[i] == i);
+
+      printf("  Filtered load of a subfiled frame: %d particles: %s\n",nSelected,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      const int nLevel= pr.loadFrameLevel(1,1);
+      double mass= 0.0;
+      for (int i=0; i<nLevel; i++) mass += mIn[i];
+      const double total= 0.5*double(n)*double(n-1);
+      status= (n < 2 || nLevel == (n+1)/2) && fabs(mass-total) <= 1.0e-5*total;
+
+      printf("  Level of detail of a subfiled frame: %d particles: %s\n",nLevel,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      pr.closeFiles();
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("SWMR live file\n");
+  printf("{\n");
+
+    {
+      // frame f holds n*f/3 particles with Masses 1000*f + i; the reader
+      // polls after frame 1, again at once, then after frames 2 and 3
+      //
+      const int n= nParticles;
+      vector<float> m(n);
+      vector<int> id(n);
+
+      char liveFile[XCUDA_PATH_LENGTH];
+      snprintf(liveFile,XCUDA_PATH_LENGTH,"%s_live.hdf5",saveFile);
+
+      int toReader[2], toWriter[2];
+      bool status= (pipe(toReader) == 0 && pipe(toWriter) == 0);
+      char token= 0;
+
+      fflush(stdout);
+      const pid_t child= status ? fork() : -1;
+      if (child == 0) {
+        H5pio pr;
+        pr.registerParticles(n,H5pio::Gas);
+        pr.registerFloat1DField(isNodeCentered,"Masses",m.data());
+        pr.registerInteger1DField(isNodeCentered,"ParticleIDs",id.data());
+
+        auto check= [&](const int f) {
+          bool ok= pr.nParticles[H5pio::Gas] == std::max(1,n*f/3) && isClose(pr.frameTime,float(f));
+          for (int i=0; ok && i<pr.nParticles[H5pio::Gas]; i++) ok= (m[i] == 1000*f + i && id[i] == i);
+          return ok;
+        };
+
+        bool ok= (read(toReader[0],&token,1) == 1);
+        pr.openLiveFile(liveFile,false);
+        ok= ok && pr.loadLatestFrame() == 1 && check(1);
+        ok= ok && pr.loadLatestFrame() == 0 && check(1);
+        ok= ok && write(toWriter[1],&token,1) == 1;
+
+        ok= ok && (read(toReader[0],&token,1) == 1);
+        ok= ok && pr.loadLatestFrame() == 3 && check(3);
+        pr.closeLiveFile();
+        _exit(ok ? 0 : 1);
+      } // endif
+
+      H5pio pw;
+      pw.registerParticles(n,H5pio::Gas);
+      pw.registerFloat1DField(isNodeCentered,"Masses",m.data());
+      pw.registerInteger1DField(isNodeCentered,"ParticleIDs",id.data());
+
+      auto append= [&](const int f) {
+        pw.nParticles[H5pio::Gas]= std::max(1,n*f/3);
+        for (int i=0; i<n; i++) {
+          m[i]= float(1000*f + i);
+          id[i]= i;
+        } // endfor(i)
+        pw.appendLiveFrame(float(f));
+      };
+
+      if (child > 0) {
+        pw.openLiveFile(liveFile,true);
+        append(1);
+        status= (write(toReader[1],&token,1) == 1) && (read(toWriter[0],&token,1) == 1);
+        append(2);
+        append(3);
+        status= status && (write(toReader[1],&token,1) == 1);
+        pw.closeLiveFile();
+
+        int childStatus= 1;
+        waitpid(child,&childStatus,0);
+        status= status && WIFEXITED(childStatus) && WEXITSTATUS(childStatus) == 0;
+      } // endif
+
+      printf("  Reader polled 1, 0, 3 across the appends: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("In-memory file images\n");
+  printf("{\n");
+
+    {
+      const float tImage= 0.75f;
+      initParticles(po,tImage,dt);
+
+      vector<char> image;
+      po.saveFrameImage(tImage,image);
+
+      initParticles(pi,0.0f,dt); // overwritten by the load
+      pi.loadFrameImage(image.data(),image.size());
+      initParticles(po,pi.frameTime,dt);
+      bool status= image.size() > 0 && isClose(pi.frameTime,tImage) && checkParticles(po,pi);
+
+      printf("  Loaded a %d-byte image at time %.3f: %s\n",int(image.size()),pi.frameTime,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // the image stored as a file reads as any snapshot
+      //
+      char imageFile[XCUDA_PATH_LENGTH];
+      snprintf(imageFile,XCUDA_PATH_LENGTH,"%s_image.hdf5",saveFile);
+      po.writeFrameImage(imageFile,image);
+
+      initParticles(pi,0.0f,dt);
+      float tFile;
+      {
+        std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+        pi.openH5File(imageFile,false);
+        pi.loadH5Frame();
+        tFile= pi.frameTime; // closeH5File() resets it
+        pi.closeH5File();
+      }
+      status= isClose(tFile,tImage) && checkParticles(po,pi);
+
+      printf("  Loaded the image written to %s: %s\n",imageFile,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("I/O profiles\n");
+  printf("{\n");
+
+    {
+      // a series written with paged file space reads back with and
+      // without the profile, and the profiled reader still reads the
+      // unpaged series written above
+      //
+      char profiledFile[XCUDA_PATH_LENGTH];
+      snprintf(profiledFile,XCUDA_PATH_LENGTH,"%s_nvme",saveFile);
+
+      H5pio pn(H5pio::NVMe);
+      pn.registerParticles(nParticles,H5pio::Gas);
+      pn.registerFloat1DField(isNodeCentered,"InternalEnergy",energy);
+      pn.registerFloat1DField(isNodeCentered,"Masses",mass);
+      pn.registerInteger1DField(isNodeCentered,"ParticleIDs",pid);
+      pn.registerFloat3DField(isNodeCentered,"Velocities",vel);
+      pn.registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+      pn.registerParticles(nParticles/2,H5pio::Buldge);
+      pn.registerFloat1DField(isNodeCentered,"Masses",mass);
+      pn.registerFloat3DField(isNodeCentered,"Velocities",vel);
+      pn.registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+
+      pn.openFiles(profiledFile);
+      for (int f=0; f<2; f++) {
+        initParticles(po,0.5f*f,dt);
+        pn.saveFrame(0.5f*f);
+      } // endfor(f)
+      pn.closeFiles();
+
+      char frameName[XCUDA_PATH_LENGTH];
+      snprintf(frameName,XCUDA_PATH_LENGTH,"%s_0002.hdf5",profiledFile);
+      H5F_fspace_strategy_t strategy= H5F_FSPACE_STRATEGY_FSM_AGGR;
+      {
+        std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+        hid_t file_id= H5Fopen(frameName,H5F_ACC_RDONLY,H5P_DEFAULT);
+        hid_t fcpl_id= H5Fget_create_plist(file_id);
+        H5Pget_file_space_strategy(fcpl_id,&strategy,nullptr,nullptr);
+        H5Pclose(fcpl_id);
+        H5Fclose(file_id);
+      }
+
+      bool status= pn.getIOProfile().pageBytes > 0 && strategy == H5F_FSPACE_STRATEGY_PAGE;
+      printf("  Frames written with paged file space: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      H5pio pd(H5pio::DefaultProfile);
+      XcCString series[2]= {profiledFile,saveFile};
+
+      for (int k=0; k<2; k++) {
+        H5pio &reader= (k == 0) ? pd : pn;
+        reader.openFiles(series[k]);
+        const int nSeries= reader.getNumberOfFrames();
+        reader.closeFiles();
+
+        pi.setIOProfile(reader.getIOProfile());
+        pi.openFiles(series[k]);
+        pi.loadFrame(2);
+        pi.closeFiles();
+
+        initParticles(po,pi.frameTime,dt);
+        status= nSeries >= 2 && checkParticles(po,pi);
+
+        printf("  Read %s with the %s profile: %s\n",series[k],(k == 0) ? "default" : "NVMe",status?"passed":"failed");
+        if (!status) jobStatus= 1;
+      } // endfor(k)
+
+      pi.setIOProfile(H5pio::environmentIOProfile());
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Compression autotuning\n");
+  printf("{\n");
+
+    {
+      char tunedFile[XCUDA_PATH_LENGTH], tuneName[XCUDA_PATH_LENGTH];
+      snprintf(tunedFile,XCUDA_PATH_LENGTH,"%s_tuned",saveFile);
+      snprintf(tuneName,XCUDA_PATH_LENGTH,"%s.tune",tunedFile);
+      remove(tuneName);
+
+      auto registerAll= [&](H5pio &pt) {
+        pt.registerParticles(nParticles,H5pio::Gas);
+        pt.registerFloat1DField(isNodeCentered,"InternalEnergy",energy);
+        pt.registerFloat1DField(isNodeCentered,"Masses",mass);
+        pt.registerInteger1DField(isNodeCentered,"ParticleIDs",pid);
+        pt.registerFloat3DField(isNodeCentered,"Velocities",vel);
+        pt.registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+        pt.registerParticles(nParticles/2,H5pio::Buldge);
+        pt.registerFloat1DField(isNodeCentered,"Masses",mass);
+        pt.registerFloat3DField(isNodeCentered,"Velocities",vel);
+        pt.registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+      };
+
+      // the first run tunes every field and writes the .tune file
+      //
+      {
+        H5pio pt;
+        registerAll(pt);
+        pt.setAutotune(true,H5pio::MinSize);
+        pt.openFiles(tunedFile);
+        initParticles(po,0.0f,dt);
+        pt.saveFrame(0.0f);
+        pt.closeFiles();
+      }
+
+      vector<string> lines;
+      {
+        FILE *fp= fopen(tuneName,"r");
+        char line[XCUDA_PATH_LENGTH];
+        while (fp != nullptr && fgets(line,XCUDA_PATH_LENGTH,fp)) lines.push_back(string(line));
+        if (fp != nullptr) fclose(fp);
+      }
+      bool status= (lines.size() == 1+8); // a comment, then 5 gas and 3 buldge fields
+
+      printf("  Tuned %d fields into %s: %s\n",int(lines.size())-1,tuneName,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // a later run reuses the file: an edited entry is applied, not retuned
+      //
+      {
+        FILE *fp= fopen(tuneName,"w");
+        for (int k=0; fp != nullptr && k<lines.size(); k++) {
+          if (lines[k].compare(0,17,"PartType0/Masses ") == 0) {
+            fprintf(fp,"PartType0/Masses 1 1 7\n");
+          } else {
+            fputs(lines[k].c_str(),fp);
+          }
+        } // endfor(k)
+        if (fp != nullptr) fclose(fp);
+      }
+
+      H5pio pt;
+      registerAll(pt);
+      pt.setAutotune(true,H5pio::MinSize);
+      pt.openFiles(tunedFile);
+      for (int f=0; f<2; f++) {
+        initParticles(po,0.5f*f,dt);
+        pt.saveFrame(0.5f*f);
+      } // endfor(f)
+      pt.closeFiles();
+
+      const H5pio::Compression c= pt.getCompression(H5pio::Gas,"Masses");
+
+      char frameName[XCUDA_PATH_LENGTH];
+      snprintf(frameName,XCUDA_PATH_LENGTH,"%s_0002.hdf5",tunedFile);
+      hsize_t chunk[2]= {0,0};
+      bool hasDeflate= false;
+      {
+        std::lock_guard<std::mutex> lock(H5pio::h5Mutex);
+
+        hid_t file_id= H5Fopen(frameName,H5F_ACC_RDONLY,H5P_DEFAULT);
+        hid_t dataset_id= H5Dopen(file_id,"PartType0/Masses",H5P_DEFAULT);
+        hid_t plist_id= H5Dget_create_plist(dataset_id);
+        H5Pget_chunk(plist_id,2,chunk);
+        hasDeflate= H5Pget_filter_by_id2(plist_id,H5Z_FILTER_DEFLATE,nullptr,nullptr,nullptr,0,nullptr,nullptr) >= 0;
+        H5Pclose(plist_id);
+        H5Dclose(dataset_id);
+        H5Fclose(file_id);
+      }
+      status= c.level == 1 && c.shuffle && c.chunkRows == 7 &&
+              chunk[0] == std::min(7,int(nParticles)) && hasDeflate;
+
+      printf("  Reused the .tune file (Masses: level %d, chunks of %d): %s\n",c.level,int(chunk[0]),status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // tuned frames read back as written
+      //
+      pi.openFiles(tunedFile);
+      status= (pi.getNumberOfFrames() == 2);
+      for (int f=1; status && f<=2; f++) {
+        pi.loadFrame(f);
+        initParticles(po,pi.frameTime,dt);
+        status= isClose(pi.frameTime,0.5f*(f-1)) && checkParticles(po,pi);
+      } // endfor(f)
+      pi.closeFiles();
+
+      printf("  Read back the tuned frames: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("I/O budget\n");
+  printf("{\n");
+
+    {
+      // with a tenth of the wall time, a frame saved right after the
+      // first full one is skipped; once the budget has built up it
+      // has room for a downsampled frame but not for a cheap one.
+      // The log records each decision and the costs behind it.
+      //
+      const float fraction= 0.1f;
+      const int stride= 4;
+
+      char budgetFile[XCUDA_PATH_LENGTH], logName[XCUDA_PATH_LENGTH];
+      snprintf(budgetFile,XCUDA_PATH_LENGTH,"%s_budget",saveFile);
+      snprintf(logName,XCUDA_PATH_LENGTH,"%s.iolog",budgetFile);
+      remove(logName);
+
+      // the last decision in the log and the time spent so far
+      auto lastLogLine= [&](char *mode, int &frameID, double &cost, double &spent) {
+        int n= 0;
+        FILE *fp= fopen(logName,"r");
+        if (fp == nullptr) return n;
+
+        char line[256];
+        while (fgets(line,sizeof(line),fp) != nullptr) {
+          if (line[0] == '#') continue;
+          float time;
+          int isCheckpoint;
+          double estimate, elapsed;
+          if (sscanf(line,"%d %f %15s %d %lf %lf %lf %lf",&frameID,&time,mode,&isCheckpoint,
+                     &estimate,&cost,&elapsed,&spent) == 8) n++;
+        } // endwhile
+        fclose(fp);
+        return n;
+      };
+
+      initParticles(po,0.0f,dt);
+      po.openFiles(budgetFile);
+      const auto start= std::chrono::steady_clock::now();
+      po.setIOBudget(fraction,stride,logName);
+
+      char mode[3][16];
+      int frameID[3], nLines= 0;
+      double cost, spent;
+
+      po.saveFrame(0.0f);
+      H5pio::BUDGET_MODE first= po.getBudgetMode();
+      nLines= lastLogLine(mode[0],frameID[0],cost,spent);
+      const double fullCost= cost;
+
+      po.saveFrame(0.5f);
+      H5pio::BUDGET_MODE second= po.getBudgetMode();
+      nLines= lastLogLine(mode[1],frameID[1],cost,spent);
+
+      // wait until the allowance, fraction*elapsed - spent, is a third
+      // of the way from the downsampled estimate to the cheap one
+      const double cheapCost= 0.5*fullCost;
+      const double sampledCost= cheapCost/stride;
+      const double allowance= (1.0-fraction)*(sampledCost + 0.3*(cheapCost - sampledCost));
+      const double wait= (spent + allowance)/fraction;
+      while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < wait) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      } // endwhile
+
+      po.saveFrame(1.0f);
+      H5pio::BUDGET_MODE third= po.getBudgetMode();
+      nLines= lastLogLine(mode[2],frameID[2],cost,spent);
+      po.closeFiles();
+      po.setIOBudget(0.0f);
+
+      bool status= first == H5pio::FullFrame && second == H5pio::SkippedFrame && third == H5pio::DownsampledFrame;
+      printf("  Full, skipped and downsampled frames: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      status= nLines == 3 &&
+              strcmp(mode[0],"full") == 0 && frameID[0] == 1 &&
+              strcmp(mode[1],"skipped") == 0 && frameID[1] == 0 &&
+              strcmp(mode[2],"downsampled") == 0 && frameID[2] == 1;
+      printf("  Decisions in the log: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // the full series holds the first frame only; the downsampled
+      // one holds every stride-th particle with the total mass kept
+      char frameName[XCUDA_PATH_LENGTH], sampledFile[XCUDA_PATH_LENGTH];
+      snprintf(frameName,XCUDA_PATH_LENGTH,"%s_0002.hdf5",budgetFile);
+      snprintf(sampledFile,XCUDA_PATH_LENGTH,"%s_DS",budgetFile);
+
+      struct stat st;
+      status= stat(frameName,&st) != 0;
+      printf("  Nothing written for a skipped frame: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      const int nSampled[2]= {int(nParticles+stride-1)/stride, int(nParticles/2+stride-1)/stride};
+      const int nRegistered[2]= {int(nParticles), int(nParticles/2)};
+
+      H5pio pd;
+      pd.registerParticles(nSampled[0],H5pio::Gas);
+      pd.registerFloat1DField(isNodeCentered,"Masses",mass_in);
+      pd.registerGeometry3DField(isNodeCentered,"Coordinates",loc_in);
+      pd.registerParticles(nSampled[1],H5pio::Buldge);
+      pd.registerFloat1DField(isNodeCentered,"Masses",energy_in);
+
+      pd.openFiles(sampledFile);
+      pd.loadFrame(1);
+      pd.closeFiles();
+
+      // the particles are those of time 0.0 throughout
+      status= isClose(pd.frameTime,1.0f);
+      for (int k=0; k<2; k++) {
+        const float *sampledMass= (k == 0) ? mass_in : energy_in;
+        double total= 0.0, sampledTotal= 0.0;
+        for (int i=0; i<nRegistered[k]; i++) total += mass[i];
+        for (int i=0; i<nSampled[k]; i++) sampledTotal += sampledMass[i];
+        status= status && fabs(sampledTotal - total) <= 1.0e-5*total;
+      } // endfor(k)
+      for (int i=0; i<nSampled[0]; i++) {
+        status= status && isClose(loc_in[i],loc[i*stride]);
+      } // endfor(i)
+
+      printf("  Every %d-th particle with the total mass: %s\n",stride,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Checkpoints updated in place\n");
+  printf("{\n");
+
+    {
+      // the rows past nParticles/2 belong to the gas alone, so the
+      // buldge shares none of the values changed between checkpoints
+      //
+      const int nChanged= std::max(1,int(nParticles)/10);
+      const int row0= int(nParticles) - nChanged;
+      const long fullRows= 5L*nParticles + 3L*(nParticles/2);
+
+      char markedFile[XCUDA_PATH_LENGTH], hashedFile[XCUDA_PATH_LENGTH], fileName[XCUDA_PATH_LENGTH];
+      snprintf(markedFile,XCUDA_PATH_LENGTH,"%s_marked",saveFile);
+      snprintf(hashedFile,XCUDA_PATH_LENGTH,"%s_hashed",saveFile);
+
+      H5pio pk;
+      pk.registerParticles(nParticles,H5pio::Gas);
+      pk.registerFloat1DField(isNodeCentered,"InternalEnergy",energy);
+      pk.registerFloat1DField(isNodeCentered,"Masses",mass);
+      pk.registerInteger1DField(isNodeCentered,"ParticleIDs",pid);
+      pk.registerFloat3DField(isNodeCentered,"Velocities",vel);
+      pk.registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+      pk.registerParticles(nParticles/2,H5pio::Buldge);
+      pk.registerFloat1DField(isNodeCentered,"Masses",mass);
+      pk.registerFloat3DField(isNodeCentered,"Velocities",vel);
+      pk.registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+
+      // the checkpoint read back as frame 1 of its series
+      auto checkpointMatches= [&](XcCString baseName, const float time) {
+        pi.openFiles(baseName);
+        pi.loadFrame(1);
+        pi.closeFiles();
+        return isClose(pi.frameTime,time) && checkParticles(pk,pi);
+      };
+
+      // marked rows: the first checkpoint is written in full, the
+      // second only rewrites the chunks holding the marked rows
+      snprintf(fileName,XCUDA_PATH_LENGTH,"%s_0001.hdf5",markedFile);
+      remove(fileName);
+
+      initParticles(pk,0.0f,dt);
+      pk.setDirtyTracking(H5pio::MarkedRows);
+      const long rows0= pk.saveCheckpoint(fileName,0.0f);
+
+      for (int i=row0; i<nParticles; i++) mass[i] *= 3.0f;
+      pk.markDirty(H5pio::Gas,"Masses",row0,nChanged);
+      const long rows1= pk.saveCheckpoint(fileName,0.5f);
+
+      bool status= rows0 == fullRows && rows1 >= nChanged && rows1 < fullRows &&
+                   checkpointMatches(markedFile,0.5f);
+      printf("  Marked rows rewritten in place (%ld of %ld rows): %s\n",rows1,fullRows,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // block hashes: only the chunks whose hash changed are rewritten,
+      // none when nothing did
+      snprintf(fileName,XCUDA_PATH_LENGTH,"%s_0001.hdf5",hashedFile);
+      remove(fileName);
+
+      initParticles(pk,0.0f,dt);
+      pk.setDirtyTracking(H5pio::BlockHashes);
+      const long rows2= pk.saveCheckpoint(fileName,0.0f);
+
+      for (int i=row0; i<nParticles; i++) vel[i]= vel[i]*3.0f;
+      const long rows3= pk.saveCheckpoint(fileName,0.5f);
+
+      status= rows2 == fullRows && rows3 >= nChanged && rows3 < fullRows &&
+              checkpointMatches(hashedFile,0.5f);
+      printf("  Changed chunks rewritten in place (%ld of %ld rows): %s\n",rows3,fullRows,status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      const long rows4= pk.saveCheckpoint(fileName,1.0f);
+      status= rows4 == 0 && checkpointMatches(hashedFile,1.0f);
+      printf("  Unchanged checkpoint writes no rows: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+
+      // other particle counts cannot be updated in place: the file is
+      // rewritten in full
+      H5pio ph;
+      ph.registerParticles(nParticles/2,H5pio::Gas);
+      ph.registerFloat1DField(isNodeCentered,"Masses",mass);
+      ph.registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+      ph.setDirtyTracking(H5pio::BlockHashes);
+      const long rows5= ph.saveCheckpoint(fileName,1.5f);
+
+      status= rows5 == 2L*(nParticles/2) &&
+              fileParticles(fileName,H5pio::Gas) == int(nParticles/2) &&
+              fileParticles(fileName,H5pio::Buldge) == 0;
+      printf("  Full rewrite when the particle counts change: %s\n",status?"passed":"failed");
+      if (!status) jobStatus= 1;
+    }
+
+  printf("}\n");
+
+
+  printf("\n");
+  printf("Frames written from a plan\n");
+  printf("{\n");
+
+    {
+      // the same frames written with and without prepareFrame() hold
+      // the same datasets, attributes, chunks and filters, and XDMF
+      // files that only differ in the file names
+      //
+      char seriesFile[2][XCUDA_PATH_LENGTH];
+      H5pio pw[2];
+
+      for (int k=0; k<2; k++) {
+        snprintf(seriesFile[k],XCUDA_PATH_LENGTH,"%s_%s",saveFile,(k == 0) ? "unplanned" : "planned");
+
+        pw[k].registerParticles(nParticles,H5pio::Gas);
+        pw[k].registerFloat1DField(isNodeCentered,"InternalEnergy",energy);
+        pw[k].registerFloat1DField(isNodeCentered,"Masses",mass);
+        pw[k].registerInteger1DField(isNodeCentered,"ParticleIDs",pid);
+        pw[k].registerFloat3DField(isNodeCentered,"Velocities",vel);
+        pw[k].registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+        pw[k].registerParticles(nParticles/2,H5pio::Buldge);
+        pw[k].registerFloat1DField(isNodeCentered,"Masses",mass);
+        pw[k].registerFloat3DField(isNodeCentered,"Velocities",vel);
+        pw[k].registerGeometry3DField(isNodeCentered,"Coordinates",loc);
+        if (k == 1) pw[k].prepareFrame();
+
+        pw[k].openFiles(seriesFile[k]);
+        for (int f=0; f<2; f++) {
+          initParticles(po,0.5f*f,dt);
+          pw[k].saveFrame(0.5f*f);
+        } // endfor(f)
+        pw[k].closeFiles();
+      } // endfor(k)
+
+      for (int f=1; f<=2; f++) {
+        char frameName[2][XCUDA_PATH_LENGTH], xdmfName[2][XCUDA_PATH_LENGTH];
+        std::string xdmf[2];
+
+        for (int k=0; k<2; k++) {
+          snprintf(frameName[k],XCUDA_PATH_LENGTH,"%s_%04d.hdf5",seriesFile[k],f);
+          snprintf(xdmfName[k],XCUDA_PATH_LENGTH,"%s_%04d.xdmf",seriesFile[k],f);
+
+          FILE *fp= fopen(xdmfName[k],"r");
+          if (fp == nullptr) continue;
+          char line[1024];
+          while (fgets(line,sizeof(line),fp) != nullptr) xdmf[k] += line;
+          fclose(fp);
+        } // endfor(k)
+
+        const FrameContents unplanned= frameContents(frameName[0]);
+        const FrameContents planned= frameContents(frameName[1]);
+        bool status= !unplanned.empty() && planned == unplanned;
+        printf("  Frame %d from the plan, values and layout: %s\n",f,status?"passed":"failed");
+        if (!status) jobStatus= 1;
+
+        for (size_t at= xdmf[1].find("_planned"); at != std::string::npos; at= xdmf[1].find("_planned",at)) {
+          xdmf[1].replace(at,8,"_unplanned");
+        } // endfor(at)
+        status= !xdmf[0].empty() && xdmf[1] == xdmf[0];
+        printf("  Frame %d from the plan, XDMF: %s\n",f,status?"passed":"failed");
+        if (!status) jobStatus= 1;
+      } // endfor(f)
+    }
+
+  printf("}\n");
   
   delete[] energy_in;
   delete[] mass_in;